@@ -0,0 +1,136 @@
+// Streaming per-channel activation statistics.
+//
+// ActivationStats is an ActivationSink: attached to an Engine it folds every layer
+// output into per-channel min, max, zero count and a histogram, without keeping
+// any tensor. The histogram has one bin per signed power of two (bin 16 holds
+// zeros, 16 + b the positive values of bit length b, 16 - b the negative ones), so
+// a value costs a count-leading-zeros and a few increments. Statistics of
+// several Engines (one per thread) are combined with merge().
+
+#ifndef __ENGINE_ACTIVATION_STATS_H__
+#define __ENGINE_ACTIVATION_STATS_H__
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "engine.h"
+
+namespace engine {
+
+struct ChannelStats {
+	static const int BINS = 33;
+	static const int ZERO_BIN = 16;
+
+	number_t min = NUMBER_T_MAX;
+	number_t max = NUMBER_T_MIN;
+	uint64_t count = 0;
+	std::array<uint64_t, BINS> histogram = {};
+
+	uint64_t zeros() const { return histogram[ZERO_BIN]; }
+
+	static int bin(number_t v) {
+		if (v == 0)
+			return ZERO_BIN;
+		uint32_t magnitude = v > 0 ? v : -(int32_t)v;
+		int bits = 32 - __builtin_clz(magnitude);
+		return v > 0 ? ZERO_BIN + bits : ZERO_BIN - bits;
+	}
+
+	// Smallest |v| bound 2^b covering fraction q of the values
+	int magnitude_bits(double q) const {
+		const double needed = q * count;
+		uint64_t seen = histogram[ZERO_BIN];
+		int b = 0;
+		for (; seen < needed && b < ZERO_BIN; b++)
+			seen += histogram[ZERO_BIN + 1 + b] + histogram[ZERO_BIN - 1 - b];
+		return b;
+	}
+
+	void add(const number_t *values, size_t n) {
+		// Separate passes: the min/max one vectorises
+		number_t lo = min, hi = max;
+		for (size_t x = 0; x < n; x++) {
+			lo = std::min(lo, values[x]);
+			hi = std::max(hi, values[x]);
+		}
+		min = lo;
+		max = hi;
+		for (size_t x = 0; x < n; x++)
+			histogram[bin(values[x])]++;
+		count += n;
+	}
+
+	void merge(const ChannelStats &o) {
+		min = std::min(min, o.min);
+		max = std::max(max, o.max);
+		count += o.count;
+		for (int b = 0; b < BINS; b++)
+			histogram[b] += o.histogram[b];
+	}
+};
+
+class ActivationStats : public ActivationSink {
+public:
+	explicit ActivationStats(const Model &model) : model(model), layers(model.layers.size()) {
+		for (size_t i = 0; i < model.layers.size(); i++)
+			layers[i].resize(model.layers[i].filters);
+	}
+
+	void layer_output(size_t i, const Layer &layer, const number_t *output) override {
+		for (size_t c = 0; c < layer.filters; c++)
+			layers[i][c].add(output + c * layer.out_samples, layer.out_samples);
+	}
+
+	void merge(const ActivationStats &o) {
+		for (size_t i = 0; i < layers.size(); i++)
+			for (size_t c = 0; c < layers[i].size(); c++)
+				layers[i][c].merge(o.layers[i][c]);
+	}
+
+	const std::vector<ChannelStats> &channels(size_t i) const { return layers.at(i); }
+
+	// All channels of layer i combined
+	ChannelStats layer(size_t i) const {
+		ChannelStats total;
+		for (const auto &c : layers.at(i))
+			total.merge(c);
+		return total;
+	}
+
+	// Per-channel min, max, zero fraction and non-empty histogram bins as JSON
+	void write_json(std::ostream &out) const {
+		out << "{\n  \"model\": \"" << model.name << "\",\n  \"fixed_point\": " << model.fixed_point << ",\n  \"layers\": [";
+		bool first_layer = true;
+		for (size_t i = 0; i < layers.size(); i++) {
+			if (model.layers[i].kind == LayerKind::Flatten)
+				continue;
+			out << (first_layer ? "" : ",") << "\n    { \"name\": \"" << model.layers[i].name << "\", \"channels\": [";
+			first_layer = false;
+			for (size_t c = 0; c < layers[i].size(); c++) {
+				const ChannelStats &s = layers[i][c];
+				out << (c ? "," : "") << "\n      { \"min\": " << s.min << ", \"max\": " << s.max << ", \"count\": " << s.count
+					<< ", \"zero_fraction\": " << (s.count ? s.zeros() / (double)s.count : 0) << ", \"histogram\": {";
+				bool first_bin = true;
+				for (int b = 0; b < ChannelStats::BINS; b++) {
+					if (!s.histogram[b])
+						continue;
+					out << (first_bin ? "" : ", ") << "\"" << b - ChannelStats::ZERO_BIN << "\": " << s.histogram[b];
+					first_bin = false;
+				}
+				out << "} }";
+			}
+			out << "\n    ] }";
+		}
+		out << "\n  ]\n}\n";
+	}
+
+private:
+	const Model &model;
+	std::vector<std::vector<ChannelStats>> layers;	// [layer][output channel]
+};
+
+} // namespace engine
+
+#endif // __ENGINE_ACTIVATION_STATS_H__
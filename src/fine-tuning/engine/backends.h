@@ -0,0 +1,46 @@
+// Registry of the available engine backends, selected by name on the command line.
+
+#ifndef __ENGINE_BACKENDS_H__
+#define __ENGINE_BACKENDS_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "block_sparse.h"
+#include "engine.h"
+#include "gemm.h"
+#include "narrow.h"
+#include "sparse.h"
+#include "winograd.h"
+
+namespace engine {
+
+inline std::vector<std::string> backend_names() {
+	return { "generated", "reference", "gemm", "winograd", "narrow", "sparse", "block-sparse" };
+}
+
+inline std::unique_ptr<Backend> make_backend(const std::string &name) {
+	if (name == "generated")
+		return std::unique_ptr<Backend>(new GeneratedBackend());
+	if (name == "reference")
+		return std::unique_ptr<Backend>(new ReferenceBackend());
+	if (name == "gemm")
+		return std::unique_ptr<Backend>(new GemmBackend());
+	if (name == "winograd")
+		return std::unique_ptr<Backend>(new WinogradBackend());
+	if (name == "narrow")
+		return std::unique_ptr<Backend>(new NarrowBackend());
+	if (name == "sparse")
+		return std::unique_ptr<Backend>(new SparseBackend());
+	if (name == "block-sparse")
+		return std::unique_ptr<Backend>(new BlockSparseBackend());
+	std::string known;
+	for (const auto &n : backend_names())
+		known += " " + n;
+	fatal("unknown backend \"" + name + "\", expected one of:" + known);
+}
+
+} // namespace engine
+
+#endif // __ENGINE_BACKENDS_H__
@@ -0,0 +1,250 @@
+// Host side of the weight blobs (engine/weight_blob.h): writing a Model to a
+// blob, mapping a blob file and describing it as a Model.
+//
+// A MappedBlob maps the file read-only and the Model from blob_model() points into
+// the mapping, so switching variants costs no copy and no rebuild; the mapping
+// must outlive the Model. Such a Model has no generated layer functions (they are
+// bound to the compiled-in weights), so it runs on every backend but "generated".
+
+#ifndef __ENGINE_BLOB_MODEL_H__
+#define __ENGINE_BLOB_MODEL_H__
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "model_desc.h"
+#include "weight_blob.h"
+
+namespace engine {
+
+namespace blob {
+
+inline uint32_t kind_code(LayerKind kind) {
+	switch (kind) {
+	case LayerKind::Conv1D: return CONV1D;
+	case LayerKind::MaxPool1D: return MAX_POOL1D;
+	case LayerKind::AvgPool1D: return AVG_POOL1D;
+	case LayerKind::Flatten: return FLATTEN;
+	case LayerKind::Dense: return DENSE;
+	}
+	return 0;
+}
+
+inline LayerKind layer_kind(uint32_t code) {
+	switch (code) {
+	case CONV1D: return LayerKind::Conv1D;
+	case MAX_POOL1D: return LayerKind::MaxPool1D;
+	case AVG_POOL1D: return LayerKind::AvgPool1D;
+	case FLATTEN: return LayerKind::Flatten;
+	case DENSE: return LayerKind::Dense;
+	}
+	fatal("unknown blob layer kind " + std::to_string(code));
+}
+
+inline size_t align_up(size_t offset) {
+	return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// Width of the smallest two's complement field holding v
+inline uint32_t signed_bits(int32_t v) {
+	uint32_t bits = 1;
+	while (v < -(1 << (bits - 1)) || v >= (1 << (bits - 1)))
+		bits++;
+	return bits;
+}
+
+// Fields appended LSB first, the reverse of BitReader (weight_blob.h)
+class BitWriter {
+public:
+	explicit BitWriter(std::vector<uint8_t> &out) : out(out) {}
+
+	void write(uint32_t v, uint32_t bits) {
+		acc |= (uint64_t)(v & ((1u << bits) - 1)) << avail;
+		avail += bits;
+		while (avail >= 8) {
+			out.push_back(acc & 0xff);
+			acc >>= 8;
+			avail -= 8;
+		}
+	}
+
+	void flush() {
+		if (avail)
+			out.push_back(acc & 0xff);
+		acc = avail = 0;
+	}
+
+private:
+	std::vector<uint8_t> &out;
+	uint64_t acc = 0;
+	uint32_t avail = 0;
+};
+
+// Serialised blob of a model with weights
+inline std::vector<uint8_t> encode(const Model &model) {
+	if (model.name.size() >= sizeof(Header::model_name))
+		fatal("model name \"" + model.name + "\" too long for a blob");
+	size_t size = align_up(sizeof(Header) + model.layers.size() * sizeof(LayerEntry));
+	std::vector<LayerEntry> entries(model.layers.size());
+	for (size_t i = 0; i < model.layers.size(); i++) {
+		const Layer &layer = model.layers[i];
+		LayerEntry &e = entries[i];
+		memset(&e, 0, sizeof(e));
+		if (layer.name.size() >= sizeof(e.name))
+			fatal(model.name + ": layer name \"" + layer.name + "\" too long for a blob");
+		strcpy(e.name, layer.name.c_str());
+		e.kind = kind_code(layer.kind);
+		e.channels = layer.channels;
+		e.samples = layer.samples;
+		e.filters = layer.filters;
+		e.kernel_size = layer.kernel_size;
+		e.stride = layer.stride;
+		e.out_samples = layer.out_samples;
+		e.relu = layer.relu;
+		e.shift = layer.shift;
+		if (layer.has_weights()) {
+			e.kernel_offset = size;
+			size = align_up(size + layer.weight_count() * sizeof(number_t));
+			e.bias_offset = size;
+			size = align_up(size + layer.filters * sizeof(number_t));
+		}
+	}
+
+	std::vector<uint8_t> data(size, 0);
+	Header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, MAGIC, sizeof(MAGIC));
+	h.version = VERSION;
+	h.header_size = sizeof(Header);
+	h.entry_size = sizeof(LayerEntry);
+	h.layer_count = model.layers.size();
+	h.alignment = ALIGNMENT;
+	h.total_size = size;
+	h.fixed_point = model.fixed_point;
+	h.input_channels = model.input_channels;
+	h.input_samples = model.input_samples;
+	strcpy(h.model_name, model.name.c_str());
+	memcpy(data.data(), &h, sizeof(h));
+	if (!entries.empty())
+		memcpy(data.data() + sizeof(h), entries.data(), entries.size() * sizeof(LayerEntry));
+	for (size_t i = 0; i < model.layers.size(); i++) {
+		const Layer &layer = model.layers[i];
+		if (!layer.has_weights())
+			continue;
+		memcpy(data.data() + entries[i].kernel_offset, layer.kernel, layer.weight_count() * sizeof(number_t));
+		memcpy(data.data() + entries[i].bias_offset, layer.bias, layer.filters * sizeof(number_t));
+	}
+	h.crc32 = checksum(data.data(), data.size());
+	memcpy(data.data(), &h, sizeof(h));
+	return data;
+}
+
+inline void write(std::ostream &out, const Model &model) {
+	const std::vector<uint8_t> data = encode(model);
+	out.write((const char *)data.data(), data.size());
+}
+
+// Model whose layers point into the blob
+inline Model blob_model(const View &view) {
+	const Header &h = view.header();
+	Model model;
+	model.name = h.model_name;
+	model.input_channels = h.input_channels;
+	model.input_samples = h.input_samples;
+	model.fixed_point = h.fixed_point;
+	size_t channels = model.input_channels, samples = model.input_samples;
+	for (uint32_t i = 0; i < view.layers(); i++) {
+		const LayerEntry &e = view.layer(i);
+		Layer layer;
+		layer.name = e.name;
+		layer.kind = layer_kind(e.kind);
+		layer.channels = e.channels;
+		layer.samples = e.samples;
+		layer.filters = e.filters;
+		layer.kernel_size = e.kernel_size;
+		layer.stride = e.stride;
+		layer.out_samples = e.out_samples;
+		layer.relu = e.relu;
+		layer.shift = e.shift;
+		layer.kernel = view.kernel(i);
+		layer.bias = view.bias(i);
+		// The kernels trust these shapes
+		const bool dense = layer.kind == LayerKind::Dense;
+		bool ok = layer.channels == (dense ? channels * samples : channels) && layer.samples == (dense ? 1 : samples)
+			&& layer.stride && layer.kernel_size && layer.samples >= layer.kernel_size;
+		if (layer.kind == LayerKind::Flatten)
+			ok = ok && layer.filters == channels * samples && layer.out_samples == 1;
+		else
+			ok = ok && layer.out_samples == (layer.samples - layer.kernel_size) / layer.stride + 1;
+		if (layer.kind == LayerKind::MaxPool1D || layer.kind == LayerKind::AvgPool1D)
+			ok = ok && layer.filters == channels;
+		if (!ok)
+			fatal(model.name + ": blob layer " + layer.name + " has an inconsistent shape");
+		model.layers.push_back(layer);
+		channels = layer.filters;
+		samples = layer.out_samples;
+	}
+	return model;
+}
+
+// Read-only mapping of a whole file
+class MappedFile {
+public:
+	explicit MappedFile(const std::string &filename) {
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			fatal("opening \"" + filename + "\": " + strerror(errno));
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			::close(fd);
+			fatal("\"" + filename + "\": empty or unreadable");
+		}
+		length = st.st_size;
+		address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (address == MAP_FAILED)
+			fatal("mapping \"" + filename + "\": " + strerror(errno));
+	}
+
+	~MappedFile() { munmap(address, length); }
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	const void *data() const { return address; }
+	size_t size() const { return length; }
+
+private:
+	void *address;
+	size_t length;
+};
+
+// Read-only mapping of a blob file, checked on open
+class MappedBlob {
+public:
+	explicit MappedBlob(const std::string &filename) : file(filename) {
+		Status status = view.open(file.data(), file.size());
+		if (status != Status::OK)
+			fatal("\"" + filename + "\": " + status_name(status));
+	}
+
+	const View &get() const { return view; }
+
+private:
+	MappedFile file;
+	View view;
+};
+
+} // namespace blob
+
+} // namespace engine
+
+#endif // __ENGINE_BLOB_MODEL_H__
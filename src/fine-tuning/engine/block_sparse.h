@@ -0,0 +1,149 @@
+// Block-sparse weight format and kernels for pruned models.
+//
+// Each filter row of a conv1d/dense kernel ([channels * kernel_size] values, the
+// im2col depth) is cut into blocks of BLOCK consecutive values; only blocks with a
+// non-zero value are stored, CSR-style:
+//   row_start[filters + 1]  first stored block of each row
+//   block_index[blocks]     block position in the row
+//   values[blocks][BLOCK]
+// All three fit in 16-bit arrays for every supported layer, which is how they
+// are counted in flash_bytes() and exported.
+//
+// The kernels only visit stored blocks: for a conv1d weight w at depth
+// d = c * K + x, out[f][p] += w * input[c][p * stride + x] over all p at once.
+// Skipped weights are exactly zero. Summing by block reaches partial sums the
+// generated order does not, so the accumulators wrap (gemm::Wrapping) and outputs
+// are bit-exact with the dense kernels on the same (pruned) weights wherever the
+// reference's int32 sum does not overflow.
+
+#ifndef __ENGINE_BLOCK_SPARSE_H__
+#define __ENGINE_BLOCK_SPARSE_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "gemm.h"
+
+namespace engine {
+
+namespace block_sparse {
+
+static const size_t BLOCK = 4;
+
+struct Weights {
+	size_t rows;
+	size_t depth;
+	std::vector<uint16_t> row_start;
+	std::vector<uint16_t> block_index;
+	std::vector<number_t> values;
+
+	size_t blocks() const { return block_index.size(); }
+	size_t flash_bytes() const {
+		return (row_start.size() + block_index.size()) * sizeof(uint16_t) + values.size() * sizeof(number_t);
+	}
+};
+
+inline Weights encode(const Layer &layer) {
+	Weights w;
+	w.rows = layer.filters;
+	w.depth = layer.channels * layer.kernel_size;
+	const size_t row_blocks = (w.depth + BLOCK - 1) / BLOCK;
+	if (w.rows * row_blocks > UINT16_MAX)
+		fatal(layer.name + ": too many blocks for 16-bit block indices");
+
+	w.row_start.push_back(0);
+	for (size_t f = 0; f < w.rows; f++) {
+		const number_t *row = layer.kernel + f * w.depth;
+		for (size_t b = 0; b < row_blocks; b++) {
+			number_t block[BLOCK] = {};
+			bool zero = true;
+			for (size_t i = 0; i < BLOCK && b * BLOCK + i < w.depth; i++) {
+				block[i] = row[b * BLOCK + i];
+				zero = zero && !block[i];
+			}
+			if (zero)
+				continue;
+			w.block_index.push_back(b);
+			w.values.insert(w.values.end(), block, block + BLOCK);
+		}
+		w.row_start.push_back(w.block_index.size());
+	}
+	return w;
+}
+
+// Dense storage of the same layer: kernel and bias as int16
+inline size_t dense_flash_bytes(const Layer &layer) {
+	return (layer.weight_count() + layer.filters) * sizeof(number_t);
+}
+
+inline void conv1d(const Layer &layer, const Weights &w, const number_t *input, number_t *output) {
+	static thread_local std::vector<gemm::Wrapping<long_number_t>> acc;
+	const size_t S = layer.samples, K = layer.kernel_size, OS = layer.out_samples, stride = layer.stride;
+	acc.resize(OS);
+
+	for (size_t f = 0; f < w.rows; f++) {
+		std::fill(acc.begin(), acc.end(), 0);
+		for (size_t b = w.row_start[f]; b < w.row_start[f + 1]; b++) {
+			const number_t *values = &w.values[b * BLOCK];
+			for (size_t i = 0; i < BLOCK; i++) {
+				const size_t d = w.block_index[b] * BLOCK + i;
+				if (!values[i] || d >= w.depth)
+					continue;
+				const long_number_t v = values[i];
+				const number_t *in = input + (d / K) * S + d % K;
+				if (stride == 1)
+					for (size_t p = 0; p < OS; p++)
+						acc[p] += (gemm::Wrapping<long_number_t>)(in[p] * v);
+				else
+					for (size_t p = 0; p < OS; p++)
+						acc[p] += (gemm::Wrapping<long_number_t>)(in[p * stride] * v);
+			}
+		}
+		for (size_t p = 0; p < OS; p++)
+			output[f * OS + p] = requantize(gemm::accumulator_value<long_number_t>(acc[p]), layer.shift, layer.bias[f], layer.relu);
+	}
+}
+
+inline void dense(const Layer &layer, const Weights &w, const number_t *input, number_t *output) {
+	for (size_t f = 0; f < w.rows; f++) {
+		gemm::Wrapping<long_number_t> acc = 0;
+		for (size_t b = w.row_start[f]; b < w.row_start[f + 1]; b++) {
+			const number_t *values = &w.values[b * BLOCK];
+			const size_t d = w.block_index[b] * BLOCK;
+			for (size_t i = 0; i < BLOCK && d + i < w.depth; i++)
+				acc += (gemm::Wrapping<long_number_t>)(values[i] * input[d + i]);
+		}
+		output[f] = requantize(gemm::accumulator_value<long_number_t>(acc), layer.shift, layer.bias[f], layer.relu);
+	}
+}
+
+} // namespace block_sparse
+
+// Block-sparse conv1d/dense for pruned models, reference pooling
+class BlockSparseBackend : public Backend {
+public:
+	const char *name() const override { return "block-sparse"; }
+
+	void prepare(const Model &model) override {
+		encoded.assign(model.layers.size(), block_sparse::Weights());
+		for (size_t i = 0; i < model.layers.size(); i++)
+			if (model.layers[i].has_weights())
+				encoded[i] = block_sparse::encode(model.layers[i]);
+	}
+
+	void conv1d(size_t i, const Layer &layer, const number_t *input, number_t *output) override {
+		block_sparse::conv1d(layer, encoded.at(i), input, output);
+	}
+	void dense(size_t i, const Layer &layer, const number_t *input, number_t *output) override {
+		block_sparse::dense(layer, encoded.at(i), input, output);
+	}
+
+	const block_sparse::Weights &weights(size_t i) const { return encoded.at(i); }
+
+private:
+	std::vector<block_sparse::Weights> encoded;
+};
+
+} // namespace engine
+
+#endif // __ENGINE_BLOCK_SPARSE_H__
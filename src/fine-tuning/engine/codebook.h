@@ -0,0 +1,264 @@
+// Codebook weights: conv1d/dense kernels clustered to at most 16 int16 levels,
+// stored as codebooks and packed 1-, 2- or 4-bit indices.
+//
+// cluster() runs an exact 1-D k-means over a set of weights and replaces each
+// weight by its rounded centroid, so the clustered model runs on every backend.
+// cluster_kernel() applies it to a whole layer (Scope::Layer, one codebook) or to
+// each filter (Scope::Filter, one codebook per output channel: the filters of
+// these models differ in scale, and with 16 levels a shared codebook leaves 7-12%
+// RMS weight error per layer against 1-6% per filter for most conv1d layers).
+// encode() then stores a clustered kernel as codebooks + indices; it needs at most
+// 1 << bits distinct values per codebook.
+//
+// The kernels never multiply a weight: for each output they add every input into
+// the partial sum of its weight's codeword, then multiply the (at most 16) sums by
+// their codewords once. A codeword sum can exceed int32 where the weight-by-weight
+// sum does not, so sums and products are taken modulo 2^32 (gemm::Wrapping) and
+// only the final value is read as int32: outputs are bit-exact with the reference
+// kernels on the clustered weights unless the reference itself overflows.
+
+#ifndef __ENGINE_CODEBOOK_H__
+#define __ENGINE_CODEBOOK_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gemm.h"
+
+namespace engine {
+
+namespace codebook {
+
+static const size_t MAX_LEVELS = 16;
+
+enum class Scope { Layer, Filter };
+
+struct Weights {
+	size_t rows;
+	size_t depth;				// channels * kernel_size
+	uint32_t bits;				// Index width: 1, 2 or 4
+	Scope scope;
+	std::vector<number_t> codebook;		// 1 << bits codewords, per filter with Scope::Filter
+	std::vector<uint8_t> indices;		// Packed LSB first, 8 / bits per byte
+
+	const number_t *codewords(size_t row) const {
+		return codebook.data() + (scope == Scope::Filter ? row << bits : 0);
+	}
+
+	uint32_t index(size_t i) const {
+		const size_t per_byte = 8 / bits;
+		return (indices[i / per_byte] >> (i % per_byte * bits)) & ((1u << bits) - 1);
+	}
+
+	size_t flash_bytes() const { return indices.size() + codebook.size() * sizeof(number_t); }
+};
+
+// Index width for a number of levels
+inline uint32_t index_bits(size_t levels) {
+	return levels <= 2 ? 1 : levels <= 4 ? 2 : 4;
+}
+
+// Clusters kernel (n weights) in place to at most `levels` values. On sorted
+// values the clusters are runs, so the least squared error clustering is found
+// exactly by dynamic programming over the distinct values (as in Ckmeans.1d.dp):
+// error[j][i] is the least error of the first i values in j + 1 runs.
+inline void cluster(number_t *kernel, size_t n, size_t levels) {
+	std::vector<number_t> values(kernel, kernel + n);
+	std::sort(values.begin(), values.end());
+	values.erase(std::unique(values.begin(), values.end()), values.end());
+	const size_t m = values.size();
+	levels = std::min(levels, m);
+
+	// Prefix count, sum and sum of squares over the distinct values
+	std::vector<double> count(m + 1, 0), sum(m + 1, 0), squares(m + 1, 0);
+	for (size_t k = 0; k < n; k++) {
+		const size_t i = std::lower_bound(values.begin(), values.end(), kernel[k]) - values.begin();
+		count[i + 1]++;
+		sum[i + 1] += kernel[k];
+		squares[i + 1] += (double)kernel[k] * kernel[k];
+	}
+	for (size_t i = 0; i < m; i++) {
+		count[i + 1] += count[i];
+		sum[i + 1] += sum[i];
+		squares[i + 1] += squares[i];
+	}
+	auto run_error = [&](size_t a, size_t b) {	// Values a..b-1 around their mean
+		const double s = sum[b] - sum[a];
+		return squares[b] - squares[a] - s * s / (count[b] - count[a]);
+	};
+
+	std::vector<std::vector<double>> error(levels, std::vector<double>(m + 1, INFINITY));
+	std::vector<std::vector<size_t>> start(levels, std::vector<size_t>(m + 1, 0));
+	for (size_t i = 1; i <= m; i++)
+		error[0][i] = run_error(0, i);
+	for (size_t j = 1; j < levels; j++)
+		for (size_t i = j + 1; i <= m; i++)
+			for (size_t a = j; a < i; a++) {
+				const double e = error[j - 1][a] + run_error(a, i);
+				if (e < error[j][i]) {
+					error[j][i] = e;
+					start[j][i] = a;
+				}
+			}
+
+	// Rounded mean of every run, for each distinct value
+	std::vector<number_t> centroid(m);
+	for (size_t j = levels, end = m; j-- > 0;) {
+		const size_t begin = start[j][end];
+		const number_t c = (number_t)std::lround((sum[end] - sum[begin]) / (count[end] - count[begin]));
+		std::fill(centroid.begin() + begin, centroid.begin() + end, c);
+		end = begin;
+	}
+	for (size_t k = 0; k < n; k++)
+		kernel[k] = centroid[std::lower_bound(values.begin(), values.end(), kernel[k]) - values.begin()];
+}
+
+// Clusters a conv1d/dense kernel (filters rows of depth weights) in place
+inline void cluster_kernel(number_t *kernel, size_t filters, size_t depth, size_t levels, Scope scope) {
+	if (scope == Scope::Layer)
+		cluster(kernel, filters * depth, levels);
+	else
+		for (size_t f = 0; f < filters; f++)
+			cluster(kernel + f * depth, depth, levels);
+}
+
+// Root mean square of (clustered - original) over that of original
+inline double relative_rms_error(const number_t *original, const number_t *clustered, size_t n) {
+	double error = 0, energy = 0;
+	for (size_t k = 0; k < n; k++) {
+		error += (double)(clustered[k] - original[k]) * (clustered[k] - original[k]);
+		energy += (double)original[k] * original[k];
+	}
+	return energy > 0 ? std::sqrt(error / energy) : 0;
+}
+
+// Codebook storage of a clustered layer
+inline Weights encode(const Layer &layer, uint32_t bits, Scope scope) {
+	Weights w;
+	w.rows = layer.filters;
+	w.depth = layer.channels * layer.kernel_size;
+	w.bits = bits;
+	w.scope = scope;
+	const size_t per_byte = 8 / bits, levels = 1u << bits;
+	const size_t span = scope == Scope::Filter ? w.depth : layer.weight_count();
+	w.indices.assign((layer.weight_count() + per_byte - 1) / per_byte, 0);
+	for (size_t start = 0; start < layer.weight_count(); start += span) {
+		std::vector<number_t> values(layer.kernel + start, layer.kernel + start + span);
+		std::sort(values.begin(), values.end());
+		values.erase(std::unique(values.begin(), values.end()), values.end());
+		if (values.size() > levels)
+			fatal(layer.name + ": " + std::to_string(values.size()) + " distinct weights do not fit " + std::to_string(bits)
+				+ "-bit indices");
+		for (size_t i = start; i < start + span; i++) {
+			const uint32_t index = std::lower_bound(values.begin(), values.end(), layer.kernel[i]) - values.begin();
+			w.indices[i / per_byte] |= index << (i % per_byte * bits);
+		}
+		values.resize(levels, 0);
+		w.codebook.insert(w.codebook.end(), values.begin(), values.end());
+	}
+	return w;
+}
+
+typedef gemm::Wrapping<long_number_t> wrap_t;
+
+// One multiply per codeword on the per-codeword partial sums of the inputs of a row
+inline long_number_t dot(const Weights &w, size_t row, const wrap_t *sums) {
+	const number_t *codewords = w.codewords(row);
+	wrap_t acc = 0;
+	for (size_t j = 0; j < (1u << w.bits); j++)
+		acc += sums[j] * (wrap_t)codewords[j];
+	return gemm::accumulator_value<long_number_t>(acc);
+}
+
+inline void conv1d(const Layer &layer, const Weights &w, const number_t *input, number_t *output) {
+	static thread_local std::vector<uint8_t> row;
+	static thread_local std::vector<size_t> offset;
+	const size_t S = layer.samples, K = layer.kernel_size, OS = layer.out_samples, stride = layer.stride;
+	wrap_t sums[MAX_LEVELS];
+	row.resize(w.depth);
+	offset.resize(w.depth);
+	for (size_t d = 0; d < w.depth; d++)
+		offset[d] = (d / K) * S + d % K;
+
+	for (size_t f = 0; f < w.rows; f++) {
+		// Indices of the filter row, unpacked once for every output position
+		for (size_t d = 0; d < w.depth; d++)
+			row[d] = w.index(f * w.depth + d);
+		for (size_t p = 0; p < OS; p++) {
+			std::fill(sums, sums + (1u << w.bits), 0);
+			const number_t *in = input + p * stride;
+			for (size_t d = 0; d < w.depth; d++)
+				sums[row[d]] += (wrap_t)in[offset[d]];
+			output[f * OS + p] = requantize(dot(w, f, sums), layer.shift, layer.bias[f], layer.relu);
+		}
+	}
+}
+
+inline void dense(const Layer &layer, const Weights &w, const number_t *input, number_t *output) {
+	wrap_t sums[MAX_LEVELS];
+	for (size_t f = 0; f < w.rows; f++) {
+		std::fill(sums, sums + (1u << w.bits), 0);
+		for (size_t d = 0; d < w.depth; d++)
+			sums[w.index(f * w.depth + d)] += (wrap_t)input[d];
+		output[f] = requantize(dot(w, f, sums), layer.shift, layer.bias[f], layer.relu);
+	}
+}
+
+// Multiplications of a layer with the codebook kernels: one per codeword and output
+inline size_t multiplies(const Layer &layer, const Weights &w) {
+	return layer.filters * layer.out_samples * (1u << w.bits);
+}
+
+} // namespace codebook
+
+// Codebook conv1d/dense for clustered models, reference pooling. The layers in
+// keep (not clustered) run the reference kernels on their int16 weights.
+class CodebookBackend : public Backend {
+public:
+	explicit CodebookBackend(uint32_t bits = 4, codebook::Scope scope = codebook::Scope::Filter,
+			std::vector<std::string> keep = {})
+		: bits(bits), scope(scope), keep(keep) {}
+
+	const char *name() const override { return "codebook"; }
+
+	void prepare(const Model &model) override {
+		encoded.assign(model.layers.size(), codebook::Weights());
+		clustered.assign(model.layers.size(), false);
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			const Layer &layer = model.layers[i];
+			clustered[i] = layer.has_weights() && std::find(keep.begin(), keep.end(), layer.name) == keep.end();
+			if (clustered[i])
+				encoded[i] = codebook::encode(layer, bits, scope);
+		}
+	}
+
+	void conv1d(size_t i, const Layer &layer, const number_t *input, number_t *output) override {
+		if (clustered.at(i))
+			codebook::conv1d(layer, encoded[i], input, output);
+		else
+			reference::conv1d(layer, input, output);
+	}
+	void dense(size_t i, const Layer &layer, const number_t *input, number_t *output) override {
+		if (clustered.at(i))
+			codebook::dense(layer, encoded[i], input, output);
+		else
+			reference::dense(layer, input, output);
+	}
+
+	bool is_clustered(size_t i) const { return clustered.at(i); }
+	const codebook::Weights &weights(size_t i) const { return encoded.at(i); }
+
+private:
+	uint32_t bits;
+	codebook::Scope scope;
+	std::vector<std::string> keep;
+	std::vector<codebook::Weights> encoded;
+	std::vector<bool> clustered;
+};
+
+} // namespace engine
+
+#endif // __ENGINE_CODEBOOK_H__
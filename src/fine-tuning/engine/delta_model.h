@@ -0,0 +1,152 @@
+// Host side of the delta blobs (engine/weight_delta.h): encoding a variant against
+// a base blob, mapping a delta file and running it.
+//
+// DeltaBackend does what the device does: before each conv1d/dense layer it
+// rebuilds the layer's weights from the base and the delta into a scratch buffer
+// (DecodingBackend). Run it on the Model of the base blob (blob_model()); the
+// weights in that Model are ignored.
+
+#ifndef __ENGINE_DELTA_MODEL_H__
+#define __ENGINE_DELTA_MODEL_H__
+
+#include <string>
+#include <vector>
+
+#include "blob_model.h"
+#include "engine.h"
+#include "weight_delta.h"
+
+namespace engine {
+
+namespace blob {
+
+// Delta blob of variant against base; the layers must have the same shapes,
+// shifts and ReLUs
+inline std::vector<uint8_t> encode_delta(const View &base, const Model &variant) {
+	if (variant.name.size() >= sizeof(DeltaHeader::model_name))
+		fatal("model name \"" + variant.name + "\" too long for a blob");
+	if (variant.layers.size() != base.layers())
+		fatal(variant.name + ": " + std::to_string(variant.layers.size()) + " layers, the base blob has "
+			+ std::to_string(base.layers()));
+
+	std::vector<DeltaEntry> entries(variant.layers.size());
+	std::vector<uint8_t> payload;
+	const size_t payload_start = sizeof(DeltaHeader) + entries.size() * sizeof(DeltaEntry);
+	for (size_t i = 0; i < variant.layers.size(); i++) {
+		const Layer &layer = variant.layers[i];
+		const LayerEntry &b = base.layer(i);
+		if (kind_code(layer.kind) != b.kind || layer.channels != b.channels || layer.samples != b.samples
+				|| layer.filters != b.filters || layer.kernel_size != b.kernel_size || layer.stride != b.stride)
+			fatal(variant.name + ": " + layer.name + " differs in shape from base layer " + b.name);
+		// A delta stores weights only: it runs with the base layer's shift and ReLU
+		if (layer.out_samples != b.out_samples || layer.shift != b.shift || layer.relu != (b.relu != 0))
+			fatal(variant.name + ": " + layer.name + " differs in output size, shift or ReLU from base layer " + b.name);
+		DeltaEntry &e = entries[i];
+		memset(&e, 0, sizeof(e));
+		if (!layer.has_weights())
+			continue;
+
+		// Wrapping int16 differences, kernel then bias
+		std::vector<int16_t> deltas;
+		for (size_t k = 0; k < layer.weight_count(); k++)
+			deltas.push_back((int16_t)(uint16_t)(layer.kernel[k] - base.kernel(i)[k]));
+		for (size_t k = 0; k < layer.filters; k++)
+			deltas.push_back((int16_t)(uint16_t)(layer.bias[k] - base.bias(i)[k]));
+		e.count = deltas.size();
+		for (int16_t d : deltas) {
+			e.nonzero += d != 0;
+			e.bits = std::max(e.bits, d ? signed_bits(d) : 0u);
+		}
+		if (e.nonzero == 0)
+			continue;
+		e.encoding = PACKED;
+		const uint32_t packed = e.payload_size();
+		e.encoding = MASKED;
+		if (e.payload_size() >= packed)
+			e.encoding = PACKED;
+
+		while (payload.size() % 4)
+			payload.push_back(0);
+		e.offset = payload_start + payload.size();
+		if (e.encoding == MASKED) {
+			BitWriter mask(payload);
+			for (int16_t d : deltas)
+				mask.write(d != 0, 1);
+			mask.flush();
+		}
+		BitWriter fields(payload);
+		for (int16_t d : deltas)
+			if (e.encoding == PACKED || d != 0)
+				fields.write((uint16_t)d, e.bits);
+		fields.flush();
+		e.size = payload_start + payload.size() - e.offset;
+	}
+
+	DeltaHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, DELTA_MAGIC, sizeof(DELTA_MAGIC));
+	h.version = DELTA_VERSION;
+	h.header_size = sizeof(DeltaHeader);
+	h.entry_size = sizeof(DeltaEntry);
+	h.layer_count = entries.size();
+	h.total_size = payload_start + payload.size();
+	h.base_crc32 = base.header().crc32;
+	h.base_size = base.header().total_size;
+	strcpy(h.model_name, variant.name.c_str());
+	std::vector<uint8_t> data(h.total_size);
+	memcpy(data.data(), &h, sizeof(h));
+	if (!entries.empty())
+		memcpy(data.data() + sizeof(h), entries.data(), entries.size() * sizeof(DeltaEntry));
+	if (!payload.empty())
+		memcpy(data.data() + payload_start, payload.data(), payload.size());
+	h.crc32 = delta_checksum(data.data(), data.size());
+	memcpy(data.data(), &h, sizeof(h));
+	return data;
+}
+
+// Read-only mapping of a delta file, checked against its base on open
+class MappedDelta {
+public:
+	MappedDelta(const std::string &filename, const View &base) : file(filename) {
+		Status status = view.open(file.data(), file.size(), base);
+		if (status != Status::OK)
+			fatal("\"" + filename + "\": " + status_name(status));
+	}
+
+	const DeltaView &get() const { return view; }
+
+private:
+	MappedFile file;
+	DeltaView view;
+};
+
+// Weights decoded from the delta just before each layer; single-threaded only
+class DeltaBackend : public DecodingBackend {
+public:
+	explicit DeltaBackend(const DeltaView &delta) : delta(delta) {}
+
+	const char *name() const override { return "delta"; }
+
+	void prepare(const Model &model) override {
+		if (model.layers.size() != delta.layers())
+			fatal(model.name + ": the delta has " + std::to_string(delta.layers()) + " layers");
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			const Layer &layer = model.layers[i];
+			if (delta.layer(i).count != (layer.has_weights() ? layer.weight_count() + layer.filters : 0))
+				fatal(model.name + ": " + layer.name + " does not match the delta");
+		}
+		DecodingBackend::prepare(model);
+	}
+
+protected:
+	void decode(size_t i, number_t *scratch) override { delta.decode(i, scratch); }
+
+private:
+	const DeltaView &delta;
+};
+
+} // namespace blob
+
+} // namespace engine
+
+#endif // __ENGINE_DELTA_MODEL_H__
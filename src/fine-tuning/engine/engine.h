@@ -0,0 +1,201 @@
+// Host execution engine running a Model layer by layer on a pluggable Backend.
+//
+// Unlike the generated cnn(), which keeps its activations and conv accumulators
+// in static storage, an Engine owns its ping-pong activation buffers so one
+// Engine per thread can score clips concurrently against a shared Backend.
+// With -DENGINE_INSTRUMENT each Engine also keeps per-layer counters (instrument.h).
+// While the trace recorder is enabled every layer is recorded as a span (trace.h).
+
+#ifndef __ENGINE_ENGINE_H__
+#define __ENGINE_ENGINE_H__
+
+#include <algorithm>
+#include <vector>
+
+#include "kernels.h"
+#include "model_desc.h"
+#include "trace.h"
+
+namespace engine {
+
+// Kernel provider. prepare() is called once per model before any kernel call and
+// may precompute per-layer state (packed weights...), indexed by layer position.
+// Kernels must only read that state so a prepared backend can be shared by threads.
+class Backend {
+public:
+	virtual ~Backend() {}
+	virtual const char *name() const = 0;
+	virtual void prepare(const Model &) {}
+
+	virtual void conv1d(size_t, const Layer &layer, const number_t *input, number_t *output) {
+		reference::conv1d(layer, input, output);
+	}
+	virtual void max_pool1d(size_t, const Layer &layer, const number_t *input, number_t *output) {
+		reference::max_pool1d(layer, input, output);
+	}
+	virtual void avg_pool1d(size_t, const Layer &layer, const number_t *input, number_t *output) {
+		reference::avg_pool1d(layer, input, output);
+	}
+	virtual void dense(size_t, const Layer &layer, const number_t *input, number_t *output) {
+		reference::dense(layer, input, output);
+	}
+};
+
+class ReferenceBackend : public Backend {
+public:
+	const char *name() const override { return "reference"; }
+};
+
+// Calls the generated layer functions themselves. They keep their conv
+// accumulators in static storage, so this backend is single-threaded only.
+class GeneratedBackend : public Backend {
+public:
+	const char *name() const override { return "generated"; }
+
+	void prepare(const Model &model) override {
+		for (const auto &layer : model.layers)
+			if (layer.kind != LayerKind::Flatten && !layer.generated)
+				fatal(model.name + ": " + layer.name + " has no generated function");
+	}
+
+	void conv1d(size_t, const Layer &layer, const number_t *input, number_t *output) override {
+		layer.generated(input, output);
+	}
+	void max_pool1d(size_t, const Layer &layer, const number_t *input, number_t *output) override {
+		layer.generated(input, output);
+	}
+	void avg_pool1d(size_t, const Layer &layer, const number_t *input, number_t *output) override {
+		layer.generated(input, output);
+	}
+	void dense(size_t, const Layer &layer, const number_t *input, number_t *output) override {
+		layer.generated(input, output);
+	}
+};
+
+// Reference kernels on weights kept in another form (delta, compressed): decode()
+// writes the kernel then the bias of conv1d/dense layer i into one scratch buffer
+// just before the layer runs. The buffer is shared by the layers, so backends
+// built on this one are single-threaded only.
+class DecodingBackend : public Backend {
+public:
+	void prepare(const Model &model) override {
+		layers = model.layers;
+		size_t size = 0;
+		for (const auto &layer : layers)
+			size = std::max(size, layer.weight_count() + (layer.has_weights() ? layer.filters : 0));
+		scratch.resize(size);
+		for (auto &layer : layers) {
+			if (!layer.has_weights())
+				continue;
+			layer.kernel = scratch.data();
+			layer.bias = scratch.data() + layer.weight_count();
+		}
+	}
+
+	void conv1d(size_t i, const Layer &, const number_t *input, number_t *output) override {
+		decode(i, scratch.data());
+		reference::conv1d(layers[i], input, output);
+	}
+	void dense(size_t i, const Layer &, const number_t *input, number_t *output) override {
+		decode(i, scratch.data());
+		reference::dense(layers[i], input, output);
+	}
+
+protected:
+	virtual void decode(size_t i, number_t *scratch) = 0;
+
+private:
+	std::vector<Layer> layers;		// Weights pointing into scratch
+	std::vector<number_t> scratch;
+};
+
+// Observer of the activations: Engine::run calls layer_input() before and
+// layer_output() after every computing layer, with its [channels][samples] input
+// and [filters][out_samples] output
+class ActivationSink {
+public:
+	virtual ~ActivationSink() {}
+	virtual void layer_input(size_t, const Layer &, const number_t *) {}
+	virtual void layer_output(size_t i, const Layer &layer, const number_t *output) = 0;
+};
+
+class Engine {
+public:
+	Engine(const Model &model, Backend &backend)
+		: model(model), backend(backend),
+		  activations1(model.max_activation_size()), activations2(model.max_activation_size())
+#ifdef ENGINE_INSTRUMENT
+		  , counters(model.layers.size())
+#endif
+		  {}
+
+	// input is [input_channels][input_samples], output receives output_size() values
+	void run(const number_t *input, number_t *output) {
+		const number_t *in = input;
+		number_t *buffers[2] = { activations1.data(), activations2.data() };
+		int next = 0;
+		const size_t last = last_compute_layer();
+
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			const Layer &layer = model.layers[i];
+			// Flatten is a no-op on the [channels][samples] layout
+			if (layer.kind == LayerKind::Flatten)
+				continue;
+			number_t *out = i == last ? output : buffers[next];
+			if (sink)
+				sink->layer_input(i, layer, in);
+			run_layer(i, in, out);
+			if (sink)
+				sink->layer_output(i, layer, out);
+			in = out;
+			next ^= 1;
+		}
+	}
+
+	void run_layer(size_t i, const number_t *input, number_t *output) {
+		const Layer &layer = model.layers[i];
+		trace::Scope span(layer.name.c_str(), "layer");
+#ifdef ENGINE_INSTRUMENT
+		instrument::current() = &counters[i];
+#endif
+		switch (layer.kind) {
+		case LayerKind::Conv1D: backend.conv1d(i, layer, input, output); break;
+		case LayerKind::MaxPool1D: backend.max_pool1d(i, layer, input, output); break;
+		case LayerKind::AvgPool1D: backend.avg_pool1d(i, layer, input, output); break;
+		case LayerKind::Dense: backend.dense(i, layer, input, output); break;
+		case LayerKind::Flatten: std::copy(input, input + layer.input_size(), output); break;
+		}
+#ifdef ENGINE_INSTRUMENT
+		instrument::current() = nullptr;
+		if (layer.kind != LayerKind::Flatten)
+			instrument::count_outputs(output, layer.output_size(), counters[i]);
+#endif
+	}
+
+	const Model &get_model() const { return model; }
+	void set_sink(ActivationSink *s) { sink = s; }
+#ifdef ENGINE_INSTRUMENT
+	const std::vector<LayerCounters> &get_counters() const { return counters; }
+#endif
+
+private:
+	const Model &model;
+	Backend &backend;
+	ActivationSink *sink = nullptr;
+	std::vector<number_t> activations1;
+	std::vector<number_t> activations2;
+#ifdef ENGINE_INSTRUMENT
+	std::vector<LayerCounters> counters;
+#endif
+
+	size_t last_compute_layer() const {
+		size_t last = model.layers.size() - 1;
+		while (last > 0 && model.layers[last].kind == LayerKind::Flatten)
+			last--;
+		return last;
+	}
+};
+
+} // namespace engine
+
+#endif // __ENGINE_ENGINE_H__
@@ -0,0 +1,136 @@
+// Per-layer fixed-point formats chosen at build time.
+//
+// FixedEngine takes the precision of every conv1d/dense layer as a build-time list
+// of LayerPrecision<Activation, Weight> of Fixed formats (fixed_point.h) and runs
+// the reference kernels (kernels.h) instantiated on them: products are
+// accumulated in long_number_t, shifted by In + W - Out fractional bits, the bias
+// (in the output format) is added, then ReLU and saturation. With every format
+// Q6.9 this is exactly scale_number_t/clamp_to_number_t, so results are bit-exact
+// with the generated kernels. Pooling and flatten keep the format of their input.
+
+#ifndef __ENGINE_FIXED_H__
+#define __ENGINE_FIXED_H__
+
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "engine.h"
+#include "fixed_point.h"
+
+namespace engine {
+
+// Output (activation) and weight formats of a conv1d/dense layer; the bias uses the output format
+template<typename Activation, typename Weight = Activation>
+struct LayerPrecision {
+	typedef Activation activation;
+	typedef Weight weight;
+};
+
+// Runs a Model with Input as the format of the model input and one LayerPrecision
+// per conv1d/dense layer, in order. Weights are converted from the model's int16
+// representation once, with rounding.
+template<typename Input, typename... Layers>
+class FixedEngine {
+public:
+	typedef typename std::tuple_element<sizeof...(Layers) - 1, std::tuple<Layers...>>::type::activation Output;
+
+	explicit FixedEngine(const Model &model) : model(model) {
+		size_t weighted = 0;
+		for (const auto &layer : model.layers)
+			weighted += layer.has_weights();
+		if (weighted != sizeof...(Layers))
+			fatal(model.name + ": " + std::to_string(weighted) + " conv1d/dense layers, precision given for "
+					+ std::to_string(sizeof...(Layers)));
+		allocate<0>();
+		convert_weights<0>(0);
+	}
+
+	// input in the model's int16 representation
+	void run(const number_t *input, Output *output) {
+		Input *in = buffer<0>(0);
+		for (size_t i = 0; i < model.input_size(); i++)
+			in[i] = fixed_convert<Input>(input[i], model.fixed_point);
+		run_from<0>(0, in, 1, output);
+	}
+
+	const Model &get_model() const { return model; }
+
+private:
+	// Ping-pong buffers of one activation format
+	template<typename T>
+	struct Buffers {
+		std::vector<T> data[2];
+	};
+
+	const Model &model;
+	std::tuple<std::vector<typename Layers::weight>...> kernels;
+	std::tuple<std::vector<typename Layers::activation>...> biases;
+	// Stage 0 holds the input format, stage K + 1 the output of the K-th conv1d/dense layer
+	std::tuple<Buffers<Input>, Buffers<typename Layers::activation>...> stages;
+
+	template<size_t Stage>
+	auto *buffer(int index) {
+		return std::get<Stage>(stages).data[index].data();
+	}
+
+	template<size_t Stage>
+	void allocate() {
+		if constexpr (Stage <= sizeof...(Layers)) {
+			for (auto &data : std::get<Stage>(stages).data)
+				data.resize(model.max_activation_size());
+			allocate<Stage + 1>();
+		}
+	}
+
+	template<size_t K>
+	void convert_weights(size_t i) {
+		if constexpr (K < sizeof...(Layers)) {
+			typedef typename std::tuple_element<K, std::tuple<Layers...>>::type P;
+			while (!model.layers[i].has_weights())
+				i++;
+			const Layer &layer = model.layers[i];
+			for (size_t n = 0; n < layer.weight_count(); n++)
+				std::get<K>(kernels).push_back(fixed_convert_round<typename P::weight>(layer.kernel[n], model.fixed_point));
+			for (size_t f = 0; f < layer.filters; f++)
+				std::get<K>(biases).push_back(fixed_convert_round<typename P::activation>(layer.bias[f], model.fixed_point));
+			convert_weights<K + 1>(i + 1);
+		}
+	}
+
+	// Layers from i on, the K-th conv1d/dense layer being the next weighted one;
+	// in is in stage K, next its free buffer
+	template<size_t K, typename In>
+	void run_from(size_t i, In *in, int next, Output *output) {
+		for (; i < model.layers.size() && !model.layers[i].has_weights(); i++) {
+			const Layer &layer = model.layers[i];
+			if (layer.kind == LayerKind::Flatten)
+				continue;
+			In *out = buffer<K>(next);
+			if (layer.kind == LayerKind::MaxPool1D)
+				reference::max_pool1d(layer, in, out);
+			else
+				reference::avg_pool1d(layer, in, out);
+			in = out;
+			next ^= 1;
+		}
+
+		if constexpr (K < sizeof...(Layers)) {
+			typedef typename std::tuple_element<K, std::tuple<Layers...>>::type P;
+			typedef typename P::activation Out;
+			const Layer &layer = model.layers[i];
+			Out *out = buffer<K + 1>(0);
+			if (layer.kind == LayerKind::Dense)
+				reference::dense(layer, in, std::get<K>(kernels).data(), std::get<K>(biases).data(), out);
+			else
+				reference::conv1d(layer, in, std::get<K>(kernels).data(), std::get<K>(biases).data(), out);
+			run_from<K + 1>(i + 1, out, 1, output);
+		} else {
+			std::copy(in, in + model.output_size(), output);
+		}
+	}
+};
+
+} // namespace engine
+
+#endif // __ENGINE_FIXED_H__
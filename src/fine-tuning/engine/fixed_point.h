@@ -0,0 +1,83 @@
+// Fixed-point value type with its Q-format in the type.
+//
+// Fixed<Storage, FracBits> is a signed integer holding value * 2^FracBits, so
+// number.h's number_t with FIXED_POINT 9 is Fixed<int16_t, 9> (Q6.9).
+// Conversions between formats shift by the difference of fractional bits
+// (arithmetic shift, truncating like scale_number_t) and saturate to the
+// destination storage (like clamp_to_number_t). The reference kernels
+// (kernels.h) are templated on it; see fixed.h for per-layer formats.
+
+#ifndef __ENGINE_FIXED_POINT_H__
+#define __ENGINE_FIXED_POINT_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "model_desc.h"
+
+namespace engine {
+
+template<typename Storage, int FracBits>
+struct Fixed {
+	static_assert(std::is_integral<Storage>::value && std::is_signed<Storage>::value, "Fixed storage must be a signed integer");
+	static_assert(sizeof(Storage) <= sizeof(int16_t), "products must fit long_number_t accumulators");
+	static_assert(FracBits >= 0 && FracBits < 8 * (int)sizeof(Storage), "fractional bits out of range");
+
+	typedef Storage storage_type;
+	static constexpr int frac_bits = FracBits;
+	static constexpr int64_t min = std::numeric_limits<Storage>::min();
+	static constexpr int64_t max = std::numeric_limits<Storage>::max();
+
+	Storage raw;
+
+	static Fixed from_raw(Storage raw) { return Fixed{ raw }; }
+	static Fixed saturate(int64_t raw) { return Fixed{ (Storage)std::max(min, std::min(max, raw)) }; }
+	static Fixed from_double(double value) { return saturate(std::llround(std::ldexp(value, FracBits))); }
+	double to_double() const { return std::ldexp((double)raw, -FracBits); }
+};
+
+typedef Fixed<number_t, 9> Q6_9;	// number.h with FIXED_POINT 9
+
+template<typename T>
+struct is_fixed : std::false_type {};
+template<typename Storage, int FracBits>
+struct is_fixed<Fixed<Storage, FracBits>> : std::true_type {};
+
+// Integer operand of a kernel: number_t itself, or the raw value of a Fixed
+inline number_t raw(number_t value) { return value; }
+template<typename Storage, int FracBits>
+inline Storage raw(Fixed<Storage, FracBits> value) { return value.raw; }
+
+// value * 2^-shift, arithmetic (flooring) shift for shift > 0
+inline int64_t shift_right(int64_t value, int shift) {
+	return shift >= 0 ? value >> shift : value * (int64_t(1) << -shift);
+}
+
+// Same with rounding to nearest, for offline conversions
+inline int64_t shift_right_round(int64_t value, int shift) {
+	return shift > 0 ? (value + (int64_t(1) << (shift - 1))) >> shift : shift_right(value, shift);
+}
+
+// Raw value with frac_bits fractional bits to To, truncating like scale_number_t
+template<typename To>
+inline To fixed_convert(int64_t raw, int frac_bits) {
+	return To::saturate(shift_right(raw, frac_bits - To::frac_bits));
+}
+
+template<typename To, typename From>
+inline To fixed_cast(From value) {
+	return fixed_convert<To>(value.raw, From::frac_bits);
+}
+
+// Rounded conversion, used for weights
+template<typename To>
+inline To fixed_convert_round(int64_t raw, int frac_bits) {
+	return To::saturate(shift_right_round(raw, frac_bits - To::frac_bits));
+}
+
+} // namespace engine
+
+#endif // __ENGINE_FIXED_POINT_H__
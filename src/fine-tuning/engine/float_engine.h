@@ -0,0 +1,191 @@
+// Float32 execution engine with vectorised kernels.
+//
+// Runs the same layer descriptions as engine::Engine on the dequantised weights of
+// a FloatModel (float_model.h), as an accuracy baseline and a throughput reference
+// for the fixed-point engines. Results match float_reference up to float rounding
+// (the summation order differs).
+//
+// conv1d weights are packed at load as [C*K][F] with F padded to whole vectors, so
+// the microkernel keeps VL filters x POSITIONS outputs in vector registers: per
+// weight tap it loads one filter vector and multiply-adds it with POSITIONS
+// broadcast inputs. Dense layers are dot products over VL-wide partial sums.
+// Vectors use the GCC vector extension like winograd.h: 256-bit, one AVX register
+// when built with -mavx2 -mfma (-march=native), two SSE registers otherwise.
+
+#ifndef __ENGINE_FLOAT_ENGINE_H__
+#define __ENGINE_FLOAT_ENGINE_H__
+
+#include <cstring>
+#include <vector>
+
+#include "float_model.h"
+
+namespace engine {
+
+namespace float_simd {
+
+static const size_t VL = 8;			// Floats per vector
+static const size_t POSITIONS = 8;	// Output samples per microkernel call
+
+typedef float float_vec __attribute__((vector_size(VL * sizeof(float))));
+
+// Kernel [F][C][K] -> [C*K][F rounded up to VL], zero padded
+struct PackedWeights {
+	size_t depth;
+	size_t padded_filters;
+	std::vector<float> data;
+	std::vector<float> bias;	// Padded like the filters
+};
+
+inline PackedWeights pack_weights(const Layer &layer, const float *kernel, const float *bias) {
+	PackedWeights packed;
+	const size_t F = layer.filters;
+	packed.depth = layer.channels * layer.kernel_size;
+	packed.padded_filters = (F + VL - 1) / VL * VL;
+	packed.data.assign(packed.depth * packed.padded_filters, 0);
+	packed.bias.assign(packed.padded_filters, 0);
+	for (size_t f = 0; f < F; f++) {
+		for (size_t d = 0; d < packed.depth; d++)
+			packed.data[d * packed.padded_filters + f] = kernel[f * packed.depth + d];
+		packed.bias[f] = bias[f];
+	}
+	return packed;
+}
+
+// By reference: returning a vector type would change the ABI without AVX
+static inline void load(float_vec &v, const float *p) {
+	memcpy(&v, p, sizeof(v));
+}
+
+// np (<= POSITIONS) outputs from position p for the VL filters starting at fb
+static inline void microkernel(const Layer &layer, const PackedWeights &w, const float *input,
+		size_t fb, size_t p, size_t np, float *output) {
+	const size_t K = layer.kernel_size, S = layer.samples, stride = layer.stride;
+	float_vec acc[POSITIONS];
+	float_vec bias;
+	load(bias, &w.bias[fb]);
+	for (size_t j = 0; j < POSITIONS; j++)
+		acc[j] = bias;
+
+	for (size_t c = 0; c < layer.channels; c++) {
+		const float *in = input + c * S + p * stride;
+		const float *wc = &w.data[c * K * w.padded_filters + fb];
+		for (size_t x = 0; x < K; x++) {
+			float_vec wv;
+			load(wv, wc + x * w.padded_filters);
+			// Positions past np read valid input of the next windows or are
+			// clamped to the last one; their results are dropped
+			for (size_t j = 0; j < POSITIONS; j++)
+				acc[j] += wv * in[std::min(j, np - 1) * stride + x];
+		}
+	}
+
+	const size_t nf = std::min(VL, layer.filters - fb);
+	for (size_t j = 0; j < np; j++)
+		for (size_t l = 0; l < nf; l++) {
+			float v = acc[j][l];
+			output[(fb + l) * layer.out_samples + p + j] = layer.relu && v < 0 ? 0 : v;
+		}
+}
+
+inline void conv1d(const Layer &layer, const PackedWeights &weights, const float *input, float *output) {
+	for (size_t p = 0; p < layer.out_samples; p += POSITIONS) {
+		const size_t np = std::min(POSITIONS, layer.out_samples - p);
+		for (size_t fb = 0; fb < layer.filters; fb += VL)
+			microkernel(layer, weights, input, fb, p, np, output);
+	}
+}
+
+inline void dense(const Layer &layer, const float *kernel, const float *bias, const float *input, float *output) {
+	const size_t N = layer.channels, vectors = N / VL;
+	for (size_t f = 0; f < layer.filters; f++) {
+		const float *w = kernel + f * N;
+		float_vec sum = {};
+		for (size_t v = 0; v < vectors; v++) {
+			float_vec a, b;
+			load(a, w + v * VL);
+			load(b, input + v * VL);
+			sum += a * b;
+		}
+		float acc = bias[f];
+		for (size_t l = 0; l < VL; l++)
+			acc += sum[l];
+		for (size_t z = vectors * VL; z < N; z++)
+			acc += w[z] * input[z];
+		output[f] = layer.relu && acc < 0 ? 0 : acc;
+	}
+}
+
+// Taps outermost so the loop over output samples vectorises
+inline void max_pool1d(const Layer &layer, const float *input, float *output) {
+	const size_t OS = layer.out_samples, stride = layer.stride;
+	for (size_t k = 0; k < layer.channels; k++) {
+		const float *in = input + k * layer.samples;
+		float *out = output + k * OS;
+		for (size_t p = 0; p < OS; p++)
+			out[p] = layer.relu ? std::max(0.f, in[p * stride]) : in[p * stride];
+		for (size_t x = 1; x < layer.kernel_size; x++)
+			for (size_t p = 0; p < OS; p++)
+				out[p] = std::max(out[p], in[p * stride + x]);
+	}
+}
+
+} // namespace float_simd
+
+class FloatEngine {
+public:
+	explicit FloatEngine(const Model &model)
+		: model(model), weights(model), packed(model.layers.size()),
+		  activations1(model.max_activation_size()), activations2(model.max_activation_size()) {
+		for (size_t i = 0; i < model.layers.size(); i++)
+			if (model.layers[i].kind == LayerKind::Conv1D)
+				packed[i] = float_simd::pack_weights(model.layers[i], weights.kernels[i].data(), weights.biases[i].data());
+	}
+
+	// Real-valued input [input_channels][input_samples], output_size() values
+	void run(const float *input, float *output) {
+		const float *in = input;
+		float *buffers[2] = { activations1.data(), activations2.data() };
+		int next = 0;
+
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			const Layer &layer = model.layers[i];
+			if (layer.kind == LayerKind::Flatten)
+				continue;
+			float *out = buffers[next];
+			switch (layer.kind) {
+			case LayerKind::Conv1D: float_simd::conv1d(layer, packed[i], in, out); break;
+			case LayerKind::Dense: float_simd::dense(layer, weights.kernels[i].data(), weights.biases[i].data(), in, out); break;
+			case LayerKind::MaxPool1D: float_simd::max_pool1d(layer, in, out); break;
+			case LayerKind::AvgPool1D: float_reference::avg_pool1d(layer, in, out); break;
+			case LayerKind::Flatten: break;
+			}
+			in = out;
+			next ^= 1;
+		}
+		std::copy(in, in + model.output_size(), output);
+	}
+
+	// int16 input like engine::Engine, dequantised first
+	void run(const number_t *input, float *output) {
+		const float unit = weights.input_value(1);
+		input_values.resize(model.input_size());
+		for (size_t n = 0; n < input_values.size(); n++)
+			input_values[n] = input[n] * unit;
+		run(input_values.data(), output);
+	}
+
+	const FloatModel &get_weights() const { return weights; }
+
+private:
+	const Model &model;
+	FloatModel weights;
+	std::vector<float_simd::PackedWeights> packed;
+	std::vector<float> activations1;
+	std::vector<float> activations2;
+	std::vector<float> input_values;
+};
+
+} // namespace engine
+
+#endif // __ENGINE_FLOAT_ENGINE_H__
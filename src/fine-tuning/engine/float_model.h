@@ -0,0 +1,107 @@
+// Float32 execution of a Model, weights dequantised at load.
+//
+// A FloatModel holds kernel and bias values divided by 2^fixed_point, i.e. the
+// real numbers the int16 model approximates. The reference kernels follow the
+// generated loops without any shift or saturation: conv1d/dense accumulate in
+// float, add the bias and apply ReLU; average pooling divides by the pool size.
+
+#ifndef __ENGINE_FLOAT_MODEL_H__
+#define __ENGINE_FLOAT_MODEL_H__
+
+#include <cmath>
+#include <vector>
+
+#include "model_desc.h"
+
+namespace engine {
+
+struct FloatModel {
+	const Model *source;
+	std::vector<std::vector<float>> kernels;	// Per layer, empty for weightless layers
+	std::vector<std::vector<float>> biases;
+
+	explicit FloatModel(const Model &model) : source(&model), kernels(model.layers.size()), biases(model.layers.size()) {
+		const float unit = std::ldexp(1.f, -model.fixed_point);
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			const Layer &layer = model.layers[i];
+			for (size_t n = 0; n < layer.weight_count(); n++)
+				kernels[i].push_back(layer.kernel[n] * unit);
+			for (size_t f = 0; layer.has_weights() && f < layer.filters; f++)
+				biases[i].push_back(layer.bias[f] * unit);
+		}
+	}
+
+	// Real value of an int16 model input
+	float input_value(number_t v) const { return std::ldexp((float)v, -source->fixed_point); }
+};
+
+namespace float_reference {
+
+inline void conv1d(const Layer &layer, const float *kernel, const float *bias, const float *input, float *output) {
+	const size_t C = layer.channels, S = layer.samples, K = layer.kernel_size;
+	for (size_t k = 0; k < layer.filters; k++)
+		for (size_t pos_x = 0; pos_x < layer.out_samples; pos_x++) {
+			float acc = 0;
+			for (size_t z = 0; z < C; z++) {
+				const float *in = input + z * S + pos_x * layer.stride;
+				const float *w = kernel + (k * C + z) * K;
+				for (size_t x = 0; x < K; x++)
+					acc += in[x] * w[x];
+			}
+			acc += bias[k];
+			output[k * layer.out_samples + pos_x] = layer.relu && acc < 0 ? 0 : acc;
+		}
+}
+
+inline void dense(const Layer &layer, const float *kernel, const float *bias, const float *input, float *output) {
+	for (size_t k = 0; k < layer.filters; k++) {
+		const float *w = kernel + k * layer.channels;
+		float acc = 0;
+		for (size_t z = 0; z < layer.channels; z++)
+			acc += w[z] * input[z];
+		acc += bias[k];
+		output[k] = layer.relu && acc < 0 ? 0 : acc;
+	}
+}
+
+inline void max_pool1d(const Layer &layer, const float *input, float *output) {
+	for (size_t k = 0; k < layer.channels; k++)
+		for (size_t pos_x = 0; pos_x < layer.out_samples; pos_x++) {
+			const float *window = input + k * layer.samples + pos_x * layer.stride;
+			float max = layer.relu ? 0 : window[0];
+			for (size_t x = 0; x < layer.kernel_size; x++)
+				max = std::max(max, window[x]);
+			output[k * layer.out_samples + pos_x] = max;
+		}
+}
+
+inline void avg_pool1d(const Layer &layer, const float *input, float *output) {
+	for (size_t k = 0; k < layer.channels; k++)
+		for (size_t pos_x = 0; pos_x < layer.out_samples; pos_x++) {
+			const float *window = input + k * layer.samples + pos_x * layer.stride;
+			float sum = 0;
+			for (size_t x = 0; x < layer.kernel_size; x++)
+				sum += window[x];
+			if (layer.relu && sum < 0)
+				sum = 0;
+			output[k * layer.out_samples + pos_x] = sum / layer.kernel_size;
+		}
+}
+
+// Layer i of model on input; Flatten copies
+inline void run_layer(const FloatModel &model, size_t i, const float *input, float *output) {
+	const Layer &layer = model.source->layers[i];
+	switch (layer.kind) {
+	case LayerKind::Conv1D: conv1d(layer, model.kernels[i].data(), model.biases[i].data(), input, output); break;
+	case LayerKind::Dense: dense(layer, model.kernels[i].data(), model.biases[i].data(), input, output); break;
+	case LayerKind::MaxPool1D: max_pool1d(layer, input, output); break;
+	case LayerKind::AvgPool1D: avg_pool1d(layer, input, output); break;
+	case LayerKind::Flatten: std::copy(input, input + layer.input_size(), output); break;
+	}
+}
+
+} // namespace float_reference
+
+} // namespace engine
+
+#endif // __ENGINE_FLOAT_MODEL_H__
@@ -0,0 +1,192 @@
+// im2col + blocked int16 GEMM backend for conv1d layers.
+//
+// Each conv1d is lowered to out[F][OS] = W[F][C*K] x cols[C*K][OS] where
+// cols[c*K + x][p] = input[c][p*stride + x]. The im2col matrix is never
+// materialised: column panels are gathered straight from the input while packing.
+//
+// Blocking follows the usual GEMM layering:
+//  - weights are packed once in prepare() into MR-row panels,
+//  - for each NC-wide column block and KC-deep slice, im2col columns are packed
+//    into NR-wide panels (KC x NR int16 panel stays in L1, KC x NC block in L2),
+//  - an MR x NR register-tiled microkernel accumulates int16 x int16 -> int32.
+// There is no row (MC) block: the largest layer has 64 filters, so all packed
+// weights of a KC slice (64 x 256 x 2 bytes) already fit in L2.
+// On the last depth slice the microkernel applies the conv epilogue
+// (scale_number_t, bias, ReLU, clamp_to_number_t) directly on its accumulators.
+// They are unsigned, so sums wrap modulo 2^32 in any order without undefined
+// behaviour, and results are bit-exact with the reference wherever its int32
+// sum does not overflow.
+//
+// The kernels are templated on the accumulator type. With 16-bit accumulators
+// (only valid where range.h proves the exact sums fit, see NarrowBackend) the
+// microkernel covers twice as many columns per vector.
+
+#ifndef __ENGINE_GEMM_H__
+#define __ENGINE_GEMM_H__
+
+#include <type_traits>
+#include <vector>
+
+#include "engine.h"
+
+namespace engine {
+
+namespace gemm {
+
+static const size_t MR = 4;		// Microkernel rows (filters)
+static const size_t KC = 256;	// Depth slice: KC x NR x 2 bytes = 4 KiB B panel in L1 (NR = 8)
+static const size_t NC = 512;	// Column block: KC x NC x 2 bytes = 256 KiB in L2
+
+// Microkernel columns (output samples): one 256-bit vector of accumulators
+template<typename Acc>
+struct Columns {
+	static const size_t NR = 32 / sizeof(Acc);
+};
+
+// Wrapping accumulation in the unsigned type of Acc: sums are exact whenever the
+// final value fits in Acc
+template<typename Acc>
+using Wrapping = typename std::make_unsigned<Acc>::type;
+
+template<typename Acc>
+static inline long_number_t accumulator_value(Wrapping<Acc> acc) {
+	return (typename std::make_signed<Acc>::type)acc;
+}
+
+// Weights [F][C*K] packed as ceil(F/MR) panels of [C*K][MR], zero padded
+struct PackedWeights {
+	size_t rows;
+	size_t depth;
+	std::vector<number_t> data;
+};
+
+inline PackedWeights pack_weights(const Layer &layer) {
+	PackedWeights packed;
+	packed.rows = layer.filters;
+	packed.depth = layer.channels * layer.kernel_size;
+	size_t panels = (packed.rows + MR - 1) / MR;
+	packed.data.assign(panels * packed.depth * MR, 0);
+
+	for (size_t p = 0; p < panels; p++)
+		for (size_t d = 0; d < packed.depth; d++)
+			for (size_t r = 0; r < MR && p * MR + r < packed.rows; r++)
+				packed.data[(p * packed.depth + d) * MR + r] = layer.kernel[(p * MR + r) * packed.depth + d];
+	return packed;
+}
+
+// Gathers im2col rows [pc, pc+kc) x columns [jc, jc+nc) into NR-wide panels of [kc][NR]
+template<size_t NR>
+inline void pack_columns(const Layer &layer, const number_t *input,
+		size_t pc, size_t kc, size_t jc, size_t nc, number_t *panel) {
+	const size_t K = layer.kernel_size;
+	for (size_t jp = 0; jp < nc; jp += NR) {
+		size_t nr = std::min(NR, nc - jp);
+		for (size_t d = 0; d < kc; d++) {
+			size_t c = (pc + d) / K, x = (pc + d) % K;
+			const number_t *row = input + c * layer.samples + x + (jc + jp) * layer.stride;
+			size_t j = 0;
+			for (; j < nr; j++)
+				panel[d * NR + j] = row[j * layer.stride];
+			for (; j < NR; j++)
+				panel[d * NR + j] = 0;
+		}
+		panel += kc * NR;
+	}
+}
+
+// acc[MR][NR] += A[kc][MR] x B[kc][NR]. With first = false the running sums are
+// reloaded from partial; with last = true the epilogue writes number_t outputs,
+// otherwise the sums are stored back to partial.
+template<typename Acc>
+inline void microkernel(size_t kc, const number_t *a, const number_t *b,
+		bool first, bool last, size_t mr, size_t nr,
+		Wrapping<Acc> *partial, size_t partial_stride,
+		const Layer &layer, size_t row, number_t *output, size_t col) {
+	const size_t NR = Columns<Acc>::NR;
+	Wrapping<Acc> acc[MR][NR];
+
+	for (size_t i = 0; i < MR; i++)
+		for (size_t j = 0; j < NR; j++)
+			acc[i][j] = first ? 0 : partial[i * partial_stride + j];
+
+	for (size_t d = 0; d < kc; d++) {
+		const number_t *ad = a + d * MR;
+		const number_t *bd = b + d * NR;
+		for (size_t i = 0; i < MR; i++)
+			for (size_t j = 0; j < NR; j++)
+				acc[i][j] += (Wrapping<Acc>)((long_number_t)ad[i] * bd[j]);
+	}
+
+	if (last) {
+		for (size_t i = 0; i < mr; i++) {
+			number_t *out = output + (row + i) * layer.out_samples + col;
+			long_number_t bias = layer.bias[row + i];
+			for (size_t j = 0; j < nr; j++)
+				out[j] = requantize(accumulator_value<Acc>(acc[i][j]), layer.shift, bias, layer.relu);
+		}
+	} else {
+		for (size_t i = 0; i < MR; i++)
+			for (size_t j = 0; j < NR; j++)
+				partial[i * partial_stride + j] = acc[i][j];
+	}
+}
+
+template<typename Acc = long_number_t>
+inline void conv1d(const Layer &layer, const PackedWeights &weights, const number_t *input, number_t *output) {
+	static thread_local std::vector<number_t> panel;
+	static thread_local std::vector<Wrapping<Acc>> partial;
+	const size_t NR = Columns<Acc>::NR;
+
+	const size_t M = weights.rows, N = layer.out_samples, depth = weights.depth;
+	const size_t padded_rows = (M + MR - 1) / MR * MR;
+
+	panel.resize(KC * ((std::min(NC, N) + NR - 1) / NR * NR));
+	if (depth > KC)
+		partial.resize(padded_rows * ((std::min(NC, N) + NR - 1) / NR * NR));
+
+	for (size_t jc = 0; jc < N; jc += NC) {
+		size_t nc = std::min(NC, N - jc);
+		size_t partial_stride = (nc + NR - 1) / NR * NR;
+
+		for (size_t pc = 0; pc < depth; pc += KC) {
+			size_t kc = std::min(KC, depth - pc);
+			bool first = pc == 0, last = pc + kc == depth;
+			pack_columns<NR>(layer, input, pc, kc, jc, nc, panel.data());
+
+			for (size_t jr = 0; jr < nc; jr += NR) {
+				const number_t *b = panel.data() + jr * kc;
+				for (size_t row = 0; row < M; row += MR) {
+					const number_t *a = weights.data.data() + ((row / MR) * depth + pc) * MR;
+					Wrapping<Acc> *p = last && first ? nullptr : partial.data() + row * partial_stride + jr;
+					microkernel<Acc>(kc, a, b, first, last, std::min(MR, M - row), std::min(NR, nc - jr),
+							p, partial_stride, layer, row, output, jc + jr);
+				}
+			}
+		}
+	}
+}
+
+} // namespace gemm
+
+class GemmBackend : public Backend {
+public:
+	const char *name() const override { return "gemm"; }
+
+	void prepare(const Model &model) override {
+		packed.assign(model.layers.size(), gemm::PackedWeights());
+		for (size_t i = 0; i < model.layers.size(); i++)
+			if (model.layers[i].kind == LayerKind::Conv1D)
+				packed[i] = gemm::pack_weights(model.layers[i]);
+	}
+
+	void conv1d(size_t i, const Layer &layer, const number_t *input, number_t *output) override {
+		gemm::conv1d(layer, packed.at(i), input, output);
+	}
+
+protected:
+	std::vector<gemm::PackedWeights> packed;
+};
+
+} // namespace engine
+
+#endif // __ENGINE_GEMM_H__
@@ -0,0 +1,98 @@
+// Optional per-layer saturation and overflow counters.
+//
+// Built only with -DENGINE_INSTRUMENT. The shared conv/dense epilogue
+// (requantize in kernels.h) then records, for the layer an Engine is running,
+// every output clamped by clamp_to_number_t (high and low separately) and every
+// accumulator within NEAR_OVERFLOW_BITS of wrapping int32. The Engine itself counts
+// the outputs and zero outputs of every layer. Without the macro nothing here is
+// compiled into the kernels.
+//
+// Kernels that bypass requantize (GeneratedBackend, which calls the generated
+// functions) only get the output and zero counts.
+
+#ifndef __ENGINE_INSTRUMENT_H__
+#define __ENGINE_INSTRUMENT_H__
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "model_desc.h"
+
+namespace engine {
+
+struct LayerCounters {
+	uint64_t outputs = 0;
+	uint64_t zeros = 0;
+	uint64_t clamped_high = 0;		// Scaled accumulator + bias above NUMBER_T_MAX
+	uint64_t clamped_low = 0;		// Below NUMBER_T_MIN (never with ReLU)
+	uint64_t near_overflow = 0;		// |accumulator| >= 2^NEAR_OVERFLOW_BITS
+	uint64_t accumulators = 0;		// Accumulators seen by the epilogue
+
+	LayerCounters &operator+=(const LayerCounters &o) {
+		outputs += o.outputs;
+		zeros += o.zeros;
+		clamped_high += o.clamped_high;
+		clamped_low += o.clamped_low;
+		near_overflow += o.near_overflow;
+		accumulators += o.accumulators;
+		return *this;
+	}
+};
+
+namespace instrument {
+
+static const int NEAR_OVERFLOW_BITS = 30;	// One bit of headroom left in int32
+
+#ifdef ENGINE_INSTRUMENT
+// Counters of the layer being run on this thread, set by Engine::run_layer
+inline LayerCounters *&current() {
+	static thread_local LayerCounters *counters = nullptr;
+	return counters;
+}
+
+// acc: int32 accumulator, value: scaled accumulator + bias before ReLU/clamp
+static inline void requantized(long_number_t acc, long_number_t value, bool relu) {
+	LayerCounters *c = current();
+	if (!c)
+		return;
+	c->accumulators++;
+	const long_number_t limit = long_number_t(1) << NEAR_OVERFLOW_BITS;
+	c->near_overflow += acc >= limit || acc <= -limit;
+	c->clamped_high += value > NUMBER_T_MAX;
+	c->clamped_low += !relu && value < NUMBER_T_MIN;
+}
+#endif
+
+inline void count_outputs(const number_t *output, size_t size, LayerCounters &c) {
+	c.outputs += size;
+	for (size_t n = 0; n < size; n++)
+		c.zeros += output[n] == 0;
+}
+
+// Element-wise sum, e.g. of per-thread Engine counters
+inline void merge(std::vector<LayerCounters> &total, const std::vector<LayerCounters> &counters) {
+	total.resize(std::max(total.size(), counters.size()));
+	for (size_t i = 0; i < counters.size(); i++)
+		total[i] += counters[i];
+}
+
+inline void write_json(std::ostream &out, const Model &model, const std::vector<LayerCounters> &counters, size_t clips) {
+	out << "{\n  \"model\": \"" << model.name << "\",\n  \"clips\": " << clips
+		<< ",\n  \"near_overflow_bits\": " << NEAR_OVERFLOW_BITS << ",\n  \"layers\": [";
+	for (size_t i = 0; i < model.layers.size() && i < counters.size(); i++) {
+		const Layer &layer = model.layers[i];
+		const LayerCounters &c = counters[i];
+		out << (i ? "," : "") << "\n    { \"name\": \"" << layer.name << "\", \"kind\": \"" << layer_kind_name(layer.kind)
+			<< "\", \"outputs\": " << c.outputs << ", \"zeros\": " << c.zeros
+			<< ", \"clamped_high\": " << c.clamped_high << ", \"clamped_low\": " << c.clamped_low
+			<< ", \"accumulators\": " << c.accumulators << ", \"near_overflow\": " << c.near_overflow << " }";
+	}
+	out << "\n  ]\n}\n";
+}
+
+} // namespace instrument
+
+} // namespace engine
+
+#endif // __ENGINE_INSTRUMENT_H__
@@ -0,0 +1,307 @@
+// Int8 execution mode: int8 weights and activations, int32 accumulators.
+//
+// A Model is quantised from its int16 weights (real value = w / 2^fixed_point):
+//  - weights symmetrically per output channel, w8 = round(w / weight_scale[f]),
+//  - activations symmetrically per tensor, with scales calibrated on host data as
+//    the largest magnitude seen at every layer output of the int16 model,
+//  - biases to int32 in the accumulator scale weight_scale[f] * input_scale.
+// The conv1d/dense epilogue rescales the accumulator to the output scale with a
+// per-channel fixed-point multiplier M = weight_scale * input_scale / output_scale
+// stored as a Q31 mantissa and a power of two exponent, then ReLU and saturation
+// to int8. Max pooling keeps the input scale, average pooling divides the int32
+// sum with the same truncation as the int16 kernel.
+//
+// Weights and the two activation buffers take half the memory of the int16 model,
+// plus one int32 accumulator per filter for conv1d (ram_bytes()); results
+// approximate it, see tools/int8_eval for the accuracy.
+
+#ifndef __ENGINE_INT8_H__
+#define __ENGINE_INT8_H__
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "engine.h"
+
+namespace engine {
+
+namespace int8 {
+
+typedef int8_t q7_t;
+
+static const int32_t Q7_MIN = -128;
+static const int32_t Q7_MAX = 127;
+
+inline q7_t saturate(int64_t value) {
+	return (q7_t)std::max<int64_t>(Q7_MIN, std::min<int64_t>(Q7_MAX, value));
+}
+
+inline q7_t quantize(double real, double scale) {
+	return saturate(std::llround(real / scale));
+}
+
+// Real multiplier as mantissa * 2^(exponent - 31), mantissa in [2^30, 2^31)
+struct Multiplier {
+	int32_t mantissa;
+	int exponent;
+};
+
+inline Multiplier quantize_multiplier(double real) {
+	Multiplier m = { 0, 0 };
+	if (real <= 0)
+		return m;
+	double q = std::frexp(real, &m.exponent);	// real = q * 2^exponent, q in [0.5, 1)
+	int64_t mantissa = std::llround(q * (int64_t(1) << 31));
+	if (mantissa == (int64_t(1) << 31)) {
+		mantissa /= 2;
+		m.exponent++;
+	}
+	m.mantissa = (int32_t)mantissa;
+	return m;
+}
+
+// round(acc * mantissa * 2^(exponent - 31)), rounding half up
+inline int64_t apply_multiplier(int32_t acc, const Multiplier &m) {
+	int64_t product = (int64_t)acc * m.mantissa;
+	int shift = 31 - m.exponent;
+	if (shift <= 0)
+		return product * (int64_t(1) << -shift);
+	if (shift > 62)
+		return 0;
+	return (product + (int64_t(1) << (shift - 1))) >> shift;
+}
+
+struct Layer {
+	double input_scale;
+	double output_scale;
+	std::vector<q7_t> kernel;			// Conv1D/Dense, same layout as the int16 kernel
+	std::vector<q7_t> kernel_t;			// Conv1D transposed to [C][K][F]
+	std::vector<int32_t> bias;			// In the accumulator scale of each filter
+	std::vector<double> weight_scale;	// Per filter
+	std::vector<Multiplier> multiplier;	// Per filter
+};
+
+struct Model {
+	const engine::Model *source;
+	double input_scale;
+	Multiplier input_multiplier;	// int16 input to int8
+	std::vector<Layer> layers;
+
+	size_t weight_bytes() const {
+		size_t bytes = 0;
+		for (const auto &layer : layers)
+			bytes += layer.kernel.size() * sizeof(q7_t) + layer.bias.size() * sizeof(int32_t)
+				+ layer.multiplier.size() * (sizeof(int32_t) + sizeof(int8_t));
+		return bytes;
+	}
+
+	// Ping-pong activation buffers of Engine and the conv1d accumulators
+	size_t ram_bytes() const {
+		size_t filters = 0;
+		for (const auto &layer : source->layers)
+			if (layer.kind == LayerKind::Conv1D)
+				filters = std::max(filters, layer.filters);
+		return 2 * source->max_activation_size() * sizeof(q7_t) + filters * sizeof(int32_t);
+	}
+};
+
+// Largest real magnitude of the model input and of every layer output, over clips
+struct Calibration {
+	double input = 0;
+	std::vector<double> outputs;
+
+	void observe(const engine::Model &model, const number_t *input) {
+		static thread_local std::vector<number_t> in, out;
+		ReferenceBackend backend;
+		Engine runner(model, backend);
+		const double unit = 1.0 / (1 << model.fixed_point);
+
+		outputs.resize(model.layers.size(), 0);
+		in.assign(input, input + model.input_size());
+		for (number_t v : in)
+			this->input = std::max(this->input, std::abs(v) * unit);
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			out.assign(model.layers[i].output_size(), 0);
+			runner.run_layer(i, in.data(), out.data());
+			for (number_t v : out)
+				outputs[i] = std::max(outputs[i], std::abs(v) * unit);
+			in.swap(out);
+		}
+	}
+};
+
+inline Model quantize(const engine::Model &model, const Calibration &calibration) {
+	const double unit = 1.0 / (1 << model.fixed_point);
+	auto activation_scale = [](double range) { return range > 0 ? range / Q7_MAX : 1.0; };
+
+	Model q;
+	q.source = &model;
+	q.input_scale = activation_scale(calibration.input);
+	q.input_multiplier = quantize_multiplier(unit / q.input_scale);
+	q.layers.resize(model.layers.size());
+
+	double scale = q.input_scale;
+	for (size_t i = 0; i < model.layers.size(); i++) {
+		const engine::Layer &layer = model.layers[i];
+		Layer &ql = q.layers[i];
+		ql.input_scale = scale;
+		// Pooling and flatten keep the scale of their input
+		ql.output_scale = layer.has_weights() ? activation_scale(calibration.outputs.at(i)) : scale;
+
+		if (layer.has_weights()) {
+			const size_t depth = layer.channels * layer.kernel_size;
+			ql.kernel.resize(layer.weight_count());
+			for (size_t f = 0; f < layer.filters; f++) {
+				const number_t *w = layer.kernel + f * depth;
+				int32_t max = 0;	// |-32768| does not fit number_t
+				for (size_t d = 0; d < depth; d++)
+					max = std::max<int32_t>(max, std::abs((int32_t)w[d]));
+				double weight_scale = max ? max * unit / Q7_MAX : 1.0;
+				for (size_t d = 0; d < depth; d++)
+					ql.kernel[f * depth + d] = quantize(w[d] * unit, weight_scale);
+				double acc_scale = weight_scale * ql.input_scale;
+				int64_t bias = std::llround(layer.bias[f] * unit / acc_scale);
+				ql.bias.push_back((int32_t)std::max<int64_t>(INT32_MIN, std::min<int64_t>(INT32_MAX, bias)));
+				ql.weight_scale.push_back(weight_scale);
+				ql.multiplier.push_back(quantize_multiplier(acc_scale / ql.output_scale));
+			}
+			if (layer.kind == LayerKind::Conv1D) {
+				ql.kernel_t.resize(ql.kernel.size());
+				for (size_t f = 0; f < layer.filters; f++)
+					for (size_t d = 0; d < depth; d++)
+						ql.kernel_t[d * layer.filters + f] = ql.kernel[f * depth + d];
+			}
+		}
+		scale = ql.output_scale;
+	}
+	return q;
+}
+
+// Model input from the int16 representation
+inline void quantize_input(const Model &q, const number_t *input, q7_t *output) {
+	for (size_t i = 0; i < q.source->input_size(); i++)
+		output[i] = saturate(apply_multiplier(input[i], q.input_multiplier));
+}
+
+inline q7_t requantize(int32_t acc, const Multiplier &m, bool relu) {
+	int64_t out = apply_multiplier(acc, m);
+	return saturate(relu && out < 0 ? 0 : out);
+}
+
+// With 16 filters or more, filters innermost: one input value updates the
+// accumulators of all filters from kernel_t ([C][K][F]), which vectorises for
+// every stride. Narrower layers keep one dot product per window. Each output
+// position is requantised as soon as its F accumulators are complete.
+inline void conv1d(const engine::Layer &layer, const Layer &q, const q7_t *input, q7_t *output) {
+	const size_t C = layer.channels, S = layer.samples, K = layer.kernel_size, OS = layer.out_samples, F = layer.filters;
+	static thread_local std::vector<int32_t> acc;	// [F]
+	acc.resize(F);
+
+	for (size_t p = 0; p < OS; p++) {
+		int32_t *a = acc.data();
+		for (size_t f = 0; f < F; f++)
+			a[f] = q.bias[f];
+		for (size_t c = 0; c < C; c++) {
+			const q7_t *window = input + c * S + p * layer.stride;
+			if (F >= 16) {
+				for (size_t x = 0; x < K; x++) {
+					const int32_t v = window[x];
+					const q7_t *w = &q.kernel_t[(c * K + x) * F];
+					for (size_t f = 0; f < F; f++)
+						a[f] += v * w[f];
+				}
+			} else {
+				for (size_t f = 0; f < F; f++) {
+					const q7_t *w = &q.kernel[(f * C + c) * K];
+					int32_t sum = 0;
+					for (size_t x = 0; x < K; x++)
+						sum += window[x] * (int32_t)w[x];
+					a[f] += sum;
+				}
+			}
+		}
+		for (size_t f = 0; f < F; f++)
+			output[f * OS + p] = requantize(a[f], q.multiplier[f], layer.relu);
+	}
+}
+
+inline void dense(const engine::Layer &layer, const Layer &q, const q7_t *input, q7_t *output) {
+	for (size_t f = 0; f < layer.filters; f++) {
+		const q7_t *w = &q.kernel[f * layer.channels];
+		int32_t acc = q.bias[f];
+		for (size_t z = 0; z < layer.channels; z++)
+			acc += w[z] * input[z];
+		output[f] = requantize(acc, q.multiplier[f], layer.relu);
+	}
+}
+
+inline void max_pool1d(const engine::Layer &layer, const q7_t *input, q7_t *output) {
+	for (size_t k = 0; k < layer.channels; k++)
+		for (size_t p = 0; p < layer.out_samples; p++) {
+			const q7_t *window = input + k * layer.samples + p * layer.stride;
+			q7_t max = layer.relu ? 0 : window[0];
+			for (size_t x = 0; x < layer.kernel_size; x++)
+				max = std::max(max, window[x]);
+			output[k * layer.out_samples + p] = max;
+		}
+}
+
+inline void avg_pool1d(const engine::Layer &layer, const q7_t *input, q7_t *output) {
+	for (size_t k = 0; k < layer.channels; k++)
+		for (size_t p = 0; p < layer.out_samples; p++) {
+			const q7_t *window = input + k * layer.samples + p * layer.stride;
+			int32_t sum = 0;
+			for (size_t x = 0; x < layer.kernel_size; x++)
+				sum += window[x];
+			if (layer.relu && sum < 0)
+				sum = 0;
+			output[k * layer.out_samples + p] = saturate(sum / (int32_t)layer.kernel_size);
+		}
+}
+
+// Runs a quantised model with its own int8 ping-pong buffers, one per thread
+class Engine {
+public:
+	explicit Engine(const Model &q)
+		: q(q), activations1(q.source->max_activation_size()), activations2(q.source->max_activation_size()) {}
+
+	// int16 input like engine::Engine; int8 outputs, real value output * output_scale()
+	void run(const number_t *input, q7_t *output) {
+		const engine::Model &model = *q.source;
+		quantize_input(q, input, activations1.data());
+		const q7_t *in = activations1.data();
+		q7_t *buffers[2] = { activations2.data(), activations1.data() };
+		int next = 0;
+
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			const engine::Layer &layer = model.layers[i];
+			if (layer.kind == LayerKind::Flatten)
+				continue;
+			q7_t *out = buffers[next];
+			switch (layer.kind) {
+			case LayerKind::Conv1D: conv1d(layer, q.layers[i], in, out); break;
+			case LayerKind::Dense: dense(layer, q.layers[i], in, out); break;
+			case LayerKind::MaxPool1D: max_pool1d(layer, in, out); break;
+			case LayerKind::AvgPool1D: avg_pool1d(layer, in, out); break;
+			case LayerKind::Flatten: break;
+			}
+			in = out;
+			next ^= 1;
+		}
+		std::copy(in, in + model.output_size(), output);
+	}
+
+	double output_scale() const { return q.layers.back().output_scale; }
+
+private:
+	const Model &q;
+	std::vector<q7_t> activations1;
+	std::vector<q7_t> activations2;
+};
+
+} // namespace int8
+
+} // namespace engine
+
+#endif // __ENGINE_INT8_H__
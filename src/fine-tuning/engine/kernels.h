@@ -0,0 +1,145 @@
+// Reference layer kernels over runtime shapes.
+//
+// These follow the generated MicroAI loops operation for operation (conv.cc,
+// maxpool.cc, averagepool.cc, fc.cc) and are the baseline every other backend
+// must match bit for bit.
+//
+// The kernels are templated on the value types (fixed_point.h): number_t
+// operands use the layer's shift, Fixed<Storage, FracBits> ones shift the
+// products by In + W - Out fractional bits and saturate to the output storage.
+// The number_t overloads run the layer's own weights; with every format Q6.9 the
+// Fixed instantiations compute exactly the same values.
+
+#ifndef __ENGINE_KERNELS_H__
+#define __ENGINE_KERNELS_H__
+
+#include "fixed_point.h"
+#include "instrument.h"
+#include "model_desc.h"
+
+namespace engine {
+
+static inline number_t clamp_to_number_t(long_number_t number) {
+	return (number_t)std::max(NUMBER_T_MIN, std::min(NUMBER_T_MAX, number));
+}
+
+// Conv/dense epilogue: scale_number_t, bias, then ReLU or clamp_to_number_t
+static inline number_t requantize(long_number_t acc, int shift, long_number_t bias, bool relu) {
+#ifdef ENGINE_INSTRUMENT
+	instrument::requantized(acc, (acc >> shift) + bias, relu);
+#endif
+	acc = (acc >> shift) + bias;
+	if (relu && acc < 0)
+		return 0;
+	return clamp_to_number_t(acc);
+}
+
+// Value of type T from a raw integer, saturated to its storage
+template<typename T>
+inline T saturate_as(long_number_t value) {
+	if constexpr (is_fixed<T>::value)
+		return T::saturate(value);
+	else
+		return clamp_to_number_t(value);
+}
+
+// The epilogue in the output type; a Fixed shift may be negative
+template<typename Out>
+inline Out requantize_as(long_number_t acc, int shift, long_number_t bias, bool relu) {
+	if constexpr (is_fixed<Out>::value) {
+		int64_t value = shift_right(acc, shift) + bias;
+		return Out::saturate(relu && value < 0 ? 0 : value);
+	} else {
+		return requantize(acc, shift, bias, relu);
+	}
+}
+
+// Right shift of the conv/dense sums of products
+template<typename In, typename W, typename Out>
+inline int product_shift(const Layer &layer) {
+	static_assert(is_fixed<In>::value == is_fixed<Out>::value && is_fixed<W>::value == is_fixed<Out>::value,
+			"number_t and Fixed operands cannot be mixed");
+	if constexpr (is_fixed<Out>::value)
+		return In::frac_bits + W::frac_bits - Out::frac_bits;
+	else
+		return layer.shift;
+}
+
+namespace reference {
+
+template<typename In, typename W, typename Out>
+inline void conv1d(const Layer &layer, const In *input, const W *kernel, const Out *bias, Out *output) {
+	const size_t C = layer.channels, S = layer.samples, K = layer.kernel_size;
+	const int shift = product_shift<In, W, Out>(layer);
+
+	for (size_t k = 0; k < layer.filters; k++) {
+		for (size_t pos_x = 0; pos_x < layer.out_samples; pos_x++) {
+			long_number_t output_acc = 0;
+			for (size_t z = 0; z < C; z++) {
+				const In *in = input + z * S + pos_x * layer.stride;
+				const W *w = kernel + (k * C + z) * K;
+				long_number_t kernel_mac = 0;
+				for (size_t x = 0; x < K; x++)
+					kernel_mac += raw(in[x]) * raw(w[x]);
+				output_acc += kernel_mac;
+			}
+			output[k * layer.out_samples + pos_x] = requantize_as<Out>(output_acc, shift, raw(bias[k]), layer.relu);
+		}
+	}
+}
+
+inline void conv1d(const Layer &layer, const number_t *input, number_t *output) {
+	conv1d(layer, input, layer.kernel, layer.bias, output);
+}
+
+template<typename T>
+inline void max_pool1d(const Layer &layer, const T *input, T *output) {
+	for (size_t k = 0; k < layer.channels; k++) {
+		const T *in = input + k * layer.samples;
+		for (size_t pos_x = 0; pos_x < layer.out_samples; pos_x++) {
+			const T *window = in + pos_x * layer.stride;
+			T max = layer.relu ? saturate_as<T>(0) : window[0];
+			for (size_t x = layer.relu ? 0 : 1; x < layer.kernel_size; x++)
+				if (raw(max) < raw(window[x]))
+					max = window[x];
+			output[k * layer.out_samples + pos_x] = max;
+		}
+	}
+}
+
+template<typename T>
+inline void avg_pool1d(const Layer &layer, const T *input, T *output) {
+	for (size_t k = 0; k < layer.channels; k++) {
+		const T *in = input + k * layer.samples;
+		for (size_t pos_x = 0; pos_x < layer.out_samples; pos_x++) {
+			long_number_t tmp = 0;
+			for (size_t x = 0; x < layer.kernel_size; x++)
+				tmp += raw(in[pos_x * layer.stride + x]);
+			if (layer.relu && tmp < 0)
+				tmp = 0;
+			output[k * layer.out_samples + pos_x] = saturate_as<T>(tmp / (long_number_t)layer.kernel_size);
+		}
+	}
+}
+
+template<typename In, typename W, typename Out>
+inline void dense(const Layer &layer, const In *input, const W *kernel, const Out *bias, Out *output) {
+	const int shift = product_shift<In, W, Out>(layer);
+	for (size_t k = 0; k < layer.filters; k++) {
+		const W *w = kernel + k * layer.channels;
+		long_number_t output_acc = 0;
+		for (size_t z = 0; z < layer.channels; z++)
+			output_acc += raw(w[z]) * raw(input[z]);
+		output[k] = requantize_as<Out>(output_acc, shift, raw(bias[k]), layer.relu);
+	}
+}
+
+inline void dense(const Layer &layer, const number_t *input, number_t *output) {
+	dense(layer, input, layer.kernel, layer.bias, output);
+}
+
+} // namespace reference
+
+} // namespace engine
+
+#endif // __ENGINE_KERNELS_H__
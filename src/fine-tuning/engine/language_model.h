@@ -0,0 +1,89 @@
+// Model descriptions for the MicroAI-generated language detection networks.
+//
+// Include after the generated model sources (model.c or a single-file
+// gsc_model_fixed.h) and expand the macro matching the generated layer names.
+// Strides, pool sizes and activations mirror the CONV_STRIDE, POOL_SIZE and
+// ACTIVATION_* macros of each generated layer file. The shift of a conv1d/dense
+// layer is FIXED_POINT unless its file defines <LAYER>_SHIFT (tools/calibrate).
+
+#ifndef __ENGINE_LANGUAGE_MODEL_H__
+#define __ENGINE_LANGUAGE_MODEL_H__
+
+#include "model_desc.h"
+
+#ifndef CONV1D_SHIFT
+#define CONV1D_SHIFT FIXED_POINT
+#endif
+#ifndef CONV1D_1_SHIFT
+#define CONV1D_1_SHIFT FIXED_POINT
+#endif
+#ifndef CONV1D_2_SHIFT
+#define CONV1D_2_SHIFT FIXED_POINT
+#endif
+#ifndef CONV1D_3_SHIFT
+#define CONV1D_3_SHIFT FIXED_POINT
+#endif
+#ifndef DENSE_SHIFT
+#define DENSE_SHIFT FIXED_POINT
+#endif
+#ifndef CONV1D_31_SHIFT
+#define CONV1D_31_SHIFT FIXED_POINT
+#endif
+#ifndef CONV1D_32_SHIFT
+#define CONV1D_32_SHIFT FIXED_POINT
+#endif
+#ifndef CONV1D_33_SHIFT
+#define CONV1D_33_SHIFT FIXED_POINT
+#endif
+#ifndef CONV1D_34_SHIFT
+#define CONV1D_34_SHIFT FIXED_POINT
+#endif
+#ifndef DENSE_12_SHIFT
+#define DENSE_12_SHIFT FIXED_POINT
+#endif
+
+// Full-data, 0.6, no-pretraining and fine-tuning variants:
+// conv1d(8, k20, s10) -> max_pooling1d(2) -> conv1d_1(16, k8, s4) -> max_pooling1d_1(2)
+// -> conv1d_2(32, k4, s2) -> max_pooling1d_2(2) -> conv1d_3(64, k2, s1)
+// -> average_pooling1d(4) -> flatten -> dense(5)
+#define LANGUAGE_MODEL_STRIDE10(model_name) \
+	engine::ModelBuilder(model_name, MODEL_INPUT_CHANNELS, MODEL_INPUT_SAMPLES, FIXED_POINT) \
+		.conv1d_layer<conv1d_output_type>("conv1d", conv1d, conv1d_kernel, conv1d_bias, 10, true, CONV1D_SHIFT) \
+		.max_pool1d_layer<max_pooling1d_output_type>("max_pooling1d", max_pooling1d, 2, 2) \
+		.conv1d_layer<conv1d_1_output_type>("conv1d_1", conv1d_1, conv1d_1_kernel, conv1d_1_bias, 4, true, CONV1D_1_SHIFT) \
+		.max_pool1d_layer<max_pooling1d_1_output_type>("max_pooling1d_1", max_pooling1d_1, 2, 2) \
+		.conv1d_layer<conv1d_2_output_type>("conv1d_2", conv1d_2, conv1d_2_kernel, conv1d_2_bias, 2, true, CONV1D_2_SHIFT) \
+		.max_pool1d_layer<max_pooling1d_2_output_type>("max_pooling1d_2", max_pooling1d_2, 2, 2) \
+		.conv1d_layer<conv1d_3_output_type>("conv1d_3", conv1d_3, conv1d_3_kernel, conv1d_3_bias, 1, true, CONV1D_3_SHIFT) \
+		.avg_pool1d_layer<average_pooling1d_output_type>("average_pooling1d", average_pooling1d, 4, 4) \
+		.flatten_layer<flatten_output_type>("flatten") \
+		.dense_layer<dense_output_type>("dense", dense, dense_kernel, dense_bias, false, DENSE_SHIFT) \
+		.build()
+
+// Half-data and pre-training variants:
+// conv1d_31(8, k9, s8) -> max_pooling1d_24(4) -> conv1d_32(16, k4, s2) -> max_pooling1d_25(4)
+// -> conv1d_33(32, k3, s2) -> max_pooling1d_26(4) -> conv1d_34(64, k2, s1)
+// -> average_pooling1d_7(6) -> flatten_11 -> dense_12(5)
+#define LANGUAGE_MODEL_STRIDE8(model_name) \
+	engine::ModelBuilder(model_name, MODEL_INPUT_CHANNELS, MODEL_INPUT_SAMPLES, FIXED_POINT) \
+		.conv1d_layer<conv1d_31_output_type>("conv1d_31", conv1d_31, conv1d_31_kernel, conv1d_31_bias, 8, true, CONV1D_31_SHIFT) \
+		.max_pool1d_layer<max_pooling1d_24_output_type>("max_pooling1d_24", max_pooling1d_24, 4, 4) \
+		.conv1d_layer<conv1d_32_output_type>("conv1d_32", conv1d_32, conv1d_32_kernel, conv1d_32_bias, 2, true, CONV1D_32_SHIFT) \
+		.max_pool1d_layer<max_pooling1d_25_output_type>("max_pooling1d_25", max_pooling1d_25, 4, 4) \
+		.conv1d_layer<conv1d_33_output_type>("conv1d_33", conv1d_33, conv1d_33_kernel, conv1d_33_bias, 2, true, CONV1D_33_SHIFT) \
+		.max_pool1d_layer<max_pooling1d_26_output_type>("max_pooling1d_26", max_pooling1d_26, 4, 4) \
+		.conv1d_layer<conv1d_34_output_type>("conv1d_34", conv1d_34, conv1d_34_kernel, conv1d_34_bias, 1, true, CONV1D_34_SHIFT) \
+		.avg_pool1d_layer<average_pooling1d_7_output_type>("average_pooling1d_7", average_pooling1d_7, 6, 6) \
+		.flatten_layer<flatten_11_output_type>("flatten_11") \
+		.dense_layer<dense_12_output_type>("dense_12", dense_12, dense_12_kernel, dense_12_bias, false, DENSE_12_SHIFT) \
+		.build()
+
+// Picks the description matching the generated sources in scope; the generated
+// flatten layer is a macro, which tells the two layer naming schemes apart.
+#if defined(flatten)
+#define LANGUAGE_MODEL(model_name) LANGUAGE_MODEL_STRIDE10(model_name)
+#elif defined(flatten_11)
+#define LANGUAGE_MODEL(model_name) LANGUAGE_MODEL_STRIDE8(model_name)
+#endif
+
+#endif // __ENGINE_LANGUAGE_MODEL_H__
@@ -0,0 +1,300 @@
+// Analytical Cortex-M4 latency model from the layer shapes.
+//
+// For each kernel implementation, the operations a layer executes are counted from
+// its shape: loads (from SRAM or flash), MACs, other ALU operations, compares,
+// taken and not-taken branches, stores and divides. Cycle costs follow the
+// Cortex-M4 TRM: a load takes 2 cycles, a taken branch refills the 3-stage
+// pipeline, and the rest take 1 cycle. A weight read misses the flash data cache
+// of the STM32L4 ART accelerator when the weights re-read for one output do not
+// fit in it; each 64-bit flash line then costs the flash wait states (4 at
+// 80 MHz). Implementations:
+// - Generated: the loops of the generated layer functions (one LDRSH/LDRSH/MLA per
+//   tap, the zero-padding test and loop branch of every tap, the conv1d
+//   accumulators kept in a static array).
+// - Dual16: CMSIS-NN style, two int16 taps per 32-bit load and SMLAD, no padding
+//   test, the inner loop unrolled by 4.
+
+#ifndef __ENGINE_M4_COST_H__
+#define __ENGINE_M4_COST_H__
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "model_desc.h"
+
+namespace engine {
+
+namespace m4 {
+
+enum class Implementation { Generated, Dual16 };
+
+inline const char *implementation_name(Implementation impl) {
+	return impl == Implementation::Generated ? "generated" : "dual16";
+}
+
+struct OpCounts {
+	double loads = 0;			// From SRAM, or flash hitting the cache
+	double flash_misses = 0;	// 64-bit flash lines fetched with wait states
+	double macs = 0;			// MLA or SMLAD
+	double alu = 0;				// Address arithmetic, shifts, adds, conditional moves
+	double compares = 0;
+	double taken = 0;			// Taken branches (loop back edges)
+	double not_taken = 0;
+	double stores = 0;
+	double divides = 0;
+
+	OpCounts &operator+=(const OpCounts &o) {
+		loads += o.loads;
+		flash_misses += o.flash_misses;
+		macs += o.macs;
+		alu += o.alu;
+		compares += o.compares;
+		taken += o.taken;
+		not_taken += o.not_taken;
+		stores += o.stores;
+		divides += o.divides;
+		return *this;
+	}
+};
+
+struct CycleCosts {
+	double mhz = 80;
+	double load = 2;
+	double mac = 1;
+	double alu = 1;
+	double compare = 1;
+	double taken = 3;			// 1 + pipeline refill
+	double not_taken = 1;
+	double store = 1;
+	double divide = 7;			// SDIV takes 2 to 12 cycles
+	double flash_wait_states = 4;
+	double flash_line_bytes = 8;
+	double data_cache_bytes = 256;	// ART accelerator: 8 lines of 4 x 64 bits
+
+	double cycles(const OpCounts &c) const {
+		return c.loads * load + c.flash_misses * flash_wait_states + c.macs * mac + c.alu * alu + c.compares * compare
+			+ c.taken * taken + c.not_taken * not_taken + c.stores * store + c.divides * divide;
+	}
+
+	double ms(const OpCounts &c) const { return cycles(c) / (mhz * 1e3); }
+
+	// Share of cycles(c) spent moving data: loads, stores and flash wait states
+	double memory_cycles(const OpCounts &c) const {
+		return c.loads * load + c.flash_misses * flash_wait_states + c.stores * store;
+	}
+
+	// Ceilings: MACs per second (2 per SMLAD), and bytes per second of 32-bit loads
+	// streaming flash lines (wait states per line) or SRAM
+	double peak_macs(bool dual) const { return mhz * 1e6 * (dual ? 2 : 1) / mac; }
+	double flash_bytes_per_s() const { return mhz * 1e6 * flash_line_bytes / (flash_line_bytes / 4 * load + flash_wait_states); }
+	double sram_bytes_per_s() const { return mhz * 1e6 * 4 / load; }
+};
+
+// Loop overhead of n iterations: increment, compare, branch back (the last falls through)
+inline void loop(OpCounts &c, double n) {
+	c.alu += n;
+	c.compares += n;
+	c.taken += std::max(0.0, n - 1);
+	c.not_taken += 1;
+}
+
+// Flash lines missed when every output re-reads `bytes` of weights, `outputs` times
+inline double weight_misses(const CycleCosts &costs, double bytes, double outputs) {
+	const double lines = bytes / costs.flash_line_bytes;
+	return bytes <= costs.data_cache_bytes ? lines : lines * outputs;
+}
+
+// Requantisation epilogue per output: shift, bias load and add, ReLU/clamp, store
+inline void epilogue(OpCounts &c, double outputs, bool relu) {
+	c.alu += 2 * outputs;
+	c.loads += outputs;
+	c.compares += (relu ? 3 : 2) * outputs;
+	c.not_taken += 2 * outputs;
+	c.stores += outputs;
+}
+
+// Weightless layers are described by their shape; conv1d and dense always have weights
+inline OpCounts count(const Layer &l, Implementation impl, const CycleCosts &costs) {
+	OpCounts c;
+	const double filters = l.filters, outs = l.out_samples, channels = l.channels, taps = l.kernel_size;
+	const double outputs = filters * outs;
+	switch (l.kind) {
+	case LayerKind::Conv1D:
+	case LayerKind::Dense: {
+		const double macs = outputs * channels * taps;
+		const double filter_bytes = channels * taps * sizeof(number_t);
+		c.flash_misses = filters * weight_misses(costs, filter_bytes, outs) + filters * sizeof(number_t) / costs.flash_line_bytes;
+		if (impl == Implementation::Generated) {
+			c.loads += 2 * macs;
+			c.macs += macs;
+			c.alu += macs;						// Input index
+			if (l.kind == LayerKind::Conv1D) {
+				c.compares += macs;				// Zero-padding test
+				c.not_taken += macs;
+				// Accumulator array update per channel, init per output
+				c.loads += outputs * channels;
+				c.alu += outputs * channels;
+				c.stores += outputs * channels + 2 * outputs;
+				c.loads += outputs;				// Second pass over the accumulators
+				loop(c, outputs * channels * taps);
+				loop(c, outputs * channels);
+				loop(c, 2 * outputs);
+			} else {
+				loop(c, macs);
+				loop(c, outputs);
+			}
+		} else {
+			const double pairs = std::ceil(taps * channels / 2);
+			c.loads += 2 * outputs * pairs;
+			c.macs += outputs * pairs;
+			c.alu += outputs * pairs / 2;		// Pointer increments, shared by the unrolled taps
+			loop(c, outputs * std::ceil(pairs / 4));
+			loop(c, outputs);
+		}
+		epilogue(c, outputs, l.relu);
+		loop(c, filters);
+		break;
+	}
+	case LayerKind::MaxPool1D:
+		// Load, compare and conditional move per window value, the first one as the start
+		c.loads += outputs * taps;
+		c.compares += outputs * (taps - 1);
+		c.alu += outputs * (taps - 1);
+		c.stores += outputs;
+		loop(c, outputs * (taps - 1));
+		loop(c, outputs);
+		break;
+	case LayerKind::AvgPool1D:
+		c.loads += outputs * taps;
+		c.alu += outputs * taps;
+		c.divides += outputs;
+		c.compares += 2 * outputs;			// Clamp
+		c.stores += outputs;
+		loop(c, outputs * taps);
+		loop(c, outputs);
+		break;
+	case LayerKind::Flatten:
+		break;
+	}
+	return c;
+}
+
+// Winograd F(2,2) conv1d of a stride-1 layer (engine/winograd.h), in scalar int32
+// since the transformed values exceed int16 (no SMLAD). Input transform: 3 loads,
+// 2 subtracts and 3 stores per tile position and channel. Per output pair, channel
+// and tap pair: 3 transformed weights (int32, from flash) and 3 transformed inputs
+// loaded, 3 MLA and a pointer increment, the 3 sums kept in registers; then the
+// output transform (2 adds) and the epilogue of both outputs. An odd last tap adds
+// 3 loads and 2 MLA per output pair and channel, an odd last output the direct loop.
+inline OpCounts winograd(const Layer &l, const CycleCosts &costs) {
+	OpCounts c;
+	const double filters = l.filters, channels = l.channels, taps = l.kernel_size, outs = l.out_samples;
+	const double tiles = std::floor(outs / 2), pairs = std::floor(taps / 2), positions = tiles + pairs - 1;
+	c.loads += 3 * channels * positions;
+	c.alu += 2 * channels * positions;
+	c.stores += 3 * channels * positions;
+	loop(c, channels * positions);
+
+	const double steps = filters * tiles * channels * pairs;
+	c.loads += 6 * steps;
+	c.macs += 3 * steps;
+	c.alu += steps;
+	loop(c, steps);
+	const double transformed_bytes = channels * pairs * 3 * sizeof(uint32_t);
+	c.flash_misses += filters * weight_misses(costs, transformed_bytes, tiles);
+	if ((int)taps % 2) {
+		const double tails = filters * tiles * channels;
+		c.loads += 3 * tails;
+		c.macs += 2 * tails;
+		loop(c, tails);
+		c.flash_misses += filters * weight_misses(costs, channels * sizeof(uint32_t), tiles);
+	}
+	c.alu += 2 * filters * tiles;
+	loop(c, filters * tiles);
+	if ((int)outs % 2) {
+		const double macs = filters * channels * taps;
+		c.loads += 2 * macs;
+		c.macs += macs;
+		loop(c, macs);
+	}
+	c.flash_misses += filters * sizeof(number_t) / costs.flash_line_bytes;
+	epilogue(c, filters * outs, l.relu);
+	loop(c, filters);
+	return c;
+}
+
+// Streaming weight decode: `values` outputs, each a `bits`-bit field (when it has
+// one: `fields` of them) unpacked from a byte stream and added to the base weight
+// read from flash (`base`, deltas) or to a constant, with a 1-bit mask per value
+// when `masked`. Refilling the bit buffer costs a byte load, a shift and an OR per
+// 8 bits; extracting a field a mask, a shift, a subtract and the sign extension.
+inline OpCounts unpack(double values, double fields, double bits, bool masked, bool base, const CycleCosts &costs) {
+	OpCounts c;
+	const double bytes = fields * bits / 8 + (masked ? values / 8 : 0);
+	c.loads += (base ? values : 0) + bytes;
+	c.flash_misses += ((base ? values * sizeof(number_t) : 0) + bytes) / costs.flash_line_bytes;
+	c.alu += 2 * bytes + 4 * fields + values;	// Refills, extraction, add
+	if (masked) {
+		c.alu += 2 * values;
+		c.compares += values;
+		c.not_taken += values;
+	}
+	c.stores += values;
+	loop(c, values);
+	return c;
+}
+
+// Canonical Huffman decode of `values` codes, `code_bits` bits in all, each code
+// followed by a symbol and `low_bits` raw bits. A code found in the lookup table
+// costs a peek, the table load, a test and the skip; the `long_codes` that are not
+// (`long_code_bits` bits) are then read one bit at a time against the table of
+// code counts per length (a count load, the bit extraction, two compares and the
+// code updates per bit).
+inline OpCounts huffman(double values, double code_bits, double long_codes, double long_code_bits, double low_bits,
+		const CycleCosts &costs) {
+	OpCounts c = unpack(values, values, low_bits, false, false, costs);
+	const double bytes = code_bits / 8;
+	c.loads += bytes + values;
+	c.flash_misses += bytes / costs.flash_line_bytes;
+	c.alu += 2 * bytes + 5 * values;
+	c.compares += values;
+	c.not_taken += values - long_codes;
+	c.taken += long_codes;
+	c.loads += long_code_bits + long_codes;
+	c.alu += 8 * long_code_bits;
+	c.compares += long_code_bits;
+	c.not_taken += long_code_bits;
+	loop(c, long_code_bits);
+	return c;
+}
+
+struct LayerEstimate {
+	const Layer *layer;
+	OpCounts ops;
+	double cycles;
+};
+
+inline std::vector<LayerEstimate> estimate(const Model &model, Implementation impl, const CycleCosts &costs) {
+	std::vector<LayerEstimate> layers;
+	for (const auto &layer : model.layers) {
+		if (layer.kind == LayerKind::Flatten)
+			continue;
+		OpCounts ops = count(layer, impl, costs);
+		layers.push_back({ &layer, ops, costs.cycles(ops) });
+	}
+	return layers;
+}
+
+inline double total_cycles(const std::vector<LayerEstimate> &layers) {
+	double total = 0;
+	for (const auto &l : layers)
+		total += l.cycles;
+	return total;
+}
+
+} // namespace m4
+
+} // namespace engine
+
+#endif // __ENGINE_M4_COST_H__
@@ -0,0 +1,261 @@
+// Runtime description of a MicroAI-generated model.
+//
+// The generated sources only keep layer shapes in macros that are #undef'd after
+// each layer, so host-side engines and tools work from this description instead.
+// A Model is built with ModelBuilder from the generated symbols (see
+// language_model.h): every layer's shape is checked against the generated
+// *_output_type typedefs and weight array extents at build time.
+
+#ifndef __ENGINE_MODEL_DESC_H__
+#define __ENGINE_MODEL_DESC_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace engine {
+
+typedef int16_t number_t;		// Same representation as number.h
+typedef int32_t long_number_t;
+
+static const long_number_t NUMBER_T_MIN = -32768;
+static const long_number_t NUMBER_T_MAX = 32767;
+
+[[noreturn]] inline void fatal(const std::string &msg) {
+	std::cerr << "Error: " << msg << std::endl;
+	exit(1);
+}
+
+// Layer function of the generated sources bound to its weights: (input, output)
+typedef std::function<void(const number_t *, number_t *)> GeneratedKernel;
+
+template<typename In, typename Out>
+GeneratedKernel bind_generated(void (*fn)(In, Out)) {
+	return [fn](const number_t *input, number_t *output) {
+		fn(reinterpret_cast<In>(input), reinterpret_cast<Out>(output));
+	};
+}
+
+template<typename In, typename Kernel, typename Out>
+GeneratedKernel bind_generated(void (*fn)(In, Kernel, const number_t *, Out), const number_t *kernel, const number_t *bias) {
+	return [fn, kernel, bias](const number_t *input, number_t *output) {
+		fn(reinterpret_cast<In>(input), reinterpret_cast<Kernel>(kernel), bias, reinterpret_cast<Out>(output));
+	};
+}
+
+enum class LayerKind { Conv1D, MaxPool1D, AvgPool1D, Flatten, Dense };
+
+inline const char *layer_kind_name(LayerKind kind) {
+	switch (kind) {
+	case LayerKind::Conv1D: return "conv1d";
+	case LayerKind::MaxPool1D: return "max_pooling1d";
+	case LayerKind::AvgPool1D: return "average_pooling1d";
+	case LayerKind::Flatten: return "flatten";
+	case LayerKind::Dense: return "dense";
+	}
+	return "?";
+}
+
+// Every layer reads a [channels][samples] tensor and writes a [filters][out_samples]
+// tensor. Dense is described as a conv1d over a single sample with a 1-tap kernel, so
+// its kernel [units][inputs] has the same layout as [filters][channels][kernel_size].
+struct Layer {
+	std::string name;
+	LayerKind kind;
+	size_t channels;		// Input channels (Dense: input units)
+	size_t samples;			// Input samples (Dense: 1)
+	size_t filters;			// Output channels (pooling: channels, Flatten: channels*samples, Dense: units)
+	size_t kernel_size;		// Conv taps or pool size (Dense/Flatten: 1)
+	size_t stride;
+	size_t out_samples;
+	bool relu;
+	const number_t *kernel;	// [filters][channels][kernel_size], nullptr for weightless layers
+	const number_t *bias;	// [filters]
+	int shift;				// Accumulator right shift: FIXED_POINT, or a calibrated <LAYER>_SHIFT
+	GeneratedKernel generated;	// Generated layer function, empty for Flatten
+
+	size_t input_size() const { return channels * samples; }
+	size_t output_size() const { return filters * out_samples; }
+	size_t weight_count() const { return kernel ? filters * channels * kernel_size : 0; }
+	bool has_weights() const { return kernel != nullptr; }
+
+	// Multiply-accumulates for Conv1D/Dense, window reads for pooling
+	size_t macs() const {
+		switch (kind) {
+		case LayerKind::Conv1D:
+		case LayerKind::Dense:
+			return filters * out_samples * channels * kernel_size;
+		case LayerKind::MaxPool1D:
+		case LayerKind::AvgPool1D:
+			return filters * out_samples * kernel_size;
+		case LayerKind::Flatten:
+			return 0;
+		}
+		return 0;
+	}
+};
+
+struct Model {
+	std::string name;
+	size_t input_channels;
+	size_t input_samples;
+	int fixed_point;
+	std::vector<Layer> layers;
+
+	size_t input_size() const { return input_channels * input_samples; }
+	size_t output_size() const { return layers.empty() ? input_size() : layers.back().output_size(); }
+
+	size_t max_activation_size() const {
+		size_t size = input_size();
+		for (const auto &layer : layers)
+			size = std::max(size, layer.output_size());
+		return size;
+	}
+
+	size_t macs() const {
+		size_t total = 0;
+		for (const auto &layer : layers)
+			total += layer.macs();
+		return total;
+	}
+
+	size_t weight_count() const {
+		size_t total = 0;
+		for (const auto &layer : layers)
+			total += layer.weight_count() + (layer.bias ? layer.filters : 0);
+		return total;
+	}
+};
+
+// Chains layers from the generated symbols, tracking the current tensor shape.
+// Output shapes come from the generated *_output_type typedefs and are checked
+// against what the layer parameters imply.
+class ModelBuilder {
+public:
+	ModelBuilder(const std::string &name, size_t input_channels, size_t input_samples, int fixed_point)
+		: channels(input_channels), samples(input_samples) {
+		if (fixed_point <= 0)
+			fatal(name + ": engine requires a fixed-point model (FIXED_POINT > 0)");
+		model.name = name;
+		model.input_channels = input_channels;
+		model.input_samples = input_samples;
+		model.fixed_point = fixed_point;
+	}
+
+	template<typename OutputType, typename Fn, size_t Filters, size_t Channels, size_t KernelSize>
+	ModelBuilder &conv1d_layer(const char *name, Fn fn,
+			const int16_t (&kernel)[Filters][Channels][KernelSize],
+			const int16_t (&bias)[Filters],
+			size_t stride, bool relu, int shift) {
+		static_assert(std::rank<OutputType>::value == 2, "conv1d output must be [filters][samples]");
+		static_assert(std::extent<OutputType, 0>::value == Filters, "conv1d output/kernel filters mismatch");
+		Layer layer = make(name, LayerKind::Conv1D, Filters, KernelSize, stride, relu);
+		layer.kernel = &kernel[0][0][0];
+		layer.bias = bias;
+		layer.shift = shift;
+		layer.generated = bind_generated(fn, layer.kernel, layer.bias);
+		check_channels(layer, Channels);
+		return push(layer, std::extent<OutputType, 1>::value);
+	}
+
+	template<typename OutputType, typename Fn>
+	ModelBuilder &max_pool1d_layer(const char *name, Fn fn, size_t pool_size, size_t stride, bool relu = false) {
+		static_assert(std::rank<OutputType>::value == 2, "pooling output must be [channels][samples]");
+		Layer layer = make(name, LayerKind::MaxPool1D, channels, pool_size, stride, relu);
+		layer.generated = bind_generated(fn);
+		return push(layer, std::extent<OutputType, 1>::value);
+	}
+
+	template<typename OutputType, typename Fn>
+	ModelBuilder &avg_pool1d_layer(const char *name, Fn fn, size_t pool_size, size_t stride, bool relu = false) {
+		static_assert(std::rank<OutputType>::value == 2, "pooling output must be [channels][samples]");
+		Layer layer = make(name, LayerKind::AvgPool1D, channels, pool_size, stride, relu);
+		layer.generated = bind_generated(fn);
+		return push(layer, std::extent<OutputType, 1>::value);
+	}
+
+	template<typename OutputType>
+	ModelBuilder &flatten_layer(const char *name) {
+		static_assert(std::rank<OutputType>::value == 1, "flatten output must be one-dimensional");
+		Layer layer = make(name, LayerKind::Flatten, channels * samples, 1, 1, false);
+		if (std::extent<OutputType, 0>::value != channels * samples)
+			fatal(std::string(name) + ": flatten output size mismatch");
+		layer.out_samples = 1;
+		model.layers.push_back(layer);
+		channels = layer.filters;
+		samples = 1;
+		return *this;
+	}
+
+	template<typename OutputType, typename Fn, size_t Units, size_t Inputs>
+	ModelBuilder &dense_layer(const char *name, Fn fn,
+			const int16_t (&kernel)[Units][Inputs],
+			const int16_t (&bias)[Units],
+			bool relu, int shift) {
+		static_assert(std::extent<OutputType, 0>::value == Units, "dense output/kernel units mismatch");
+		Layer layer = make(name, LayerKind::Dense, Units, 1, 1, relu);
+		layer.kernel = &kernel[0][0];
+		layer.bias = bias;
+		layer.shift = shift;
+		layer.generated = bind_generated(fn, layer.kernel, layer.bias);
+		layer.channels = channels * samples;
+		layer.samples = 1;
+		check_channels(layer, Inputs);
+		layer.out_samples = 1;
+		model.layers.push_back(layer);
+		channels = Units;
+		samples = 1;
+		return *this;
+	}
+
+	Model build() const { return model; }
+
+private:
+	Model model;
+	size_t channels;
+	size_t samples;
+
+	Layer make(const char *name, LayerKind kind, size_t filters, size_t kernel_size, size_t stride, bool relu) const {
+		Layer layer;
+		layer.name = name;
+		layer.kind = kind;
+		layer.channels = channels;
+		layer.samples = samples;
+		layer.filters = filters;
+		layer.kernel_size = kernel_size;
+		layer.stride = stride;
+		layer.out_samples = 0;
+		layer.relu = relu;
+		layer.kernel = nullptr;
+		layer.bias = nullptr;
+		layer.shift = model.fixed_point;
+		return layer;
+	}
+
+	void check_channels(const Layer &layer, size_t expected) const {
+		if (layer.channels != expected)
+			fatal(layer.name + ": input has " + std::to_string(layer.channels) + " channels, kernel expects " + std::to_string(expected));
+	}
+
+	// No ZeroPadding1D in the supported models: out = (in - k) / stride + 1
+	ModelBuilder &push(Layer &layer, size_t out_samples) {
+		if (layer.samples < layer.kernel_size || layer.stride == 0
+				|| (layer.samples - layer.kernel_size) / layer.stride + 1 != out_samples)
+			fatal(layer.name + ": output samples do not match kernel size/stride");
+		layer.out_samples = out_samples;
+		model.layers.push_back(layer);
+		channels = layer.filters;
+		samples = out_samples;
+		return *this;
+	}
+};
+
+} // namespace engine
+
+#endif // __ENGINE_MODEL_DESC_H__
@@ -0,0 +1,50 @@
+// 16-bit accumulation backend driven by the static range analysis.
+//
+// At prepare time the model ranges are computed for inputs bounded by input_bound
+// (any int16 input by default). A conv1d layer whose exact accumulator range fits
+// in int16 runs the GEMM kernels with wrapping 16-bit accumulators (16 instead of
+// 8 columns per vector); every other layer keeps the int32 GEMM path. Outputs are
+// bit-exact with the reference as long as the inputs respect the bound.
+
+#ifndef __ENGINE_NARROW_H__
+#define __ENGINE_NARROW_H__
+
+#include <vector>
+
+#include "gemm.h"
+#include "range.h"
+
+namespace engine {
+
+class NarrowBackend : public GemmBackend {
+public:
+	explicit NarrowBackend(int64_t input_bound = -NUMBER_T_MIN) : input_bound(input_bound) {}
+
+	const char *name() const override { return "narrow"; }
+
+	void prepare(const Model &model) override {
+		GemmBackend::prepare(model);
+		std::vector<LayerRange> ranges = analyze_ranges(model, input_interval(input_bound));
+		narrow.assign(model.layers.size(), false);
+		for (size_t i = 0; i < model.layers.size(); i++)
+			narrow[i] = model.layers[i].kind == LayerKind::Conv1D && ranges[i].accumulator_bits() <= 16;
+	}
+
+	void conv1d(size_t i, const Layer &layer, const number_t *input, number_t *output) override {
+		if (narrow.at(i))
+			gemm::conv1d<uint16_t>(layer, packed.at(i), input, output);
+		else
+			gemm::conv1d<long_number_t>(layer, packed.at(i), input, output);
+	}
+
+	// Layers running with 16-bit accumulators
+	const std::vector<bool> &narrow_layers() const { return narrow; }
+
+private:
+	int64_t input_bound;
+	std::vector<bool> narrow;
+};
+
+} // namespace engine
+
+#endif // __ENGINE_NARROW_H__
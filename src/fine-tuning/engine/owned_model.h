@@ -0,0 +1,86 @@
+// A Model owning copies of its weights, for tools that modify or reshape them
+// (pruning, filter removal, recalibration...).
+//
+// The layers point into the owned arrays; after resizing an array or changing a
+// layer shape, call update() to re-point them, propagate the channel counts
+// through the weightless layers and check the shapes. Generated layer
+// functions are bound to the original weights, so they are dropped: an
+// OwnedModel runs on every backend but "generated".
+
+#ifndef __ENGINE_OWNED_MODEL_H__
+#define __ENGINE_OWNED_MODEL_H__
+
+#include <string>
+#include <vector>
+
+#include "model_desc.h"
+
+namespace engine {
+
+class OwnedModel {
+public:
+	explicit OwnedModel(const Model &source) : model(source), kernels(source.layers.size()), biases(source.layers.size()) {
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			Layer &layer = model.layers[i];
+			if (layer.has_weights()) {
+				kernels[i].assign(layer.kernel, layer.kernel + layer.weight_count());
+				biases[i].assign(layer.bias, layer.bias + layer.filters);
+			}
+			layer.generated = nullptr;
+		}
+		update();
+	}
+
+	// Layers hold pointers into this object
+	OwnedModel(const OwnedModel &) = delete;
+	OwnedModel &operator=(const OwnedModel &) = delete;
+
+	const Model &get() const { return model; }
+	Model &get() { return model; }
+
+	// [filters][channels][kernel_size] and [filters] of layer i
+	std::vector<number_t> &kernel(size_t i) { return kernels.at(i); }
+	std::vector<number_t> &bias(size_t i) { return biases.at(i); }
+
+	// Re-points the layers at the owned weights after edits. Pooling and Flatten
+	// take the shape of their input; weighted layers must match it.
+	void update() {
+		size_t channels = model.input_channels, samples = model.input_samples;
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			Layer &layer = model.layers[i];
+			switch (layer.kind) {
+			case LayerKind::MaxPool1D:
+			case LayerKind::AvgPool1D:
+				layer.channels = layer.filters = channels;
+				break;
+			case LayerKind::Flatten:
+				layer.channels = channels;
+				layer.filters = channels * samples;
+				break;
+			case LayerKind::Dense:
+				channels *= samples;
+				samples = 1;
+				// Fall through
+			case LayerKind::Conv1D:
+				if (layer.channels != channels || layer.samples != samples)
+					fatal(model.name + ": " + layer.name + " input shape does not match the previous layer");
+				if (kernels[i].size() != layer.weight_count() || biases[i].size() != layer.filters)
+					fatal(model.name + ": " + layer.name + " weights do not match its shape");
+				layer.kernel = kernels[i].data();
+				layer.bias = biases[i].data();
+				break;
+			}
+			channels = layer.filters;
+			samples = layer.out_samples;
+		}
+	}
+
+private:
+	Model model;
+	std::vector<std::vector<number_t>> kernels;
+	std::vector<std::vector<number_t>> biases;
+};
+
+} // namespace engine
+
+#endif // __ENGINE_OWNED_MODEL_H__
@@ -0,0 +1,224 @@
+// Host side of the compressed weight blobs (engine/weight_pack.h): choosing the
+// encoding of every kernel, writing the blob and running it.
+//
+// For each kernel the encoder tries fixed-width fields and every split of the
+// weights into Huffman-coded high parts and raw low bits, and keeps the smallest,
+// code table included. PackedBackend decodes each layer into a scratch buffer
+// just before it runs (DecodingBackend), like the device.
+
+#ifndef __ENGINE_PACK_MODEL_H__
+#define __ENGINE_PACK_MODEL_H__
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "blob_model.h"
+#include "engine.h"
+#include "weight_pack.h"
+
+namespace engine {
+
+namespace blob {
+
+// Huffman code lengths of the symbols with a non-zero frequency (0 for the others)
+inline std::vector<uint32_t> huffman_lengths(const std::vector<size_t> &frequency) {
+	typedef std::pair<size_t, size_t> Node;		// Weight, node id
+	std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+	std::vector<size_t> parent(2 * frequency.size(), SIZE_MAX);
+	for (size_t s = 0; s < frequency.size(); s++)
+		if (frequency[s])
+			queue.push({ frequency[s], s });
+	std::vector<uint32_t> lengths(frequency.size(), 0);
+	if (queue.size() == 1) {
+		lengths[queue.top().second] = 1;
+		return lengths;
+	}
+	size_t next = frequency.size();
+	while (queue.size() > 1) {
+		Node a = queue.top();
+		queue.pop();
+		Node b = queue.top();
+		queue.pop();
+		parent[a.second] = parent[b.second] = next;
+		queue.push({ a.first + b.first, next++ });
+	}
+	for (size_t s = 0; s < frequency.size(); s++)
+		for (size_t node = s; frequency[s] && parent[node] != SIZE_MAX; node = parent[node])
+			lengths[s]++;
+	return lengths;
+}
+
+// Encoding of one kernel, before it is written
+struct PackedKernel {
+	PackEntry entry;
+	std::vector<uint8_t> payload;
+};
+
+// Smallest encoding of a kernel of n weights
+inline PackedKernel pack_kernel(const number_t *kernel, size_t n) {
+	const int32_t low = *std::min_element(kernel, kernel + n), high = *std::max_element(kernel, kernel + n);
+	uint32_t range_bits = 0;
+	while ((int64_t)1 << range_bits <= high - low)
+		range_bits++;
+
+	PackedKernel best;
+	memset(&best.entry, 0, sizeof(best.entry));
+	best.entry.encoding = PACK_FIXED;
+	best.entry.bits = range_bits;
+	best.entry.offset = low;
+	BitWriter fields(best.payload);
+	for (size_t k = 0; k < n; k++)
+		fields.write(kernel[k] - low, range_bits);
+	fields.flush();
+
+	for (uint32_t low_bits = 0; low_bits < range_bits; low_bits++) {
+		std::vector<size_t> frequency(((high - low) >> low_bits) + 1, 0);
+		if (frequency.size() > 256)
+			continue;
+		for (size_t k = 0; k < n; k++)
+			frequency[(kernel[k] - low) >> low_bits]++;
+		const std::vector<uint32_t> lengths = huffman_lengths(frequency);
+		const uint32_t max_length = *std::max_element(lengths.begin(), lengths.end());
+		if (max_length > PACK_MAX_CODE_LENGTH)
+			continue;
+
+		// Canonical code: by length, then by symbol
+		uint16_t count[16] = {};
+		std::vector<uint8_t> symbols;
+		std::vector<uint32_t> codes(frequency.size());
+		uint32_t code = 0;
+		for (uint32_t len = 1; len <= max_length; len++) {
+			for (size_t s = 0; s < frequency.size(); s++) {
+				if (lengths[s] != len)
+					continue;
+				count[len]++;
+				symbols.push_back(s);
+				codes[s] = code++;
+			}
+			code <<= 1;
+		}
+
+		PackedKernel candidate;
+		memset(&candidate.entry, 0, sizeof(candidate.entry));
+		candidate.entry.encoding = PACK_HUFFMAN;
+		candidate.entry.bits = low_bits;
+		candidate.entry.offset = low;
+		candidate.entry.symbols = symbols.size();
+		candidate.entry.max_length = max_length;
+		candidate.payload.assign((const uint8_t *)count, (const uint8_t *)count + sizeof(count));
+		candidate.payload.insert(candidate.payload.end(), symbols.begin(), symbols.end());
+		BitWriter stream(candidate.payload);
+		for (size_t k = 0; k < n; k++) {
+			const uint32_t v = kernel[k] - low, s = v >> low_bits;
+			for (uint32_t bit = lengths[s]; bit-- > 0;)
+				stream.write(codes[s] >> bit, 1);
+			stream.write(v, low_bits);
+		}
+		stream.flush();
+		if (candidate.payload.size() < best.payload.size())
+			best = candidate;
+	}
+	best.entry.kernel_bytes = best.payload.size();
+	return best;
+}
+
+// Serialised compressed blob of a model with weights
+inline std::vector<uint8_t> encode_packed(const Model &model) {
+	if (model.name.size() >= sizeof(Header::model_name))
+		fatal("model name \"" + model.name + "\" too long for a blob");
+	const uint32_t alignment = 4;
+	auto align = [&](size_t offset) { return (offset + alignment - 1) / alignment * alignment; };
+	size_t size = sizeof(Header) + model.layers.size() * sizeof(PackEntry);
+	std::vector<PackedKernel> kernels(model.layers.size());
+	for (size_t i = 0; i < model.layers.size(); i++) {
+		const Layer &layer = model.layers[i];
+		PackedKernel &packed = kernels[i];
+		if (layer.has_weights())
+			packed = pack_kernel(layer.kernel, layer.weight_count());
+		else
+			memset(&packed.entry, 0, sizeof(packed.entry));
+		LayerEntry &e = packed.entry.layer;
+		if (layer.name.size() >= sizeof(e.name))
+			fatal(model.name + ": layer name \"" + layer.name + "\" too long for a blob");
+		strcpy(e.name, layer.name.c_str());
+		e.kind = kind_code(layer.kind);
+		e.channels = layer.channels;
+		e.samples = layer.samples;
+		e.filters = layer.filters;
+		e.kernel_size = layer.kernel_size;
+		e.stride = layer.stride;
+		e.out_samples = layer.out_samples;
+		e.relu = layer.relu;
+		e.shift = layer.shift;
+		if (layer.has_weights()) {
+			e.kernel_offset = align(size);
+			size = align(e.kernel_offset + packed.payload.size());
+			e.bias_offset = size;
+			size = align(size + layer.filters * sizeof(number_t));
+		}
+	}
+
+	std::vector<uint8_t> data(size, 0);
+	Header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+	h.version = PACK_VERSION;
+	h.header_size = sizeof(Header);
+	h.entry_size = sizeof(PackEntry);
+	h.layer_count = model.layers.size();
+	h.alignment = alignment;
+	h.total_size = size;
+	h.fixed_point = model.fixed_point;
+	h.input_channels = model.input_channels;
+	h.input_samples = model.input_samples;
+	strcpy(h.model_name, model.name.c_str());
+	for (size_t i = 0; i < model.layers.size(); i++) {
+		const Layer &layer = model.layers[i];
+		const PackEntry &e = kernels[i].entry;
+		memcpy(data.data() + sizeof(h) + i * sizeof(PackEntry), &e, sizeof(e));
+		if (!layer.has_weights())
+			continue;
+		if (!kernels[i].payload.empty())
+			memcpy(data.data() + e.layer.kernel_offset, kernels[i].payload.data(), kernels[i].payload.size());
+		memcpy(data.data() + e.layer.bias_offset, layer.bias, layer.filters * sizeof(number_t));
+	}
+	memcpy(data.data(), &h, sizeof(h));
+	h.crc32 = checksum(data.data(), data.size());
+	memcpy(data.data(), &h, sizeof(h));
+	return data;
+}
+
+// Weights decoded from a compressed blob just before each layer; single-threaded only
+class PackedBackend : public DecodingBackend {
+public:
+	explicit PackedBackend(const PackView &pack) : pack(pack) {}
+
+	const char *name() const override { return "packed"; }
+
+	void prepare(const Model &model) override {
+		if (model.layers.size() != pack.layers())
+			fatal(model.name + ": the compressed blob has " + std::to_string(pack.layers()) + " layers");
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			const Layer &layer = model.layers[i];
+			const LayerEntry &e = pack.layer(i);
+			if (kind_code(layer.kind) != e.kind || layer.weight_count() != e.weight_count() || layer.filters != e.filters)
+				fatal(model.name + ": " + layer.name + " does not match the compressed blob");
+		}
+		DecodingBackend::prepare(model);
+	}
+
+protected:
+	void decode(size_t i, number_t *scratch) override { pack.decode(i, scratch); }
+
+private:
+	const PackView &pack;
+};
+
+} // namespace blob
+
+} // namespace engine
+
+#endif // __ENGINE_PACK_MODEL_H__
@@ -0,0 +1,182 @@
+// Per-layer hardware counters with perf_event_open (Linux).
+//
+// LayerProfiler is an ActivationSink: it reads CPU cycles, instructions, L1D read
+// misses and branch misses (user space only) before and after every layer the
+// Engine runs, and accumulates the differences per layer along with the wall
+// time. Each counter is opened on its own, so a counter the CPU, kernel
+// (perf_event_paranoid) or container does not provide is reported unavailable
+// while the others still count; without any, only wall time is collected.
+
+#ifndef __ENGINE_PERF_COUNTERS_H__
+#define __ENGINE_PERF_COUNTERS_H__
+
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "engine.h"
+
+namespace engine {
+
+class PerfCounters {
+public:
+	enum Counter { CYCLES, INSTRUCTIONS, L1D_MISSES, BRANCH_MISSES, COUNTERS };
+
+	static const char *counter_name(int c) {
+		static const char *const names[COUNTERS] = { "cycles", "instructions", "L1D misses", "branch misses" };
+		return names[c];
+	}
+
+	PerfCounters() {
+		for (int c = 0; c < COUNTERS; c++) {
+			fds[c] = -1;
+#ifdef __linux__
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			switch (c) {
+			case CYCLES: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+			case INSTRUCTIONS: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+			case L1D_MISSES:
+				attr.type = PERF_TYPE_HW_CACHE;
+				attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+				break;
+			case BRANCH_MISSES: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+			}
+			// This thread, any CPU
+			fds[c] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+			if (fds[c] < 0)
+				errors[c] = strerror(errno);
+#else
+			errors[c] = "perf_event_open needs Linux";
+#endif
+		}
+	}
+
+	~PerfCounters() {
+#ifdef __linux__
+		for (int fd : fds)
+			if (fd >= 0)
+				close(fd);
+#endif
+	}
+
+	PerfCounters(const PerfCounters &) = delete;
+	PerfCounters &operator=(const PerfCounters &) = delete;
+
+	bool available(int c) const { return fds[c] >= 0; }
+	bool any_available() const {
+		for (int c = 0; c < COUNTERS; c++)
+			if (available(c))
+				return true;
+		return false;
+	}
+	const std::string &error(int c) const { return errors[c]; }
+
+	// Current values; unavailable counters read 0
+	void read_all(uint64_t values[COUNTERS]) const {
+		for (int c = 0; c < COUNTERS; c++) {
+			values[c] = 0;
+#ifdef __linux__
+			if (fds[c] >= 0 && ::read(fds[c], &values[c], sizeof(values[c])) != sizeof(values[c]))
+				values[c] = 0;
+#endif
+		}
+	}
+
+private:
+	int fds[COUNTERS];
+	std::string errors[COUNTERS];
+};
+
+struct LayerProfile {
+	uint64_t calls = 0;
+	uint64_t counts[PerfCounters::COUNTERS] = {};
+	double ns = 0;
+};
+
+// Counters around every layer of the Engine it is attached to (same thread)
+class LayerProfiler : public ActivationSink {
+public:
+	explicit LayerProfiler(const Model &model) : model(model), layers(model.layers.size()) {}
+
+	void layer_input(size_t, const Layer &, const number_t *) override {
+		start_time = std::chrono::steady_clock::now();
+		counters.read_all(start);
+	}
+
+	void layer_output(size_t i, const Layer &, const number_t *) override {
+		uint64_t end[PerfCounters::COUNTERS];
+		counters.read_all(end);
+		LayerProfile &p = layers[i];
+		p.ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+		for (int c = 0; c < PerfCounters::COUNTERS; c++)
+			p.counts[c] += end[c] - start[c];
+		p.calls++;
+	}
+
+	const PerfCounters &get_counters() const { return counters; }
+	const std::vector<LayerProfile> &get_layers() const { return layers; }
+
+	// Per layer: time and counters per call, IPC, misses per MAC
+	void report(std::ostream &out) const {
+		for (int c = 0; c < PerfCounters::COUNTERS; c++)
+			if (!counters.available(c))
+				out << "Counter " << PerfCounters::counter_name(c) << " unavailable: " << counters.error(c) << std::endl;
+		auto column = [&](bool available, double value, int precision) {
+			std::ostringstream s;
+			if (available)
+				s << std::fixed << std::setprecision(precision) << value;
+			else
+				s << "-";
+			return s.str();
+		};
+		const bool cycles = counters.available(PerfCounters::CYCLES), instructions = counters.available(PerfCounters::INSTRUCTIONS);
+		const bool l1d = counters.available(PerfCounters::L1D_MISSES), branches = counters.available(PerfCounters::BRANCH_MISSES);
+		out << std::left << std::setw(20) << "layer" << std::right << std::setw(10) << "us/call" << std::setw(13) << "cycles"
+			<< std::setw(13) << "instr" << std::setw(7) << "IPC" << std::setw(11) << "L1D miss" << std::setw(12) << "L1D/kMAC"
+			<< std::setw(11) << "br miss" << std::setw(11) << "br/kMAC" << std::endl;
+		for (size_t i = 0; i < layers.size(); i++) {
+			const LayerProfile &p = layers[i];
+			if (!p.calls)
+				continue;
+			const double n = p.calls, kmacs = model.layers[i].macs() / 1000.0;
+			const uint64_t *k = p.counts;
+			out << std::left << std::setw(20) << model.layers[i].name << std::right << std::setw(10) << column(true, p.ns / n / 1000, 1)
+				<< std::setw(13) << column(cycles, k[PerfCounters::CYCLES] / n, 0)
+				<< std::setw(13) << column(instructions, k[PerfCounters::INSTRUCTIONS] / n, 0)
+				<< std::setw(7) << column(cycles && instructions && k[PerfCounters::CYCLES],
+						k[PerfCounters::INSTRUCTIONS] / (double)std::max<uint64_t>(1, k[PerfCounters::CYCLES]), 2)
+				<< std::setw(11) << column(l1d, k[PerfCounters::L1D_MISSES] / n, 0)
+				<< std::setw(12) << column(l1d && kmacs > 0, k[PerfCounters::L1D_MISSES] / n / std::max(kmacs, 1e-9), 2)
+				<< std::setw(11) << column(branches, k[PerfCounters::BRANCH_MISSES] / n, 0)
+				<< std::setw(11) << column(branches && kmacs > 0, k[PerfCounters::BRANCH_MISSES] / n / std::max(kmacs, 1e-9), 2)
+				<< std::endl;
+		}
+	}
+
+private:
+	const Model &model;
+	PerfCounters counters;
+	std::vector<LayerProfile> layers;
+	uint64_t start[PerfCounters::COUNTERS] = {};
+	std::chrono::steady_clock::time_point start_time;
+};
+
+} // namespace engine
+
+#endif // __ENGINE_PERF_COUNTERS_H__
@@ -0,0 +1,144 @@
+// Static interval analysis of a Model.
+//
+// Input bounds are propagated through every layer per channel, using the actual
+// weights, the FIXED_POINT shift, the bias, ReLU and the clamp_to_number_t
+// saturation. For conv1d/dense layers it yields the range of the accumulator
+// (the sum before scale_number_t) per filter, and of every partial sum in the
+// order the generated loops accumulate.
+//
+// The final accumulator range is what matters for wrapping (modular) arithmetic:
+// if the exact sum fits in N bits, accumulating the products modulo 2^N gives it
+// exactly whatever the intermediate values. The partial-sum range is the bound
+// for saturating accumulation.
+
+#ifndef __ENGINE_RANGE_H__
+#define __ENGINE_RANGE_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "model_desc.h"
+
+namespace engine {
+
+struct Interval {
+	int64_t lo;
+	int64_t hi;
+
+	Interval operator+(const Interval &o) const { return { lo + o.lo, hi + o.hi }; }
+	Interval hull(const Interval &o) const { return { std::min(lo, o.lo), std::max(hi, o.hi) }; }
+	Interval clamp(int64_t min, int64_t max) const {
+		return { std::max(min, std::min(max, lo)), std::max(min, std::min(max, hi)) };
+	}
+	// Product with a constant
+	Interval scale(int64_t w) const {
+		return w >= 0 ? Interval{ lo * w, hi * w } : Interval{ hi * w, lo * w };
+	}
+};
+
+// Smallest two's complement width holding every value of the interval
+inline int signed_bits(const Interval &range) {
+	int bits = 1;
+	while (range.lo < -(int64_t(1) << (bits - 1)) || range.hi > (int64_t(1) << (bits - 1)) - 1)
+		bits++;
+	return bits;
+}
+
+struct LayerRange {
+	std::vector<Interval> input;		// Per input channel (Dense: per input unit)
+	std::vector<Interval> accumulator;	// Per filter, exact sum before scaling (conv1d/dense only)
+	Interval accumulator_hull;			// Over all filters
+	Interval partial_hull;				// Over every partial sum, reference accumulation order
+	std::vector<Interval> output;		// Per output channel (Flatten/Dense: per unit)
+
+	int accumulator_bits() const { return signed_bits(accumulator_hull); }
+	int partial_bits() const { return signed_bits(partial_hull); }
+};
+
+namespace range {
+
+inline Interval requantize(const Interval &acc, const Layer &layer, int64_t bias) {
+	// Arithmetic shift and clamp are monotonic
+	Interval out = { (acc.lo >> layer.shift) + bias, (acc.hi >> layer.shift) + bias };
+	if (layer.relu)
+		out = out.clamp(0, INT64_MAX);
+	return out.clamp(NUMBER_T_MIN, NUMBER_T_MAX);
+}
+
+// Conv1D and Dense: per filter, terms in generated loop order (channel, then tap)
+inline void weighted(const Layer &layer, LayerRange &r) {
+	const size_t C = layer.channels, K = layer.kernel_size;
+	r.accumulator.resize(layer.filters);
+	r.output.resize(layer.filters);
+	r.accumulator_hull = { 0, 0 };
+	r.partial_hull = { 0, 0 };
+
+	for (size_t f = 0; f < layer.filters; f++) {
+		Interval acc = { 0, 0 };
+		for (size_t c = 0; c < C; c++)
+			for (size_t x = 0; x < K; x++) {
+				acc = acc + r.input[c].scale(layer.kernel[(f * C + c) * K + x]);
+				r.partial_hull = r.partial_hull.hull(acc);
+			}
+		r.accumulator[f] = acc;
+		r.accumulator_hull = r.accumulator_hull.hull(acc);
+		r.output[f] = requantize(acc, layer, layer.bias[f]);
+	}
+}
+
+} // namespace range
+
+// Inputs in [-bound, bound], limited to number_t (bound 32768: any int16 input)
+inline Interval input_interval(int64_t bound) {
+	return { std::max<int64_t>(-bound, NUMBER_T_MIN), std::min<int64_t>(bound, NUMBER_T_MAX) };
+}
+
+// input: bounds of every model input sample
+inline std::vector<LayerRange> analyze_ranges(const Model &model, Interval input) {
+	std::vector<LayerRange> ranges(model.layers.size());
+	std::vector<Interval> current(model.input_channels, input);
+
+	for (size_t i = 0; i < model.layers.size(); i++) {
+		const Layer &layer = model.layers[i];
+		LayerRange &r = ranges[i];
+		r.input = current;
+		r.accumulator_hull = r.partial_hull = { 0, 0 };
+
+		switch (layer.kind) {
+		case LayerKind::Conv1D:
+		case LayerKind::Dense:
+			range::weighted(layer, r);
+			break;
+		case LayerKind::MaxPool1D:
+			r.output = current;
+			if (layer.relu)
+				for (auto &o : r.output)
+					o = o.clamp(0, INT64_MAX);
+			break;
+		case LayerKind::AvgPool1D:
+			for (const auto &in : current) {
+				Interval sum = { in.lo * (int64_t)layer.kernel_size, in.hi * (int64_t)layer.kernel_size };
+				if (layer.relu)
+					sum = sum.clamp(0, INT64_MAX);
+				r.partial_hull = r.partial_hull.hull(sum);
+				// Truncating division is monotonic
+				r.output.push_back(Interval{ sum.lo / (int64_t)layer.kernel_size, sum.hi / (int64_t)layer.kernel_size }
+						.clamp(NUMBER_T_MIN, NUMBER_T_MAX));
+			}
+			r.accumulator_hull = r.partial_hull;
+			break;
+		case LayerKind::Flatten:
+			// [channels][samples] row-major: unit c*samples + x comes from channel c
+			for (const auto &in : current)
+				r.output.insert(r.output.end(), layer.samples, in);
+			break;
+		}
+		current = r.output;
+	}
+	return ranges;
+}
+
+} // namespace engine
+
+#endif // __ENGINE_RANGE_H__
@@ -0,0 +1,235 @@
+// Zero-skipping kernels for the layers fed by ReLU activations.
+//
+// The inputs of conv1d_1..conv1d_3 and dense are ReLU outputs (through max
+// pooling), so many of their values are exactly zero, more so on quiet audio.
+// The sparse kernels first build a bitmap of the non-zero input values, one
+// 64-bit word per 64 samples of a channel, then scatter only those values: a
+// non-zero input[c][s] adds w[f][c][x] * input[c][s] to every output p with
+// p * stride + x == s, for all filters at once from weights transposed to
+// [C][K][F]. All-zero channels and runs of zeros cost one word test each.
+//
+// The scatter order reaches partial sums the generated order never does, so the
+// accumulators wrap like the GEMM ones (gemm::Wrapping): the final value modulo
+// 2^32 does not depend on the order, and outputs are bit-exact wherever the
+// reference's int32 sum does not overflow. SparseBackend counts the non-zero
+// inputs of every conv1d/dense call and uses the sparse kernel only below the
+// density threshold of the layer: the break-even density tools/activation_sparsity
+// measured for its shape (MEASURED), the lowest over the variants sharing it.
+// Layers of an unmeasured shape always run the dense kernels, without the scan.
+
+#ifndef __ENGINE_SPARSE_H__
+#define __ENGINE_SPARSE_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "gemm.h"
+
+namespace engine {
+
+namespace sparse {
+
+// Non-zero values of a [channels][samples] activation
+struct NonZeros {
+	size_t channels;
+	size_t samples;
+	size_t words;			// Per channel
+	size_t count;
+	std::vector<uint64_t> bits;
+
+	void build(const number_t *input, size_t channels, size_t samples) {
+		this->channels = channels;
+		this->samples = samples;
+		words = (samples + 63) / 64;
+		bits.assign(channels * words, 0);
+		count = 0;
+		for (size_t c = 0; c < channels; c++) {
+			const number_t *in = input + c * samples;
+			for (size_t w = 0; w < words; w++) {
+				const size_t n = std::min<size_t>(64, samples - w * 64);
+				uint64_t word = 0;
+				for (size_t i = 0; i < n; i++)
+					word |= (uint64_t)(in[w * 64 + i] != 0) << i;
+				bits[c * words + w] = word;
+				count += __builtin_popcountll(word);
+			}
+		}
+	}
+
+	float density() const { return channels * samples != 0 ? count / (float)(channels * samples) : 0; }
+
+	// fn(channel, sample) for every non-zero value
+	template<typename Fn>
+	void for_each(Fn fn) const {
+		for (size_t c = 0; c < channels; c++)
+			for (size_t w = 0; w < words; w++)
+				for (uint64_t word = bits[c * words + w]; word; word &= word - 1)
+					fn(c, w * 64 + __builtin_ctzll(word));
+	}
+};
+
+// Break-even input density of a conv1d/dense layer shape: the lowest of three runs of
+// tools/activation_sparsity --table, built with -O3 -march=native (x86-64, AVX2), on
+// 64 synthetic clips
+struct Threshold {
+	LayerKind kind;
+	size_t channels, samples, filters, kernel_size, stride;
+	float density;
+};
+
+static const Threshold MEASURED[] = {
+	// conv1d .. dense of the stride-10 language models
+	{ LayerKind::Conv1D, 1, 16000, 8, 20, 10, 0.426f },
+	{ LayerKind::Conv1D, 8, 799, 16, 8, 4, 0.294f },
+	{ LayerKind::Conv1D, 16, 99, 32, 4, 2, 0.340f },
+	{ LayerKind::Conv1D, 32, 24, 64, 2, 1, 0.263f },
+	{ LayerKind::Dense, 320, 1, 5, 1, 1, 0.097f },
+	// conv1d_31 .. dense_12 of the stride-8 language models
+	{ LayerKind::Conv1D, 1, 16000, 8, 9, 8, 0.318f },
+	{ LayerKind::Conv1D, 8, 499, 16, 4, 2, 0.398f },
+	{ LayerKind::Conv1D, 16, 62, 32, 3, 2, 0.336f },
+	{ LayerKind::Conv1D, 32, 7, 64, 2, 1, 0.448f },
+	{ LayerKind::Dense, 64, 1, 5, 1, 1, 0.218f },
+	// gsc
+	{ LayerKind::Conv1D, 1, 16000, 4, 32, 4, 0.207f },
+	{ LayerKind::Conv1D, 4, 998, 8, 8, 1, 0.427f },
+	{ LayerKind::Dense, 1976, 1, 10, 1, 1, 0.288f },
+};
+
+// Threshold of a layer, -1 (never sparse) for an unmeasured shape
+inline float measured_threshold(const Layer &layer) {
+	for (const Threshold &t : MEASURED)
+		if (t.kind == layer.kind && t.channels == layer.channels && t.samples == layer.samples && t.filters == layer.filters
+				&& t.kernel_size == layer.kernel_size && t.stride == layer.stride)
+			return t.density;
+	return -1;
+}
+
+// Input density of a conv1d/dense layer call
+inline void scan_input(const Layer &layer, const number_t *input, NonZeros &nz) {
+	if (layer.kind == LayerKind::Dense)
+		nz.build(input, 1, layer.channels);
+	else
+		nz.build(input, layer.channels, layer.samples);
+}
+
+// Conv1D weights as [C][K][F], Dense weights as [inputs][F]
+inline std::vector<number_t> transpose_weights(const Layer &layer) {
+	const size_t F = layer.filters, CK = layer.channels * layer.kernel_size;
+	std::vector<number_t> t(CK * F);
+	for (size_t f = 0; f < F; f++)
+		for (size_t d = 0; d < CK; d++)
+			t[d * F + f] = layer.kernel[f * CK + d];
+	return t;
+}
+
+inline void conv1d(const Layer &layer, const std::vector<number_t> &weights, const NonZeros &nz,
+		const number_t *input, number_t *output) {
+	static thread_local std::vector<gemm::Wrapping<long_number_t>> acc;	// [OS][F]
+	const size_t F = layer.filters, K = layer.kernel_size, OS = layer.out_samples, stride = layer.stride;
+	acc.assign(OS * F, 0);
+
+	nz.for_each([&](size_t c, size_t s) {
+		const long_number_t v = input[c * layer.samples + s];
+		// Outputs p with p * stride <= s < p * stride + K
+		const size_t first = s >= K ? (s - K) / stride + 1 : 0;
+		const size_t last = std::min(s / stride, OS - 1);
+		for (size_t p = first; p <= last; p++) {
+			const number_t *w = weights.data() + (c * K + s - p * stride) * F;
+			gemm::Wrapping<long_number_t> *a = acc.data() + p * F;
+			for (size_t f = 0; f < F; f++)
+				a[f] += (gemm::Wrapping<long_number_t>)(w[f] * v);
+		}
+	});
+
+	for (size_t f = 0; f < F; f++)
+		for (size_t p = 0; p < OS; p++)
+			output[f * OS + p] = requantize(gemm::accumulator_value<long_number_t>(acc[p * F + f]), layer.shift,
+				layer.bias[f], layer.relu);
+}
+
+inline void dense(const Layer &layer, const std::vector<number_t> &weights, const NonZeros &nz,
+		const number_t *input, number_t *output) {
+	static thread_local std::vector<gemm::Wrapping<long_number_t>> acc;
+	const size_t F = layer.filters;
+	acc.assign(F, 0);
+
+	nz.for_each([&](size_t, size_t z) {
+		const long_number_t v = input[z];
+		const number_t *w = weights.data() + z * F;
+		for (size_t f = 0; f < F; f++)
+			acc[f] += (gemm::Wrapping<long_number_t>)(w[f] * v);
+	});
+
+	for (size_t f = 0; f < F; f++)
+		output[f] = requantize(gemm::accumulator_value<long_number_t>(acc[f]), layer.shift, layer.bias[f], layer.relu);
+}
+
+} // namespace sparse
+
+// GEMM conv1d and reference dense, switching to the zero-skipping kernels for
+// calls whose input density is at most the threshold of the layer
+class SparseBackend : public GemmBackend {
+public:
+	// Measured per-layer thresholds
+	SparseBackend() : fixed(false), fixed_threshold(0) {}
+	// One threshold for every layer: 2 always runs the sparse kernels, -1 never
+	explicit SparseBackend(float threshold) : fixed(true), fixed_threshold(threshold) {}
+
+	const char *name() const override { return "sparse"; }
+
+	void prepare(const Model &model) override {
+		GemmBackend::prepare(model);
+		transposed.assign(model.layers.size(), std::vector<number_t>());
+		thresholds.assign(model.layers.size(), -1);
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			const Layer &layer = model.layers[i];
+			if (!layer.has_weights())
+				continue;
+			transposed[i] = sparse::transpose_weights(layer);
+			thresholds[i] = fixed ? fixed_threshold : sparse::measured_threshold(layer);
+		}
+	}
+
+	void conv1d(size_t i, const Layer &layer, const number_t *input, number_t *output) override {
+		if (thresholds.at(i) < 0) {
+			GemmBackend::conv1d(i, layer, input, output);
+			return;
+		}
+		sparse::NonZeros &nz = scan(layer, input);
+		if (nz.density() <= thresholds[i])
+			sparse::conv1d(layer, transposed.at(i), nz, input, output);
+		else
+			GemmBackend::conv1d(i, layer, input, output);
+	}
+
+	void dense(size_t i, const Layer &layer, const number_t *input, number_t *output) override {
+		if (thresholds.at(i) < 0) {
+			GemmBackend::dense(i, layer, input, output);
+			return;
+		}
+		sparse::NonZeros &nz = scan(layer, input);
+		if (nz.density() <= thresholds[i])
+			sparse::dense(layer, transposed.at(i), nz, input, output);
+		else
+			GemmBackend::dense(i, layer, input, output);
+	}
+
+	float threshold(size_t i) const { return thresholds.at(i); }
+
+private:
+	bool fixed;
+	float fixed_threshold;
+	std::vector<float> thresholds;
+	std::vector<std::vector<number_t>> transposed;
+
+	static sparse::NonZeros &scan(const Layer &layer, const number_t *input) {
+		static thread_local sparse::NonZeros nz;
+		sparse::scan_input(layer, input, nz);
+		return nz;
+	}
+};
+
+} // namespace engine
+
+#endif // __ENGINE_SPARSE_H__
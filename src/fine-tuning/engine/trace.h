@@ -0,0 +1,174 @@
+// Low-overhead trace recorder writing Chrome trace-event JSON (chrome://tracing,
+// ui.perfetto.dev).
+//
+// trace::Scope records a complete event ("ph": "X") from its construction to
+// its destruction. Every thread appends to its own fixed-capacity buffer,
+// registered with the Recorder once; appends take no lock and publish the new
+// size with a release store, so write_json() can run while threads are still
+// recording (it sees a consistent prefix). When a buffer is full further events
+// of that thread are counted as dropped. While recording is disabled a Scope
+// costs one relaxed atomic load. Event names and categories must outlive the
+// recorder (string literals, layer names of a live Model).
+
+#ifndef __ENGINE_TRACE_H__
+#define __ENGINE_TRACE_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+namespace trace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Event {
+	const char *name;
+	const char *category;
+	int64_t begin_ns;		// Since Recorder::enable()
+	int64_t duration_ns;
+};
+
+class ThreadBuffer {
+public:
+	ThreadBuffer(int tid, size_t capacity) : tid(tid), capacity(capacity), events(new Event[capacity]) {}
+
+	// Owner thread only
+	void push(const Event &event) {
+		size_t n = size.load(std::memory_order_relaxed);
+		if (n == capacity) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		events[n] = event;
+		size.store(n + 1, std::memory_order_release);
+	}
+
+	const int tid;
+	std::string name;
+	const size_t capacity;
+	std::unique_ptr<Event[]> events;
+	std::atomic<size_t> size{0};
+	std::atomic<size_t> dropped{0};
+};
+
+class Recorder {
+public:
+	static Recorder &get() {
+		static Recorder recorder;
+		return recorder;
+	}
+
+	// Starts recording, at most events_per_thread events per thread
+	void enable(size_t events_per_thread = 1 << 20) {
+		capacity = events_per_thread;
+		origin = Clock::now();
+		enabled.store(true, std::memory_order_release);
+	}
+
+	bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+
+	int64_t now_ns() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - origin).count();
+	}
+
+	// Buffer of the calling thread, registered on first use
+	ThreadBuffer &local() {
+		static thread_local ThreadBuffer *buffer = nullptr;
+		if (!buffer) {
+			std::lock_guard<std::mutex> lock(mutex);
+			buffers.emplace_back(new ThreadBuffer((int)buffers.size() + 1, capacity));
+			buffer = buffers.back().get();
+		}
+		return *buffer;
+	}
+
+	void write_json(std::ostream &out) {
+		std::lock_guard<std::mutex> lock(mutex);
+		out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+		bool first = true;
+		size_t dropped = 0;
+		for (const auto &b : buffers) {
+			const size_t n = b->size.load(std::memory_order_acquire);
+			dropped += b->dropped.load(std::memory_order_relaxed);
+			out << (first ? "" : ",") << "\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << b->tid
+				<< ", \"args\": {\"name\": \"" << escape(b->name.empty() ? "thread " + std::to_string(b->tid) : b->name) << "\"}}";
+			first = false;
+			for (size_t i = 0; i < n; i++) {
+				const Event &e = b->events[i];
+				out << ",\n{\"name\": \"" << escape(e.name) << "\", \"cat\": \"" << escape(e.category)
+					<< "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << b->tid
+					<< ", \"ts\": " << e.begin_ns / 1000 << "." << pad3(e.begin_ns % 1000)
+					<< ", \"dur\": " << e.duration_ns / 1000 << "." << pad3(e.duration_ns % 1000) << "}";
+			}
+		}
+		out << "\n], \"otherData\": {\"dropped_events\": " << dropped << "}}\n";
+	}
+
+private:
+	std::atomic<bool> enabled{false};
+	size_t capacity = 0;
+	Clock::time_point origin;
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+	static std::string escape(const std::string &s) {
+		std::string out;
+		for (char c : s) {
+			if (c == '"' || c == '\\')
+				out += '\\';
+			out += c;
+		}
+		return out;
+	}
+
+	static std::string pad3(int64_t v) {
+		std::string s = std::to_string(v);
+		return std::string(3 - s.size(), '0') + s;
+	}
+};
+
+inline bool enabled() {
+	return Recorder::get().is_enabled();
+}
+
+// Names the calling thread in the trace
+inline void set_thread_name(const std::string &name) {
+	if (enabled())
+		Recorder::get().local().name = name;
+}
+
+class Scope {
+public:
+	Scope(const char *name, const char *category) : name(enabled() ? name : nullptr), category(category) {
+		if (this->name)
+			begin = Recorder::get().now_ns();
+	}
+
+	~Scope() {
+		if (name) {
+			Recorder &r = Recorder::get();
+			r.local().push({ name, category, begin, r.now_ns() - begin });
+		}
+	}
+
+	Scope(const Scope &) = delete;
+	Scope &operator=(const Scope &) = delete;
+
+private:
+	const char *name;
+	const char *category;
+	int64_t begin = 0;
+};
+
+} // namespace trace
+
+} // namespace engine
+
+#endif // __ENGINE_TRACE_H__
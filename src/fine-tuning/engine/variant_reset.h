@@ -0,0 +1,12 @@
+// Clears the include guards and model-level macros left by a generated
+// single-file model so another one can be included in a different namespace.
+// Intentionally has no include guard.
+
+#undef __NUMBER_H__
+#undef __MODEL_H__
+#undef FIXED_POINT
+#undef NUMBER_MIN
+#undef NUMBER_MAX
+#undef MODEL_OUTPUT_SAMPLES
+#undef MODEL_INPUT_SAMPLES
+#undef MODEL_INPUT_CHANNELS
@@ -0,0 +1,152 @@
+// The eight language detection model variants and the GSC keyword model, all
+// compiled into one translation unit.
+//
+// Each single-file gsc_model_fixed.h is wrapped in its own namespace; the include
+// guards and model-level macros of the previous variant are reset before the next
+// one. Include this header in a single translation unit per program, as the
+// generated cnn() definitions are not inline.
+
+#ifndef __ENGINE_VARIANTS_H__
+#define __ENGINE_VARIANTS_H__
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "language_model.h"
+#include "model_desc.h"
+
+// conv1d_4(4, k32, s4) -> max_pooling1d_2(4) -> conv1d_5(8, k8, s1) -> max_pooling1d_3(4)
+// -> flatten_3 -> dense_3(10), all linear
+#define GSC_MODEL(model_name) \
+	engine::ModelBuilder(model_name, MODEL_INPUT_CHANNELS, MODEL_INPUT_SAMPLES, FIXED_POINT) \
+		.conv1d_layer<conv1d_4_output_type>("conv1d_4", conv1d_4, conv1d_4_kernel, conv1d_4_bias, 4, false, FIXED_POINT) \
+		.max_pool1d_layer<max_pooling1d_2_output_type>("max_pooling1d_2", max_pooling1d_2, 4, 4) \
+		.conv1d_layer<conv1d_5_output_type>("conv1d_5", conv1d_5, conv1d_5_kernel, conv1d_5_bias, 1, false, FIXED_POINT) \
+		.max_pool1d_layer<max_pooling1d_3_output_type>("max_pooling1d_3", max_pooling1d_3, 4, 4) \
+		.flatten_layer<flatten_3_output_type>("flatten_3") \
+		.dense_layer<dense_3_output_type>("dense_3", dense_3, dense_3_kernel, dense_3_bias, false, FIXED_POINT) \
+		.build()
+
+namespace variants {
+
+struct Variant {
+	const char *name;
+	const char *source;		// Generated single-file model, relative to src/
+	engine::Model (*describe)();
+	void (*cnn)(const engine::number_t *input, engine::number_t *output);
+	bool language;			// One of the eight language detection variants (not GSC)
+};
+
+} // namespace variants
+
+#include "variant_reset.h"
+namespace variants { namespace fine_tuning {
+#include "../gsc_model_fixed.h"
+inline engine::Model describe() { return LANGUAGE_MODEL_STRIDE10("fine-tuning"); }
+inline void run_cnn(const engine::number_t *input, engine::number_t *output) {
+	cnn(reinterpret_cast<const number_t (*)[MODEL_INPUT_SAMPLES]>(input), output);
+}
+} }
+
+#include "variant_reset.h"
+namespace variants { namespace fine_tuning_keras2c {
+#include "../keras2c/gsc_model_fixed.h"
+inline engine::Model describe() { return LANGUAGE_MODEL_STRIDE8("fine-tuning-keras2c"); }
+inline void run_cnn(const engine::number_t *input, engine::number_t *output) {
+	cnn(reinterpret_cast<const number_t (*)[MODEL_INPUT_SAMPLES]>(input), output);
+}
+} }
+
+#include "variant_reset.h"
+namespace variants { namespace full_data_fine_tuned_06 {
+#include "../../models/language-detection-full-data/fine-tuning/language-detection-0.6/keras2c/gsc_model_fixed.h"
+inline engine::Model describe() { return LANGUAGE_MODEL_STRIDE10("full-data-fine-tuned-0.6"); }
+inline void run_cnn(const engine::number_t *input, engine::number_t *output) {
+	cnn(reinterpret_cast<const number_t (*)[MODEL_INPUT_SAMPLES]>(input), output);
+}
+} }
+
+#include "variant_reset.h"
+namespace variants { namespace full_data_pre_trained {
+#include "../../models/language-detection-full-data/pre-trained/keras2c/gsc_model_fixed.h"
+inline engine::Model describe() { return LANGUAGE_MODEL_STRIDE10("full-data-pre-trained"); }
+inline void run_cnn(const engine::number_t *input, engine::number_t *output) {
+	cnn(reinterpret_cast<const number_t (*)[MODEL_INPUT_SAMPLES]>(input), output);
+}
+} }
+
+#include "variant_reset.h"
+namespace variants { namespace full_data_pre_trained_06 {
+#include "../../models/language-detection-full-data/pre-trained/language-detection-0.6/keras2c/gsc_model_fixed.h"
+inline engine::Model describe() { return LANGUAGE_MODEL_STRIDE10("full-data-pre-trained-0.6"); }
+inline void run_cnn(const engine::number_t *input, engine::number_t *output) {
+	cnn(reinterpret_cast<const number_t (*)[MODEL_INPUT_SAMPLES]>(input), output);
+}
+} }
+
+#include "variant_reset.h"
+namespace variants { namespace half_data {
+#include "../../models/language-detection-half-data/keras2c/pre-traine_dgsc_model_fixed.h"
+inline engine::Model describe() { return LANGUAGE_MODEL_STRIDE8("half-data-pre-trained"); }
+inline void run_cnn(const engine::number_t *input, engine::number_t *output) {
+	cnn(reinterpret_cast<const number_t (*)[MODEL_INPUT_SAMPLES]>(input), output);
+}
+} }
+
+#include "variant_reset.h"
+namespace variants { namespace no_pretraining {
+#include "../../models/no-pre-training/language-detection-no-pretraining/keras2c/gsc_model_fixed.h"
+inline engine::Model describe() { return LANGUAGE_MODEL_STRIDE10("no-pretraining"); }
+inline void run_cnn(const engine::number_t *input, engine::number_t *output) {
+	cnn(reinterpret_cast<const number_t (*)[MODEL_INPUT_SAMPLES]>(input), output);
+}
+} }
+
+#include "variant_reset.h"
+namespace variants { namespace pre_training {
+#include "../../pre-training/keras2c/pre-traine_dgsc_model_fixed.h"
+inline engine::Model describe() { return LANGUAGE_MODEL_STRIDE8("pre-training"); }
+inline void run_cnn(const engine::number_t *input, engine::number_t *output) {
+	cnn(reinterpret_cast<const number_t (*)[MODEL_INPUT_SAMPLES]>(input), output);
+}
+} }
+
+#include "variant_reset.h"
+namespace variants { namespace gsc {
+#include "../../Ardunio/Embedded_AI_Lab5_Inference/gsc_model_fixed.h"
+inline engine::Model describe() { return GSC_MODEL("gsc"); }
+inline void run_cnn(const engine::number_t *input, engine::number_t *output) {
+	cnn(reinterpret_cast<const number_t (*)[MODEL_INPUT_SAMPLES]>(input), output);
+}
+} }
+#include "variant_reset.h"
+
+namespace variants {
+
+inline const std::vector<Variant> &all() {
+	static const std::vector<Variant> list = {
+		{ "fine-tuning", "fine-tuning/gsc_model_fixed.h", fine_tuning::describe, fine_tuning::run_cnn, true },
+		{ "fine-tuning-keras2c", "fine-tuning/keras2c/gsc_model_fixed.h", fine_tuning_keras2c::describe, fine_tuning_keras2c::run_cnn, true },
+		{ "full-data-fine-tuned-0.6", "models/language-detection-full-data/fine-tuning/language-detection-0.6/keras2c/gsc_model_fixed.h", full_data_fine_tuned_06::describe, full_data_fine_tuned_06::run_cnn, true },
+		{ "full-data-pre-trained", "models/language-detection-full-data/pre-trained/keras2c/gsc_model_fixed.h", full_data_pre_trained::describe, full_data_pre_trained::run_cnn, true },
+		{ "full-data-pre-trained-0.6", "models/language-detection-full-data/pre-trained/language-detection-0.6/keras2c/gsc_model_fixed.h", full_data_pre_trained_06::describe, full_data_pre_trained_06::run_cnn, true },
+		{ "half-data-pre-trained", "models/language-detection-half-data/keras2c/pre-traine_dgsc_model_fixed.h", half_data::describe, half_data::run_cnn, true },
+		{ "no-pretraining", "models/no-pre-training/language-detection-no-pretraining/keras2c/gsc_model_fixed.h", no_pretraining::describe, no_pretraining::run_cnn, true },
+		{ "pre-training", "pre-training/keras2c/pre-traine_dgsc_model_fixed.h", pre_training::describe, pre_training::run_cnn, true },
+		{ "gsc", "Ardunio/Embedded_AI_Lab5_Inference/gsc_model_fixed.h", gsc::describe, gsc::run_cnn, false },
+	};
+	return list;
+}
+
+inline const Variant &find(const std::string &name) {
+	for (const auto &variant : all())
+		if (name == variant.name)
+			return variant;
+	engine::fatal("unknown model variant \"" + name + "\"");
+}
+
+} // namespace variants
+
+#endif // __ENGINE_VARIANTS_H__
@@ -0,0 +1,217 @@
+// Binary weight blob: the weights of one model variant with a layer table, read
+// in place.
+//
+// Layout, little-endian: an 80-byte Header, layer_count 64-byte LayerEntry records,
+// then the int16 kernels ([filters][channels][kernel_size]) and biases, each at an
+// offset from the start of the blob that is a multiple of `alignment`. The CRC-32
+// covers the whole blob with the crc32 field read as zero. View::open() checks
+// the header, the checksum and every table entry against the blob size without
+// copying or allocating anything, so the same code serves a host mmap
+// (engine/blob_model.h) and a blob programmed into a flash region of the device.
+// This header only needs <stdint.h> and <string.h> for that reason.
+
+#ifndef __ENGINE_WEIGHT_BLOB_H__
+#define __ENGINE_WEIGHT_BLOB_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace engine {
+
+namespace blob {
+
+static const char MAGIC[8] = { 'L', 'D', 'W', 'B', 'L', 'O', 'B', 0 };
+static const uint32_t VERSION = 1;
+static const uint32_t ALIGNMENT = 16;
+
+// Layer kinds, stable across versions (values of engine::LayerKind may change)
+enum Kind : uint32_t { CONV1D = 1, MAX_POOL1D = 2, AVG_POOL1D = 3, FLATTEN = 4, DENSE = 5 };
+
+struct Header {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;		// sizeof(Header)
+	uint32_t entry_size;		// sizeof(LayerEntry)
+	uint32_t layer_count;
+	uint32_t alignment;
+	uint32_t total_size;		// Bytes, padding included
+	uint32_t crc32;
+	uint32_t fixed_point;
+	uint32_t input_channels;
+	uint32_t input_samples;
+	char model_name[32];
+};
+
+struct LayerEntry {
+	char name[24];
+	uint32_t kind;
+	uint32_t channels;
+	uint32_t samples;
+	uint32_t filters;
+	uint32_t kernel_size;
+	uint32_t stride;
+	uint32_t out_samples;
+	uint16_t relu;
+	int16_t shift;
+	uint32_t kernel_offset;		// 0 for weightless layers
+	uint32_t bias_offset;
+
+	bool has_weights() const { return kind == CONV1D || kind == DENSE; }
+	// In 64 bits, saturating: open() checks it against the blob size before any use
+	uint64_t weight_count() const {
+		if (!has_weights())
+			return 0;
+		const uint64_t rows = (uint64_t)filters * channels;
+		return kernel_size && rows > UINT64_MAX / kernel_size ? UINT64_MAX : rows * kernel_size;
+	}
+};
+
+static_assert(sizeof(Header) == 80, "blob header must be 80 bytes");
+static_assert(sizeof(LayerEntry) == 64, "blob layer entry must be 64 bytes");
+
+// CRC-32 (IEEE 802.3), bitwise: no table in RAM or flash
+inline uint32_t crc32_update(uint32_t crc, const void *data, size_t size) {
+	const uint8_t *p = (const uint8_t *)data;
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) {
+		crc ^= p[i];
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+	}
+	return ~crc;
+}
+
+// CRC of a blob with its crc32 field taken as zero
+inline uint32_t checksum(const uint8_t *data, size_t size) {
+	Header header;
+	memcpy(&header, data, sizeof(header));
+	header.crc32 = 0;
+	uint32_t crc = crc32_update(0, &header, sizeof(header));
+	return crc32_update(crc, data + sizeof(header), size - sizeof(header));
+}
+
+// Fields of up to 16 bits, LSB first, read a byte at a time
+class BitReader {
+public:
+	explicit BitReader(const uint8_t *p) : p(p) {}
+
+	uint32_t read(uint32_t bits) {
+		const uint32_t v = peek(bits);
+		skip(bits);
+		return v;
+	}
+
+	// Next bits without consuming them: may read bytes past the last field
+	uint32_t peek(uint32_t bits) {
+		while (avail < bits) {
+			acc |= (uint32_t)*p++ << avail;
+			avail += 8;
+		}
+		return acc & ((1u << bits) - 1);
+	}
+
+	// After a peek() of at least as many bits
+	void skip(uint32_t bits) {
+		acc >>= bits;
+		avail -= bits;
+	}
+
+private:
+	const uint8_t *p;
+	uint32_t acc = 0;
+	uint32_t avail = 0;
+};
+
+inline int16_t sign_extend(uint32_t v, uint32_t bits) {
+	return (int16_t)((int32_t)(v << (32 - bits)) >> (32 - bits));
+}
+
+enum class Status { OK, TOO_SMALL, BAD_MAGIC, BAD_VERSION, BAD_SIZE, BAD_CHECKSUM, BAD_LAYER, MISALIGNED, BAD_BASE, BAD_NAME };
+
+inline const char *status_name(Status s) {
+	switch (s) {
+	case Status::OK: return "ok";
+	case Status::TOO_SMALL: return "smaller than its header";
+	case Status::BAD_MAGIC: return "not a weight blob";
+	case Status::BAD_VERSION: return "unsupported version";
+	case Status::BAD_SIZE: return "size does not match the header";
+	case Status::BAD_CHECKSUM: return "checksum mismatch";
+	case Status::BAD_LAYER: return "layer table entry out of bounds";
+	case Status::MISALIGNED: return "blob or weights not aligned";
+	case Status::BAD_BASE: return "made from another base blob";
+	case Status::BAD_NAME: return "model name not terminated";
+	}
+	return "?";
+}
+
+// Read-only view of a blob in memory; the blob must outlive the view
+class View {
+public:
+	Status open(const void *blob, size_t size) {
+		data = nullptr;
+		const uint8_t *bytes = (const uint8_t *)blob;
+		if (size < sizeof(Header))
+			return Status::TOO_SMALL;
+		if ((uintptr_t)blob % 4)
+			return Status::MISALIGNED;
+		const Header &h = *(const Header *)blob;
+		if (memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0)
+			return Status::BAD_MAGIC;
+		if (h.version != VERSION || h.header_size != sizeof(Header) || h.entry_size != sizeof(LayerEntry))
+			return Status::BAD_VERSION;
+		if (h.total_size != size || (uint64_t)h.header_size + (uint64_t)h.layer_count * h.entry_size > size)
+			return Status::BAD_SIZE;
+		if (h.model_name[sizeof(h.model_name) - 1] != 0)
+			return Status::BAD_NAME;
+		if (h.alignment == 0 || h.alignment % 4 || (uintptr_t)blob % h.alignment)
+			return Status::MISALIGNED;
+		if (checksum(bytes, size) != h.crc32)
+			return Status::BAD_CHECKSUM;
+		const LayerEntry *entries = (const LayerEntry *)(bytes + h.header_size);
+		for (uint32_t i = 0; i < h.layer_count; i++) {
+			const LayerEntry &e = entries[i];
+			if (e.name[sizeof(e.name) - 1] != 0 || e.kind < CONV1D || e.kind > DENSE)
+				return Status::BAD_LAYER;
+			if (!e.has_weights())
+				continue;
+			if (e.kernel_offset % h.alignment || e.bias_offset % h.alignment)
+				return Status::MISALIGNED;
+			if (e.kernel_offset > size || e.weight_count() > (size - e.kernel_offset) / 2
+					|| e.bias_offset > size || e.filters > (size - e.bias_offset) / 2)
+				return Status::BAD_LAYER;
+		}
+		data = bytes;
+		return Status::OK;
+	}
+
+	bool is_open() const { return data != nullptr; }
+	const Header &header() const { return *(const Header *)data; }
+	uint32_t layers() const { return header().layer_count; }
+	const LayerEntry &layer(uint32_t i) const { return ((const LayerEntry *)(data + header().header_size))[i]; }
+
+	// Weights of a layer, in place; nullptr for weightless layers
+	const int16_t *kernel(uint32_t i) const {
+		return layer(i).has_weights() ? (const int16_t *)(data + layer(i).kernel_offset) : nullptr;
+	}
+	const int16_t *bias(uint32_t i) const {
+		return layer(i).has_weights() ? (const int16_t *)(data + layer(i).bias_offset) : nullptr;
+	}
+
+	// Index of the layer with this name, or -1
+	int find(const char *name) const {
+		for (uint32_t i = 0; i < layers(); i++)
+			if (strcmp(layer(i).name, name) == 0)
+				return (int)i;
+		return -1;
+	}
+
+private:
+	const uint8_t *data = nullptr;
+};
+
+} // namespace blob
+
+} // namespace engine
+
+#endif // __ENGINE_WEIGHT_BLOB_H__
@@ -0,0 +1,157 @@
+// Delta blob: the weights of a fine-tuned variant stored as their difference to a
+// base weight blob (engine/weight_blob.h) with the same layers, so a device keeps
+// one full set of pre-trained weights in flash plus a small delta per variant.
+//
+// Per layer, the kernel followed by the bias is one stream of int16 deltas
+// (variant - base, wrapping), stored in the smallest of three encodings:
+// - SAME: no payload, the base weights unchanged
+// - PACKED: every delta as a `bits`-bit two's complement field, LSB first
+// - MASKED: a bitmap of the non-zero deltas, then those deltas packed as above
+// DeltaView::decode() rebuilds one layer into a scratch buffer of
+// kernel + bias values just before the layer runs, so only the largest layer needs
+// RAM. The header holds the CRC-32 of the base blob: a delta is only applied to the
+// blob it was made from. Like weight_blob.h, this header is freestanding.
+
+#ifndef __ENGINE_WEIGHT_DELTA_H__
+#define __ENGINE_WEIGHT_DELTA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "weight_blob.h"
+
+namespace engine {
+
+namespace blob {
+
+static const char DELTA_MAGIC[8] = { 'L', 'D', 'W', 'D', 'E', 'L', 'T', 'A' };
+static const uint32_t DELTA_VERSION = 1;
+
+enum Encoding : uint32_t { SAME = 0, PACKED = 1, MASKED = 2 };
+
+struct DeltaHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;		// sizeof(DeltaHeader)
+	uint32_t entry_size;		// sizeof(DeltaEntry)
+	uint32_t layer_count;		// Same as the base
+	uint32_t total_size;
+	uint32_t crc32;				// Of the delta blob, with this field read as zero
+	uint32_t base_crc32;		// crc32 field of the base blob
+	uint32_t base_size;
+	char model_name[32];
+};
+
+struct DeltaEntry {
+	uint32_t encoding;
+	uint32_t bits;				// Width of a delta field, 1 to 16 (0 for SAME)
+	uint32_t count;				// Kernel and bias values, 0 for weightless layers
+	uint32_t nonzero;			// Non-zero deltas
+	uint32_t offset;			// Payload from the start of the delta blob
+	uint32_t size;				// Payload bytes
+
+	uint64_t payload_size() const {
+		switch (encoding) {
+		case PACKED: return ((uint64_t)count * bits + 7) / 8;
+		case MASKED: return ((uint64_t)count + 7) / 8 + ((uint64_t)nonzero * bits + 7) / 8;
+		}
+		return 0;
+	}
+};
+
+static_assert(sizeof(DeltaHeader) == 72, "delta header must be 72 bytes");
+static_assert(sizeof(DeltaEntry) == 24, "delta entry must be 24 bytes");
+
+// CRC of a delta blob with its crc32 field taken as zero
+inline uint32_t delta_checksum(const uint8_t *data, size_t size) {
+	DeltaHeader header;
+	memcpy(&header, data, sizeof(header));
+	header.crc32 = 0;
+	uint32_t crc = crc32_update(0, &header, sizeof(header));
+	return crc32_update(crc, data + sizeof(header), size - sizeof(header));
+}
+
+// Read-only view of a delta blob applied to an open base View; both must outlive it
+class DeltaView {
+public:
+	Status open(const void *delta, size_t size, const View &base_view) {
+		data = nullptr;
+		const uint8_t *bytes = (const uint8_t *)delta;
+		if (size < sizeof(DeltaHeader))
+			return Status::TOO_SMALL;
+		if ((uintptr_t)delta % 4)
+			return Status::MISALIGNED;
+		const DeltaHeader &h = *(const DeltaHeader *)delta;
+		if (memcmp(h.magic, DELTA_MAGIC, sizeof(DELTA_MAGIC)) != 0)
+			return Status::BAD_MAGIC;
+		if (h.version != DELTA_VERSION || h.header_size != sizeof(DeltaHeader) || h.entry_size != sizeof(DeltaEntry))
+			return Status::BAD_VERSION;
+		if (h.total_size != size || (uint64_t)h.header_size + (uint64_t)h.layer_count * h.entry_size > size)
+			return Status::BAD_SIZE;
+		if (h.model_name[sizeof(h.model_name) - 1] != 0)
+			return Status::BAD_NAME;
+		if (delta_checksum(bytes, size) != h.crc32)
+			return Status::BAD_CHECKSUM;
+		if (!base_view.is_open() || h.base_crc32 != base_view.header().crc32 || h.base_size != base_view.header().total_size
+				|| h.layer_count != base_view.layers())
+			return Status::BAD_BASE;
+		const DeltaEntry *entries = (const DeltaEntry *)(bytes + h.header_size);
+		for (uint32_t i = 0; i < h.layer_count; i++) {
+			const DeltaEntry &e = entries[i];
+			const LayerEntry &l = base_view.layer(i);
+			// 64-bit count: a product wrapping around uint32 cannot match
+			if (e.count != (l.has_weights() ? l.weight_count() + l.filters : 0) || e.nonzero > e.count)
+				return Status::BAD_LAYER;
+			if (e.encoding == SAME ? e.bits != 0 || e.nonzero != 0
+					: e.encoding > MASKED || e.bits < 1 || e.bits > 16 || e.size != e.payload_size())
+				return Status::BAD_LAYER;
+			if ((uint64_t)e.offset + e.size > size)
+				return Status::BAD_LAYER;
+		}
+		base = &base_view;
+		data = bytes;
+		return Status::OK;
+	}
+
+	bool is_open() const { return data != nullptr; }
+	const DeltaHeader &header() const { return *(const DeltaHeader *)data; }
+	uint32_t layers() const { return header().layer_count; }
+	const DeltaEntry &layer(uint32_t i) const { return ((const DeltaEntry *)(data + header().header_size))[i]; }
+
+	// Kernel then bias of layer i into scratch (layer(i).count values)
+	void decode(uint32_t i, int16_t *scratch) const {
+		const DeltaEntry &e = layer(i);
+		const uint32_t weights = base->layer(i).weight_count();
+		const int16_t *kernel = base->kernel(i), *bias = base->bias(i);
+		if (e.encoding == SAME) {
+			memcpy(scratch, kernel, weights * sizeof(int16_t));
+			memcpy(scratch + weights, bias, (e.count - weights) * sizeof(int16_t));
+			return;
+		}
+		const uint8_t *payload = data + e.offset;
+		if (e.encoding == PACKED) {
+			BitReader deltas(payload);
+			for (uint32_t k = 0; k < weights; k++)
+				scratch[k] = (int16_t)(kernel[k] + sign_extend(deltas.read(e.bits), e.bits));
+			for (uint32_t k = weights; k < e.count; k++)
+				scratch[k] = (int16_t)(bias[k - weights] + sign_extend(deltas.read(e.bits), e.bits));
+		} else {
+			BitReader mask(payload), deltas(payload + (e.count + 7) / 8);
+			for (uint32_t k = 0; k < weights; k++)
+				scratch[k] = (int16_t)(kernel[k] + (mask.read(1) ? sign_extend(deltas.read(e.bits), e.bits) : 0));
+			for (uint32_t k = weights; k < e.count; k++)
+				scratch[k] = (int16_t)(bias[k - weights] + (mask.read(1) ? sign_extend(deltas.read(e.bits), e.bits) : 0));
+		}
+	}
+
+private:
+	const View *base = nullptr;
+	const uint8_t *data = nullptr;
+};
+
+} // namespace blob
+
+} // namespace engine
+
+#endif // __ENGINE_WEIGHT_DELTA_H__
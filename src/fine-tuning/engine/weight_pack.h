@@ -0,0 +1,205 @@
+// Compressed weight blob: a weight blob (engine/weight_blob.h) whose kernels are
+// stored losslessly in fewer bits, decoded layer by layer on the device.
+//
+// The header is a blob Header with its own magic; every PackEntry holds the
+// LayerEntry of the layer, whose kernel_offset points to the compressed kernel
+// and bias_offset to the plain int16 bias. A kernel is stored relative to its
+// smallest value (`offset`) in one of:
+// - PACK_FIXED: every weight as a `bits`-bit field, LSB first
+// - PACK_HUFFMAN: the weight split in a high part, coded with a canonical Huffman
+//   code, and `bits` low bits stored as they are. The payload starts with the code
+//   table: uint16_t count[16] (codes of each length, up to 15 bits) and the
+//   `symbols` high parts in code order, one byte each.
+// The decoder is table-driven: codes of up to 8 bits are looked up from the next
+// 8 stream bits in a 512-byte table built on the stack for each layer, longer ones
+// are read one bit at a time against count[], as in zlib's puff. Peeking reads up
+// to 2 bytes past the end of a kernel payload: open() requires the bias (at least
+// one int16 per filter) to follow it, so those reads stay in the blob.
+// Freestanding, like weight_blob.h.
+
+#ifndef __ENGINE_WEIGHT_PACK_H__
+#define __ENGINE_WEIGHT_PACK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "weight_blob.h"
+
+namespace engine {
+
+namespace blob {
+
+static const char PACK_MAGIC[8] = { 'L', 'D', 'W', 'P', 'A', 'C', 'K', 0 };
+static const uint32_t PACK_VERSION = 1;
+static const uint32_t PACK_MAX_CODE_LENGTH = 15;
+static const uint32_t PACK_TABLE_BYTES = 16 * sizeof(uint16_t);
+static const uint32_t PACK_LOOKUP_BITS = 8;
+
+enum PackEncoding : uint32_t { PACK_FIXED = 1, PACK_HUFFMAN = 2 };
+
+struct PackEntry {
+	LayerEntry layer;
+	uint32_t encoding;			// 0 for weightless layers
+	uint32_t bits;				// PACK_FIXED: field width, PACK_HUFFMAN: low bits
+	int32_t offset;				// Smallest weight
+	uint32_t symbols;			// PACK_HUFFMAN: high parts in the code table
+	uint32_t max_length;		// PACK_HUFFMAN: longest code
+	uint32_t kernel_bytes;		// Compressed kernel, code table included
+	uint32_t reserved[2];
+};
+
+static_assert(sizeof(PackEntry) == 96, "pack entry must be 96 bytes");
+
+// Next symbol of a canonical Huffman code, MSB first: count[len] codes of each length
+inline uint32_t huffman_symbol(BitReader &in, const uint16_t *count, const uint8_t *symbol, uint32_t max_length) {
+	int32_t code = 0, first = 0, index = 0;
+	for (uint32_t len = 1; len <= max_length; len++) {
+		code |= in.read(1);
+		const int32_t n = count[len];
+		if (code - n < first)
+			return symbol[index + (code - first)];
+		index += n;
+		first = (first + n) << 1;
+		code <<= 1;
+	}
+	return 0;	// Incomplete code table, rejected by PackView::open()
+}
+
+// Lookup of the codes of up to PACK_LOOKUP_BITS bits by the next stream bits, which
+// hold them reversed: symbol | length << 8, 0 for the prefixes of longer codes
+inline void huffman_lookup(const uint16_t *count, const uint8_t *symbol, uint32_t max_length,
+		uint16_t lookup[1 << PACK_LOOKUP_BITS]) {
+	memset(lookup, 0, sizeof(uint16_t) << PACK_LOOKUP_BITS);
+	uint32_t code = 0, index = 0;
+	for (uint32_t len = 1; len <= max_length && len <= PACK_LOOKUP_BITS; len++) {
+		for (uint32_t n = 0; n < count[len]; n++, code++, index++) {
+			uint32_t reversed = 0;
+			for (uint32_t bit = 0; bit < len; bit++)
+				reversed |= ((code >> bit) & 1) << (len - 1 - bit);
+			for (uint32_t fill = reversed; fill < (1u << PACK_LOOKUP_BITS); fill += 1u << len)
+				lookup[fill] = (uint16_t)(symbol[index] | len << 8);
+		}
+		code <<= 1;
+	}
+}
+
+// Read-only view of a compressed blob in memory; the blob must outlive the view
+class PackView {
+public:
+	Status open(const void *blob, size_t size) {
+		data = nullptr;
+		const uint8_t *bytes = (const uint8_t *)blob;
+		if (size < sizeof(Header))
+			return Status::TOO_SMALL;
+		if ((uintptr_t)blob % 4)
+			return Status::MISALIGNED;
+		const Header &h = *(const Header *)blob;
+		if (memcmp(h.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0)
+			return Status::BAD_MAGIC;
+		if (h.version != PACK_VERSION || h.header_size != sizeof(Header) || h.entry_size != sizeof(PackEntry))
+			return Status::BAD_VERSION;
+		if (h.total_size != size || (uint64_t)h.header_size + (uint64_t)h.layer_count * h.entry_size > size)
+			return Status::BAD_SIZE;
+		if (h.model_name[sizeof(h.model_name) - 1] != 0)
+			return Status::BAD_NAME;
+		if (h.alignment == 0 || h.alignment % 4 || (uintptr_t)blob % h.alignment)
+			return Status::MISALIGNED;
+		if (checksum(bytes, size) != h.crc32)
+			return Status::BAD_CHECKSUM;
+		const PackEntry *entries = (const PackEntry *)(bytes + h.header_size);
+		for (uint32_t i = 0; i < h.layer_count; i++) {
+			const PackEntry &e = entries[i];
+			const LayerEntry &l = e.layer;
+			if (l.name[sizeof(l.name) - 1] != 0 || l.kind < CONV1D || l.kind > DENSE)
+				return Status::BAD_LAYER;
+			if (!l.has_weights())
+				continue;
+			if (l.kernel_offset % h.alignment || l.bias_offset % h.alignment)
+				return Status::MISALIGNED;
+			if ((uint64_t)l.kernel_offset + e.kernel_bytes > size || l.bias_offset > size || l.filters > (size - l.bias_offset) / 2)
+				return Status::BAD_LAYER;
+			// The decoder peeks past the end of the kernel payload into the bias
+			if (l.bias_offset < (uint64_t)l.kernel_offset + e.kernel_bytes)
+				return Status::BAD_LAYER;
+			if (!valid_kernel(e, bytes + l.kernel_offset))
+				return Status::BAD_LAYER;
+		}
+		data = bytes;
+		return Status::OK;
+	}
+
+	bool is_open() const { return data != nullptr; }
+	const Header &header() const { return *(const Header *)data; }
+	uint32_t layers() const { return header().layer_count; }
+	const PackEntry &entry(uint32_t i) const { return ((const PackEntry *)(data + header().header_size))[i]; }
+	const LayerEntry &layer(uint32_t i) const { return entry(i).layer; }
+	const int16_t *bias(uint32_t i) const {
+		return layer(i).has_weights() ? (const int16_t *)(data + layer(i).bias_offset) : nullptr;
+	}
+
+	// Kernel then bias of layer i into scratch (weight_count() + filters values)
+	void decode(uint32_t i, int16_t *scratch) const {
+		const PackEntry &e = entry(i);
+		const uint32_t weights = e.layer.weight_count();
+		const uint8_t *payload = data + e.layer.kernel_offset;
+		if (e.encoding == PACK_FIXED) {
+			BitReader fields(payload);
+			for (uint32_t k = 0; k < weights; k++)
+				scratch[k] = (int16_t)(e.offset + (int32_t)fields.read(e.bits));
+		} else {
+			const uint16_t *count = (const uint16_t *)payload;
+			const uint8_t *symbol = payload + PACK_TABLE_BYTES;
+			uint16_t lookup[1 << PACK_LOOKUP_BITS];
+			huffman_lookup(count, symbol, e.max_length, lookup);
+			BitReader stream(symbol + e.symbols);
+			for (uint32_t k = 0; k < weights; k++) {
+				const uint32_t hit = lookup[stream.peek(PACK_LOOKUP_BITS)];
+				uint32_t high;
+				if (hit) {
+					stream.skip(hit >> 8);
+					high = hit & 0xff;
+				} else {
+					high = huffman_symbol(stream, count, symbol, e.max_length);
+				}
+				scratch[k] = (int16_t)(e.offset + (int32_t)(high << e.bits | stream.read(e.bits)));
+			}
+		}
+		memcpy(scratch + weights, bias(i), e.layer.filters * sizeof(int16_t));
+	}
+
+private:
+	const uint8_t *data = nullptr;
+
+	static bool valid_kernel(const PackEntry &e, const uint8_t *payload) {
+		const uint64_t weights = e.layer.weight_count();
+		if (e.encoding == PACK_FIXED)
+			return e.bits <= 16 && weights <= UINT32_MAX && e.kernel_bytes == (weights * e.bits + 7) / 8;
+		if (e.encoding != PACK_HUFFMAN || e.bits > 15 || e.max_length < 1 || e.max_length > PACK_MAX_CODE_LENGTH
+				|| e.symbols < 1 || e.symbols > 256 || e.kernel_bytes < PACK_TABLE_BYTES + e.symbols)
+			return false;
+		// Every weight takes a code of at least one bit and its low bits
+		if (weights > (uint64_t)(e.kernel_bytes - PACK_TABLE_BYTES - e.symbols) * 8 / (1 + e.bits))
+			return false;
+		// Every code of the table must exist: a complete prefix code, or a single 1-bit code
+		uint16_t count[16];
+		memcpy(count, payload, sizeof(count));
+		uint32_t total = 0, left = 1;
+		for (uint32_t len = 1; len <= PACK_MAX_CODE_LENGTH; len++) {
+			if (len > e.max_length && count[len])
+				return false;
+			left <<= 1;
+			if (count[len] > left)
+				return false;
+			left -= count[len];
+			total += count[len];
+		}
+		return count[0] == 0 && total == e.symbols && (left == 0 || (e.symbols == 1 && count[1] == 1));
+	}
+};
+
+} // namespace blob
+
+} // namespace engine
+
+#endif // __ENGINE_WEIGHT_PACK_H__
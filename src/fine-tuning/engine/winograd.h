@@ -0,0 +1,226 @@
+// Winograd minimal-filtering backend for stride-1 conv1d layers.
+//
+// Outputs are computed in pairs with F(2,2): for taps (g0, g1) and inputs
+// (d0, d1, d2)
+//   U = [g0, g0 + g1, g1]          V = [d0 - d1, d1, d2 - d1]
+//   M = U * V (3 multiplications)  y0 = M0 + M1, y1 = M1 + M2
+// instead of 4 multiplications. A k-tap kernel is split into k/2 tap pairs, each
+// an F(2,2) at an even tap offset, so the input transform of every tile is shared
+// by all pairs (and filters) and the transform-domain products of all channels
+// and pairs are summed before a single output transform. An odd last tap and an
+// odd last output are computed directly.
+//
+// The F(2,2) transforms have integer coefficients and need no final division, so
+// the algorithm is exact in wrapping 32-bit arithmetic: outputs are bit-exact with
+// the reference even though transformed values may exceed int16.
+//
+// Larger tiles F(m,k) need fractional interpolation points; keeping them exact
+// would require wider than 64-bit intermediates for the k=8 layers, so they are
+// not used. Layers with stride > 1 or a single tap fall back to the GEMM backend.
+//
+// Fewer multiplications do not make the kernel faster than GEMM on the host: the
+// transforms and the int32 products of the transformed values cost more than the
+// int16 multiplications saved on the k=2 layers. WinogradBackend therefore uses
+// it only on the layer shapes where tools/winograd_compare measured a speed-up
+// (MEASURED); WinogradBackend(true) forces it on every applicable layer.
+
+#ifndef __ENGINE_WINOGRAD_H__
+#define __ENGINE_WINOGRAD_H__
+
+#include <cstring>
+#include <vector>
+
+#include "gemm.h"
+
+namespace engine {
+
+namespace winograd {
+
+typedef uint32_t wrap_t;	// Wrapping arithmetic, reinterpreted as int32 at the end
+
+static const size_t TILE_BLOCK = 8;	// Output pairs kept in registers, one 256-bit vector per M row
+
+// Explicit vector accumulators: left to itself the compiler vectorises across tap
+// pairs instead, which leaves the common single-pair (k=2) case scalar
+typedef wrap_t wrap_vec __attribute__((vector_size(TILE_BLOCK * sizeof(wrap_t))));
+
+inline bool applicable(const Layer &layer) {
+	return layer.kind == LayerKind::Conv1D && layer.stride == 1 && layer.kernel_size >= 2 && layer.out_samples >= 2;
+}
+
+// Time per call of the stride-1 layer shapes, tools/winograd_compare built with
+// -O3 -march=native (x86-64, AVX2)
+struct Measurement {
+	size_t channels, samples, filters, kernel_size;
+	double gemm_us, winograd_us;
+};
+
+static const Measurement MEASURED[] = {
+	{ 32, 24, 64, 2, 7.94, 16.47 },		// conv1d_3 of the language models
+	{ 32, 7, 64, 2, 2.82, 5.30 },		// conv1d_34 of the keras2c models
+	{ 4, 998, 8, 8, 42.66, 29.06 },		// conv1d_5 of gsc
+};
+
+// Applicable, with a measured speed-up over GEMM
+inline bool faster(const Layer &layer) {
+	if (!applicable(layer))
+		return false;
+	for (const Measurement &m : MEASURED)
+		if (m.channels == layer.channels && m.samples == layer.samples && m.filters == layer.filters
+				&& m.kernel_size == layer.kernel_size)
+			return m.winograd_us < m.gemm_us;
+	return false;
+}
+
+// Filter transforms U[f][c][pair][3] and the odd last tap of each [f][c]
+struct TransformedWeights {
+	size_t pairs;
+	std::vector<wrap_t> u;
+	std::vector<wrap_t> tail;
+};
+
+inline TransformedWeights transform_weights(const Layer &layer) {
+	TransformedWeights t;
+	const size_t K = layer.kernel_size;
+	t.pairs = K / 2;
+	t.u.resize(layer.filters * layer.channels * t.pairs * 3);
+	t.tail.assign(layer.filters * layer.channels, 0);
+
+	for (size_t f = 0; f < layer.filters; f++)
+		for (size_t c = 0; c < layer.channels; c++) {
+			const number_t *g = layer.kernel + (f * layer.channels + c) * K;
+			wrap_t *u = &t.u[((f * layer.channels + c) * t.pairs) * 3];
+			for (size_t s = 0; s < t.pairs; s++) {
+				u[s * 3 + 0] = (wrap_t)(long_number_t)g[2 * s];
+				u[s * 3 + 1] = (wrap_t)((long_number_t)g[2 * s] + g[2 * s + 1]);
+				u[s * 3 + 2] = (wrap_t)(long_number_t)g[2 * s + 1];
+			}
+			if (K % 2)
+				t.tail[f * layer.channels + c] = (wrap_t)(long_number_t)g[K - 1];
+		}
+	return t;
+}
+
+// Multiplications per layer, transforms excluded
+inline size_t multiplications(const Layer &layer) {
+	const size_t tiles = layer.out_samples / 2, K = layer.kernel_size;
+	size_t per_fc = tiles * (3 * (K / 2) + 2 * (K % 2)) + (layer.out_samples % 2) * K;
+	return layer.filters * layer.channels * per_fc;
+}
+
+inline void conv1d(const Layer &layer, const TransformedWeights &weights, const number_t *input, number_t *output) {
+	static thread_local std::vector<wrap_t> v;
+
+	const size_t C = layer.channels, S = layer.samples, OS = layer.out_samples, K = layer.kernel_size;
+	const size_t tiles = OS / 2;
+	const size_t positions = tiles + weights.pairs - 1;	// Input tiles read by all pairs
+
+	// Input transform, as three planes [3][C][positions], padded so the last tile
+	// block can always read TILE_BLOCK values
+	v.assign(3 * C * positions + TILE_BLOCK, 0);
+	wrap_t *v0 = v.data(), *v1 = v0 + C * positions, *v2 = v1 + C * positions;
+	for (size_t c = 0; c < C; c++) {
+		const number_t *d = input + c * S;
+		for (size_t u = 0; u < positions; u++) {
+			long_number_t d0 = d[2 * u], d1 = d[2 * u + 1], d2 = d[2 * u + 2];
+			v0[c * positions + u] = (wrap_t)(d0 - d1);
+			v1[c * positions + u] = (wrap_t)d1;
+			v2[c * positions + u] = (wrap_t)(d2 - d1);
+		}
+	}
+
+	for (size_t f = 0; f < layer.filters; f++) {
+		number_t *out = output + f * OS;
+
+		// Register-tiled over TILE_BLOCK output pairs: the transform-domain sums of
+		// all channels and tap pairs stay in registers until the output transform
+		for (size_t t0 = 0; t0 < tiles; t0 += TILE_BLOCK) {
+			const size_t tb = std::min(TILE_BLOCK, tiles - t0);
+			wrap_vec m0 = {}, m1 = {}, m2 = {};
+
+			for (size_t c = 0; c < C; c++) {
+				const wrap_t *u = &weights.u[((f * C + c) * weights.pairs) * 3];
+				const size_t base = c * positions + t0;
+				for (size_t s = 0; s < weights.pairs; s++) {
+					const wrap_t u0 = u[s * 3], u1 = u[s * 3 + 1], u2 = u[s * 3 + 2];
+					wrap_vec a, b, e;
+					memcpy(&a, v0 + base + s, sizeof(a));
+					memcpy(&b, v1 + base + s, sizeof(b));
+					memcpy(&e, v2 + base + s, sizeof(e));
+					m0 += u0 * a;
+					m1 += u1 * b;
+					m2 += u2 * e;
+				}
+			}
+
+			// Output transform; odd last tap folded in directly
+			for (size_t j = 0; j < tb; j++) {
+				const size_t t = t0 + j;
+				wrap_t y0 = m0[j] + m1[j], y1 = m1[j] + m2[j];
+				if (K % 2)
+					for (size_t c = 0; c < C; c++) {
+						const wrap_t g = weights.tail[f * C + c];
+						const number_t *d = input + c * S + 2 * t + K - 1;
+						y0 += g * (wrap_t)(long_number_t)d[0];
+						y1 += g * (wrap_t)(long_number_t)d[1];
+					}
+				out[2 * t] = requantize((long_number_t)y0, layer.shift, layer.bias[f], layer.relu);
+				out[2 * t + 1] = requantize((long_number_t)y1, layer.shift, layer.bias[f], layer.relu);
+			}
+		}
+
+		// Odd last output, direct
+		if (OS % 2) {
+			long_number_t acc = 0;
+			for (size_t c = 0; c < C; c++) {
+				const number_t *d = input + c * S + OS - 1;
+				const number_t *g = layer.kernel + (f * C + c) * K;
+				for (size_t x = 0; x < K; x++)
+					acc += d[x] * g[x];
+			}
+			out[OS - 1] = requantize(acc, layer.shift, layer.bias[f], layer.relu);
+		}
+	}
+}
+
+} // namespace winograd
+
+// Winograd F(2,2) on the stride-1 conv1d layers where it was measured faster (or
+// on all of them with always), GEMM on the others
+class WinogradBackend : public GemmBackend {
+public:
+	explicit WinogradBackend(bool always = false) : always(always) {}
+
+	const char *name() const override { return "winograd"; }
+
+	void prepare(const Model &model) override {
+		GemmBackend::prepare(model);
+		transformed.assign(model.layers.size(), winograd::TransformedWeights());
+		use.assign(model.layers.size(), false);
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			const Layer &layer = model.layers[i];
+			use[i] = always ? winograd::applicable(layer) : winograd::faster(layer);
+			if (use[i])
+				transformed[i] = winograd::transform_weights(layer);
+		}
+	}
+
+	void conv1d(size_t i, const Layer &layer, const number_t *input, number_t *output) override {
+		if (use.at(i))
+			winograd::conv1d(layer, transformed.at(i), input, output);
+		else
+			GemmBackend::conv1d(i, layer, input, output);
+	}
+
+	// Layers running the Winograd kernel
+	const std::vector<bool> &winograd_layers() const { return use; }
+
+private:
+	bool always;
+	std::vector<bool> use;
+	std::vector<winograd::TransformedWeights> transformed;
+};
+
+} // namespace engine
+
+#endif // __ENGINE_WINOGRAD_H__
@@ -3,14 +3,26 @@
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
+#include <string>
 #include <vector>
 
-#include "model.h"
+// The generated model is compiled into this translation unit so the host engine
+// can reference its weight arrays: build with -Igsc_output_fixed and do not link model.c
+#include "model.c"
+
+#include "engine/backends.h"
+#include "engine/blob_model.h"
+#include "engine/delta_model.h"
+#include "engine/language_model.h"
+#include "engine/perf_counters.h"
+#include "engine/trace.h"
 
 template<int N>
 std::vector<std::array<float, N>> readInputsFromFile(const char *filename) {
 	// Read training vectors from CSV file
+	engine::trace::Scope span("read csv", "input");
 	std::vector<std::array<float, N>> inputs;
 	std::ifstream fin(filename);
 	if (!fin) {
@@ -39,18 +51,25 @@ void convert_input_vector(const std::array<float, Channels*Samples> &input, numb
 	}
 }
 
-//Compute testing accuracy
-template<size_t InputDims, size_t OutputDims>
-float evaluate(const std::vector<std::array<float, InputDims>> &inputs, const std::vector<std::array<float, OutputDims>> &labels) {
+//Compute testing accuracy, predict(input, output) runs one inference
+template<size_t InputDims, size_t OutputDims, typename Predict>
+float evaluate(const std::vector<std::array<float, InputDims>> &inputs, const std::vector<std::array<float, OutputDims>> &labels, Predict predict) {
 	int rightlabels = 0;
 	std::array<number_t, OutputDims> outputs = {};
 
 	for (size_t i = 0;  i < inputs.size() && i < labels.size(); i++) {
 		number_t converted_input[MODEL_INPUT_CHANNELS][MODEL_INPUT_SAMPLES];
 
-		convert_input_vector<MODEL_INPUT_CHANNELS, MODEL_INPUT_SAMPLES>(inputs.at(i), converted_input);
-		cnn(converted_input, outputs.data());
+		{
+			engine::trace::Scope span("convert_input_vector", "input");
+			convert_input_vector<MODEL_INPUT_CHANNELS, MODEL_INPUT_SAMPLES>(inputs.at(i), converted_input);
+		}
+		{
+			engine::trace::Scope span("cnn", "model");
+			predict(converted_input, outputs.data());
+		}
 
+		engine::trace::Scope span("tally", "output");
 		auto cls = std::max_element(outputs.begin(), outputs.end()) - outputs.begin();
 
 		if (labels.at(i).at(cls) > 0) {
@@ -61,17 +80,109 @@ float evaluate(const std::vector<std::array<float, InputDims>> &inputs, const st
 }
 
 int main(int argc, const char *argv[]) {
-	if (argc != 3) {
-		std::cerr << "Usage: " << argv[0] << " testX.csv testY.csv" << std::endl;
+	std::string backend_name, counters_file, trace_file, weights_file, delta_file;
+	bool perf = false;
+	std::vector<const char *> files;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 10, "--backend=") == 0)
+			backend_name = arg.substr(10);
+		else if (arg.compare(0, 11, "--counters=") == 0)
+			counters_file = arg.substr(11);
+		else if (arg == "--perf")
+			perf = true;
+		else if (arg.compare(0, 8, "--trace=") == 0)
+			trace_file = arg.substr(8);
+		else if (arg.compare(0, 10, "--weights=") == 0)
+			weights_file = arg.substr(10);
+		else if (arg.compare(0, 8, "--delta=") == 0)
+			delta_file = arg.substr(8);
+		else
+			files.push_back(argv[i]);
+	}
+
+	if (files.size() != 2) {
+		std::cerr << "Usage: " << argv[0] << " [--backend=NAME] [--counters=FILE.json] [--perf] [--trace=FILE.json] [--weights=FILE.bin [--delta=FILE.delta]] testX.csv testY.csv" << std::endl;
+		std::cerr << "Without --backend the generated cnn() is used, or the reference engine with --weights. Backends:";
+		for (const auto &name : engine::backend_names())
+			std::cerr << " " << name;
+		std::cerr << std::endl;
 		exit(1);
 	}
+#ifdef ENGINE_INSTRUMENT
+	// Counters come from the engine: the reference backend is bit-exact with cnn()
+	if (!counters_file.empty() && backend_name.empty())
+		backend_name = "reference";
+#else
+	if (!counters_file.empty())
+		engine::fatal("--counters needs a build with -DENGINE_INSTRUMENT");
+#endif
+	// A delta is decoded layer by layer on top of the blob by its own backend
+	if (!delta_file.empty() && (weights_file.empty() || !backend_name.empty() || perf))
+		engine::fatal("--delta needs --weights with the base blob, and no --backend or --perf");
+	// Blob weights run on the engine; the generated functions use the compiled-in ones
+	if (!weights_file.empty() && backend_name.empty())
+		backend_name = delta_file.empty() ? "reference" : "delta";
+	// Layer by layer on the engine: the generated layer functions by default
+	if (perf && backend_name.empty())
+		backend_name = "generated";
 
-	auto inputs = readInputsFromFile<MODEL_INPUT_SAMPLES*MODEL_INPUT_CHANNELS>(argv[1]);
-	auto labels = readInputsFromFile<MODEL_OUTPUT_SAMPLES>(argv[2]);
+	if (!trace_file.empty()) {
+		engine::trace::Recorder::get().enable();
+		engine::trace::set_thread_name("main");
+	}
+
+	auto inputs = readInputsFromFile<MODEL_INPUT_SAMPLES*MODEL_INPUT_CHANNELS>(files[0]);
+	auto labels = readInputsFromFile<MODEL_OUTPUT_SAMPLES>(files[1]);
 
-	auto acc = evaluate(inputs, labels);
+	// Outlives the trace, which refers to its layer names; a blob model points into the mapping
+	std::unique_ptr<engine::blob::MappedBlob> blob;
+	if (!weights_file.empty())
+		blob.reset(new engine::blob::MappedBlob(weights_file));
+	std::unique_ptr<engine::blob::MappedDelta> delta;
+	if (!delta_file.empty())
+		delta.reset(new engine::blob::MappedDelta(delta_file, blob->get()));
+	const engine::Model model = blob ? engine::blob::blob_model(blob->get()) : LANGUAGE_MODEL("gsc_output_fixed");
+	if (model.input_channels != MODEL_INPUT_CHANNELS || model.input_samples != MODEL_INPUT_SAMPLES
+			|| model.output_size() != MODEL_OUTPUT_SAMPLES)
+		engine::fatal(model.name + ": input or output shape differs from the test set");
+	float acc;
+	if (backend_name.empty()) {
+		acc = evaluate(inputs, labels, [](const number_t input[MODEL_INPUT_CHANNELS][MODEL_INPUT_SAMPLES], number_t *output) {
+			cnn(input, output);
+		});
+	} else {
+		std::unique_ptr<engine::Backend> backend = delta ? std::unique_ptr<engine::Backend>(new engine::blob::DeltaBackend(delta->get()))
+			: engine::make_backend(backend_name);
+		backend->prepare(model);
+		engine::Engine runner(model, *backend);
+		engine::LayerProfiler profiler(model);
+		if (perf)
+			runner.set_sink(&profiler);
+		acc = evaluate(inputs, labels, [&runner](const number_t input[MODEL_INPUT_CHANNELS][MODEL_INPUT_SAMPLES], number_t *output) {
+			runner.run(&input[0][0], output);
+		});
+#ifdef ENGINE_INSTRUMENT
+		if (!counters_file.empty()) {
+			std::ofstream fout(counters_file);
+			if (!fout)
+				engine::fatal("cannot write \"" + counters_file + "\"");
+			engine::instrument::write_json(fout, model, runner.get_counters(), std::min(inputs.size(), labels.size()));
+		}
+#endif
+		if (perf)
+			profiler.report(std::cerr);
+	}
 
 	std::cerr << "Testing accuracy: " << acc << std::endl;
 
+	if (!trace_file.empty()) {
+		std::ofstream fout(trace_file);
+		if (!fout)
+			engine::fatal("cannot write \"" + trace_file + "\"");
+		engine::trace::Recorder::get().write_json(fout);
+	}
+
 	return 0;
 }
@@ -0,0 +1,168 @@
+// Activation sparsity of every conv1d/dense layer input over a set of clips, and
+// the dense (GEMM conv1d, reference dense) vs zero-skipping kernel times on those
+// inputs. The break-even density extrapolates the sparse time linearly in the
+// number of non-zero inputs; SparseBackend switches to the sparse kernels below
+// the threshold of each layer (sparse::MEASURED, or --threshold for all layers).
+// --table prints the lowest break-even of every layer shape over the variants
+// run, as the entries of sparse::MEASURED.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -o activation_sparsity tools/activation_sparsity.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../engine/backends.h"
+#include "../engine/variants.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+struct LayerStats {
+	double density_sum = 0, density_min = 1, density_max = 0;
+	size_t zero_channels = 0, channels = 0;
+	double dense_us = 0, sparse_us = 0;
+	bool exact = true;
+};
+
+// Lowest break-even density of a layer shape
+struct ShapeThreshold {
+	engine::Layer shape;
+	double density;
+};
+
+template<typename Fn>
+static double elapsed_us(Fn fn) {
+	auto start = std::chrono::steady_clock::now();
+	fn();
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+int main(int argc, const char *argv[]) {
+	std::string inputs_file, only;
+	size_t clips = 64;
+	float threshold = 0;
+	bool fixed = false, table = false;
+	for (int i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "--inputs=", 9))
+			inputs_file = argv[i] + 9;
+		else if (!strncmp(argv[i], "--clips=", 8) && atoi(argv[i] + 8) > 0)
+			clips = atoi(argv[i] + 8);
+		else if (!strncmp(argv[i], "--variant=", 10))
+			only = argv[i] + 10;
+		else if (!strncmp(argv[i], "--threshold=", 12)) {
+			threshold = atof(argv[i] + 12);
+			fixed = true;
+		} else if (!strcmp(argv[i], "--table"))
+			table = true;
+		else {
+			std::cerr << "Usage: " << argv[0] << " [--inputs=x_test.csv | --clips=N] [--variant=NAME] [--threshold=T] [--table]"
+				<< std::endl;
+			std::cerr << "Without --inputs, N synthetic clips are used (default 64)" << std::endl;
+			exit(1);
+		}
+	}
+
+	bool exact = true;
+	std::vector<ShapeThreshold> shapes;
+	std::cout << std::fixed << std::setprecision(3);
+	for (const auto &variant : variants::all()) {
+		if (!only.empty() && only != variant.name)
+			continue;
+		// The CSV files hold language detection clips only
+		if (!inputs_file.empty() && !variant.language)
+			continue;
+		engine::Model model = variant.describe();
+		auto inputs = dataset::load_inputs(model, inputs_file, clips);
+
+		engine::ReferenceBackend reference;
+		engine::SparseBackend dense_kernels(-1), sparse_kernels(2);	// Never / always sparse
+		engine::SparseBackend chosen = fixed ? engine::SparseBackend(threshold) : engine::SparseBackend();
+		engine::Engine runner(model, reference);
+		dense_kernels.prepare(model);
+		sparse_kernels.prepare(model);
+		chosen.prepare(model);
+		std::vector<LayerStats> stats(model.layers.size());
+		engine::sparse::NonZeros nz;
+
+		for (const auto &input : inputs) {
+			std::vector<number_t> in = input, out, check;
+			for (size_t i = 0; i < model.layers.size(); i++) {
+				const engine::Layer &layer = model.layers[i];
+				out.assign(layer.output_size(), 0);
+				if (layer.has_weights()) {
+					LayerStats &s = stats[i];
+					engine::sparse::scan_input(layer, in.data(), nz);
+					double d = nz.density();
+					s.density_sum += d;
+					s.density_min = std::min(s.density_min, d);
+					s.density_max = std::max(s.density_max, d);
+					for (size_t c = 0; c < nz.channels; c++) {
+						bool zero = true;
+						for (size_t w = 0; w < nz.words && zero; w++)
+							zero = !nz.bits[c * nz.words + w];
+						s.zero_channels += zero;
+					}
+					s.channels += nz.channels;
+
+					check.assign(layer.output_size(), 0);
+					if (layer.kind == engine::LayerKind::Conv1D) {
+						s.dense_us += elapsed_us([&]() { dense_kernels.conv1d(i, layer, in.data(), out.data()); });
+						s.sparse_us += elapsed_us([&]() { sparse_kernels.conv1d(i, layer, in.data(), check.data()); });
+					} else {
+						s.dense_us += elapsed_us([&]() { dense_kernels.dense(i, layer, in.data(), out.data()); });
+						s.sparse_us += elapsed_us([&]() { sparse_kernels.dense(i, layer, in.data(), check.data()); });
+					}
+					s.exact = s.exact && out == check;
+				} else {
+					runner.run_layer(i, in.data(), out.data());
+				}
+				in.swap(out);
+			}
+		}
+
+		std::cout << std::endl << variant.name << " (" << inputs.size() << " clips)" << std::endl;
+		std::cout << std::left << std::setw(18) << "layer" << std::right << std::setw(9) << "density" << std::setw(8) << "min"
+			<< std::setw(8) << "max" << std::setw(11) << "zero chan" << std::setw(11) << "dense us" << std::setw(11) << "sparse us"
+			<< std::setw(12) << "break-even" << std::setw(11) << "threshold" << std::setw(8) << "kernel" << std::setw(7) << "exact"
+			<< std::endl;
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			const LayerStats &s = stats[i];
+			if (!model.layers[i].has_weights())
+				continue;
+			const double n = inputs.size(), density = s.density_sum / n;
+			const double break_even = s.sparse_us > 0 ? density * s.dense_us / s.sparse_us : 0;
+			exact = exact && s.exact;
+			const engine::Layer &layer = model.layers[i];
+			auto same = std::find_if(shapes.begin(), shapes.end(), [&](const ShapeThreshold &t) {
+				return t.shape.kind == layer.kind && t.shape.channels == layer.channels && t.shape.samples == layer.samples
+					&& t.shape.filters == layer.filters && t.shape.kernel_size == layer.kernel_size && t.shape.stride == layer.stride;
+			});
+			if (same == shapes.end())
+				shapes.push_back({ layer, break_even });
+			else
+				same->density = std::min(same->density, break_even);
+			std::cout << std::left << std::setw(18) << model.layers[i].name << std::right << std::setprecision(3)
+				<< std::setw(9) << density << std::setw(8) << s.density_min << std::setw(8) << s.density_max
+				<< std::setw(11) << s.zero_channels / (double)s.channels << std::setprecision(1)
+				<< std::setw(11) << s.dense_us / n << std::setw(11) << s.sparse_us / n << std::setprecision(3)
+				<< std::setw(12) << break_even << std::setw(11) << chosen.threshold(i)
+				<< std::setw(8) << (density <= chosen.threshold(i) ? "sparse" : "dense")
+				<< std::setw(7) << (s.exact ? "yes" : "NO") << std::endl;
+		}
+	}
+
+	if (table) {
+		std::cout << std::endl;
+		for (const ShapeThreshold &t : shapes)
+			std::cout << "\t{ LayerKind::" << (t.shape.kind == engine::LayerKind::Dense ? "Dense" : "Conv1D") << ", "
+				<< t.shape.channels << ", " << t.shape.samples << ", " << t.shape.filters << ", " << t.shape.kernel_size << ", "
+				<< t.shape.stride << ", " << t.density << "f }," << std::endl;
+	}
+	return exact ? 0 : 1;
+}
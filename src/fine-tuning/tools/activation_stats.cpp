@@ -0,0 +1,160 @@
+// Per-layer activation statistics over a clip corpus.
+//
+// Clips are streamed from the CSV file (or generated) and scored by one Engine
+// per thread on a shared GEMM backend, each with its own ActivationStats sink
+// (engine/activation_stats.h); the per-thread statistics are merged at the end.
+// The report gives, per layer, the value range, the zero fraction (over all
+// channels and its range across channels), the channels that are always zero and
+// the bits needed by 99.9% and 100% of the magnitudes, plus the share of the run
+// time spent in the sink. --json writes the per-channel statistics; --trace writes
+// the decode, conversion, clip and layer spans of every thread (engine/trace.h).
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -pthread -o activation_stats tools/activation_stats.cpp
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../engine/activation_stats.h"
+#include "../engine/gemm.h"
+#include "../engine/trace.h"
+#include "../engine/variants.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+typedef std::chrono::steady_clock Clock;
+
+// Times the statistics sink it forwards to
+class TimedSink : public engine::ActivationSink {
+public:
+	explicit TimedSink(engine::ActivationStats &stats) : stats(stats) {}
+
+	void layer_output(size_t i, const engine::Layer &layer, const number_t *output) override {
+		auto start = Clock::now();
+		stats.layer_output(i, layer, output);
+		elapsed += Clock::now() - start;
+	}
+
+	Clock::duration elapsed = Clock::duration::zero();
+
+private:
+	engine::ActivationStats &stats;
+};
+
+int main(int argc, const char *argv[]) {
+	std::string inputs_file, variant_name = "fine-tuning", json_file, trace_file;
+	size_t clips = 256;
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	for (int i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "--inputs=", 9))
+			inputs_file = argv[i] + 9;
+		else if (!strncmp(argv[i], "--clips=", 8) && atoi(argv[i] + 8) > 0)
+			clips = atoi(argv[i] + 8);
+		else if (!strncmp(argv[i], "--variant=", 10))
+			variant_name = argv[i] + 10;
+		else if (!strncmp(argv[i], "--threads=", 10) && atoi(argv[i] + 10) > 0)
+			threads = atoi(argv[i] + 10);
+		else if (!strncmp(argv[i], "--json=", 7))
+			json_file = argv[i] + 7;
+		else if (!strncmp(argv[i], "--trace=", 8))
+			trace_file = argv[i] + 8;
+		else {
+			std::cerr << "Usage: " << argv[0] << " [--inputs=x_test.csv | --clips=N] [--variant=NAME] [--threads=N] [--json=FILE] [--trace=FILE]" << std::endl;
+			std::cerr << "Without --inputs, N synthetic clips are used (default 256)" << std::endl;
+			exit(1);
+		}
+	}
+
+	const variants::Variant &variant = variants::find(variant_name);
+	const engine::Model model = variant.describe();
+	engine::GemmBackend backend;
+	backend.prepare(model);
+	if (!trace_file.empty())
+		engine::trace::Recorder::get().enable();
+	dataset::Stream stream(model, inputs_file, clips);
+
+	std::vector<std::unique_ptr<engine::ActivationStats>> stats;
+	std::vector<Clock::duration> run_time(threads), sink_time(threads);
+	std::vector<size_t> scored(threads, 0);
+	for (unsigned t = 0; t < threads; t++)
+		stats.emplace_back(new engine::ActivationStats(model));
+
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < threads; t++)
+		workers.emplace_back([&, t]() {
+			engine::trace::set_thread_name("worker " + std::to_string(t));
+			engine::Engine runner(model, backend);
+			TimedSink sink(*stats[t]);
+			runner.set_sink(&sink);
+			std::vector<number_t> clip, output(model.output_size());
+			auto start = Clock::now();
+			while (stream.next(clip)) {
+				engine::trace::Scope span("clip", "model");
+				runner.run(clip.data(), output.data());
+				scored[t]++;
+			}
+			run_time[t] = Clock::now() - start;
+			sink_time[t] = sink.elapsed;
+		});
+	for (auto &worker : workers)
+		worker.join();
+
+	engine::ActivationStats &total = *stats[0];
+	size_t count = scored[0];
+	Clock::duration run = run_time[0], sink = sink_time[0];
+	for (unsigned t = 1; t < threads; t++) {
+		total.merge(*stats[t]);
+		count += scored[t];
+		run += run_time[t];
+		sink += sink_time[t];
+	}
+
+	std::cout << variant.name << ": " << count << (inputs_file.empty() ? " synthetic" : "") << " clips, "
+		<< threads << " threads, statistics " << std::fixed << std::setprecision(1)
+		<< 100.0 * sink.count() / std::max<Clock::rep>(1, run.count()) << "% of run time" << std::endl;
+	std::cout << std::left << std::setw(20) << "layer" << std::right << std::setw(6) << "chan" << std::setw(8) << "min"
+		<< std::setw(8) << "max" << std::setw(8) << "zeros" << std::setw(16) << "chan zeros" << std::setw(7) << "dead"
+		<< std::setw(10) << "bits99.9" << std::setw(6) << "bits" << std::endl;
+	for (size_t i = 0; i < model.layers.size(); i++) {
+		const engine::Layer &layer = model.layers[i];
+		if (layer.kind == engine::LayerKind::Flatten)
+			continue;
+		const engine::ChannelStats all = total.layer(i);
+		double lo = 1, hi = 0;
+		size_t dead = 0;
+		for (const auto &c : total.channels(i)) {
+			double z = c.count ? c.zeros() / (double)c.count : 0;
+			lo = std::min(lo, z);
+			hi = std::max(hi, z);
+			dead += c.count && c.zeros() == c.count;
+		}
+		std::ostringstream range;
+		range << std::fixed << std::setprecision(3) << lo << "-" << hi;
+		std::cout << std::left << std::setw(20) << layer.name << std::right << std::setw(6) << layer.filters
+			<< std::setw(8) << all.min << std::setw(8) << all.max << std::setprecision(3)
+			<< std::setw(8) << (all.count ? all.zeros() / (double)all.count : 0) << std::setw(16) << range.str()
+			<< std::setw(7) << dead << std::setw(10) << all.magnitude_bits(0.999) << std::setw(6) << all.magnitude_bits(1) << std::endl;
+	}
+
+	if (!json_file.empty()) {
+		std::ofstream fout(json_file);
+		if (!fout)
+			engine::fatal("cannot write \"" + json_file + "\"");
+		total.write_json(fout);
+	}
+	if (!trace_file.empty()) {
+		std::ofstream fout(trace_file);
+		if (!fout)
+			engine::fatal("cannot write \"" + trace_file + "\"");
+		engine::trace::Recorder::get().write_json(fout);
+	}
+	return 0;
+}
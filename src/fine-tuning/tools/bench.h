@@ -0,0 +1,103 @@
+// Timing helpers shared by the benchmark tools: CPU pinning, repeated timed
+// samples on warm caches, summary statistics and JSON output.
+//
+// A sample is the mean time per call over a batch of calls, the batch being
+// sized once so a sample lasts at least min_sample_us; the repetitions give the
+// distribution the summaries (and bench_compare's bootstrap) work on.
+
+#ifndef __TOOLS_BENCH_H__
+#define __TOOLS_BENCH_H__
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+typedef std::chrono::steady_clock Clock;
+
+// Pins the calling thread to cpu; false if the CPU is not available
+inline bool pin_thread(int cpu) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+inline double elapsed_ns(Clock::time_point start) {
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// ns per call of fn, one value per repetition
+template<typename Fn>
+std::vector<double> time_samples(Fn fn, size_t repetitions, double min_sample_us = 2000) {
+	// Warm-up, then batch size from a single timed call
+	fn();
+	auto start = Clock::now();
+	fn();
+	const double once = std::max(1.0, elapsed_ns(start));
+	const size_t batch = std::max<size_t>(1, (size_t)(min_sample_us * 1000 / once));
+
+	std::vector<double> samples;
+	for (size_t r = 0; r < repetitions; r++) {
+		start = Clock::now();
+		for (size_t n = 0; n < batch; n++)
+			fn();
+		samples.push_back(elapsed_ns(start) / batch);
+	}
+	return samples;
+}
+
+inline double percentile(std::vector<double> values, double q) {
+	if (values.empty())
+		return 0;
+	std::sort(values.begin(), values.end());
+	double pos = q * (values.size() - 1);
+	size_t lo = (size_t)pos, hi = std::min(lo + 1, values.size() - 1);
+	return values[lo] + (pos - lo) * (values[hi] - values[lo]);
+}
+
+struct Summary {
+	double median, mean, min, max, p10, p90, stddev;
+};
+
+inline Summary summarize(const std::vector<double> &values) {
+	Summary s = {};
+	if (values.empty())
+		return s;
+	double sum = 0, sq = 0;
+	for (double v : values)
+		sum += v;
+	s.mean = sum / values.size();
+	for (double v : values)
+		sq += (v - s.mean) * (v - s.mean);
+	s.stddev = values.size() > 1 ? std::sqrt(sq / (values.size() - 1)) : 0;
+	s.min = *std::min_element(values.begin(), values.end());
+	s.max = *std::max_element(values.begin(), values.end());
+	s.median = percentile(values, 0.5);
+	s.p10 = percentile(values, 0.1);
+	s.p90 = percentile(values, 0.9);
+	return s;
+}
+
+inline void write_json(std::ostream &out, const Summary &s) {
+	out << "{ \"median\": " << s.median << ", \"mean\": " << s.mean << ", \"min\": " << s.min << ", \"max\": " << s.max
+		<< ", \"p10\": " << s.p10 << ", \"p90\": " << s.p90 << ", \"stddev\": " << s.stddev << " }";
+}
+
+inline void write_json(std::ostream &out, const std::vector<double> &values) {
+	out << "[";
+	for (size_t n = 0; n < values.size(); n++)
+		out << (n ? ", " : "") << values[n];
+	out << "]";
+}
+
+} // namespace bench
+
+#endif // __TOOLS_BENCH_H__
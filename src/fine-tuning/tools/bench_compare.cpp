@@ -0,0 +1,121 @@
+// Performance regression gate: compares benchmark JSON (microbench kernels,
+// model_bench models) with a stored baseline.
+//
+// Entries are matched by name. For each pair the ratio of median times
+// current / baseline is estimated with a percentile bootstrap over the raw samples
+// (both sets resampled with replacement). An entry regresses when the whole
+// confidence interval lies above 1 + threshold, and improves when it lies below
+// 1 - threshold; anything else is within noise. The exit status is 1 if any entry
+// regresses, so the tool can gate a build; entries missing on either side are
+// listed but do not fail it.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -o bench_compare tools/bench_compare.cpp
+
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "json.h"
+
+struct Entry {
+	std::string name;
+	std::vector<double> samples;
+};
+
+// Kernel and model entries of a benchmark file
+static std::vector<Entry> read_entries(const std::string &filename) {
+	const json::Value root = json::read_file(filename);
+	std::vector<Entry> entries;
+	for (const char *list : { "kernels", "models" })
+		if (root.has(list))
+			for (const auto &e : root[list].array)
+				entries.push_back({ e["name"].string, e["samples"].numbers() });
+	if (entries.empty())
+		engine::fatal("no benchmark entries in \"" + filename + "\"");
+	return entries;
+}
+
+static double median_of_resample(const std::vector<double> &samples, std::mt19937 &rng, std::vector<double> &buffer) {
+	std::uniform_int_distribution<size_t> pick(0, samples.size() - 1);
+	buffer.resize(samples.size());
+	for (auto &v : buffer)
+		v = samples[pick(rng)];
+	std::nth_element(buffer.begin(), buffer.begin() + buffer.size() / 2, buffer.end());
+	return buffer[buffer.size() / 2];
+}
+
+int main(int argc, const char *argv[]) {
+	std::vector<std::string> files;
+	double threshold = 0.05, confidence = 0.95;
+	size_t resamples = 2000;
+	bool usage = false, verbose = false;
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 12, "--threshold=") == 0)
+			usage = (threshold = atof(arg.c_str() + 12)) < 0;
+		else if (arg.compare(0, 13, "--confidence=") == 0)
+			usage = (confidence = atof(arg.c_str() + 13)) <= 0 || confidence >= 1;
+		else if (arg.compare(0, 12, "--resamples=") == 0)
+			usage = (resamples = atoi(arg.c_str() + 12)) == 0;
+		else if (arg == "--verbose")
+			verbose = true;
+		else
+			files.push_back(arg);
+	}
+	if (usage || files.size() != 2) {
+		std::cerr << "Usage: " << argv[0] << " [--threshold=0.05] [--confidence=0.95] [--resamples=N] [--verbose] baseline.json current.json" << std::endl;
+		std::cerr << "Exits with 1 if an entry is slower than baseline by more than the threshold with the given confidence" << std::endl;
+		exit(1);
+	}
+
+	const std::vector<Entry> baseline = read_entries(files[0]), current = read_entries(files[1]);
+	std::mt19937 rng(0);
+	std::vector<double> ratios(resamples), buffer;
+	size_t regressions = 0, improvements = 0, compared = 0;
+
+	std::cout << std::left << std::setw(56) << "entry" << std::right << std::setw(12) << "baseline" << std::setw(12) << "current"
+		<< std::setw(9) << "change" << std::setw(20) << "CI" << "  status" << std::endl;
+	for (const auto &cur : current) {
+		auto base = std::find_if(baseline.begin(), baseline.end(), [&](const Entry &e) { return e.name == cur.name; });
+		if (base == baseline.end()) {
+			std::cout << std::left << std::setw(56) << cur.name << "  new, not in baseline" << std::endl;
+			continue;
+		}
+		if (base->samples.empty() || cur.samples.empty())
+			continue;
+		compared++;
+		for (auto &r : ratios)
+			r = median_of_resample(cur.samples, rng, buffer) / median_of_resample(base->samples, rng, buffer);
+		const double alpha = (1 - confidence) / 2;
+		const double lo = bench::percentile(ratios, alpha), hi = bench::percentile(ratios, 1 - alpha);
+		const double base_median = bench::percentile(base->samples, 0.5), cur_median = bench::percentile(cur.samples, 0.5);
+
+		const char *status = "";
+		if (lo > 1 + threshold) {
+			status = "REGRESSION";
+			regressions++;
+		} else if (hi < 1 - threshold) {
+			status = "improved";
+			improvements++;
+		} else if (!verbose) {
+			continue;
+		}
+		std::ostringstream ci;
+		ci << std::showpos << std::fixed << std::setprecision(1) << "[" << 100 * (lo - 1) << "%, " << 100 * (hi - 1) << "%]";
+		std::cout << std::left << std::setw(56) << cur.name << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(12) << base_median << std::setw(12) << cur_median << std::showpos
+			<< std::setw(8) << 100 * (cur_median / base_median - 1) << "%" << std::noshowpos
+			<< std::setw(20) << ci.str() << "  " << status << std::endl;
+	}
+	for (const auto &base : baseline)
+		if (std::none_of(current.begin(), current.end(), [&](const Entry &e) { return e.name == base.name; }))
+			std::cout << std::left << std::setw(56) << base.name << "  missing from current" << std::endl;
+
+	std::cout << compared << " entries compared, " << regressions << " regressions, " << improvements << " improvements"
+		<< " (threshold " << 100 * threshold << "%, " << 100 * confidence << "% confidence)" << std::endl;
+	return regressions ? 1 : 0;
+}
@@ -0,0 +1,302 @@
+// Post-training calibration of per-layer fixed-point formats.
+//
+// The generated model uses FIXED_POINT fractional bits for every weight and
+// activation. This tool runs the float reference of the model (weights
+// dequantised, engine/float_model.h) over calibration clips, collects a
+// magnitude histogram of every conv1d/dense output and the largest accumulator,
+// and chooses per layer
+//  - the weight fractional bits minimising the weight quantisation error, with the
+//    accumulator kept below 2^30 for the calibrated range,
+//  - the output fractional bits minimising the expected saturation plus rounding
+//    error of the histogram (never more than input + weight bits).
+// Pooling and flatten keep their input format; the model input keeps FIXED_POINT
+// so main.cpp's input conversion is unchanged. The int16 model is rebuilt with the
+// rescaled weights and biases and the per-layer shift input + weight - output
+// bits, and compared with the original int16 model and the float reference.
+//
+// --output=DIR writes the generated sources (default: gsc_output_fixed) with the
+// new weights, and each new shift as a <LAYER>_SHIFT macro that replaces
+// scale_number_t() in the layer file and that LANGUAGE_MODEL reads, so main.cpp
+// built with -IDIR runs the same model in cnn() and on the engine. The input must
+// be uncalibrated sources.
+//
+// Like main.cpp, the generated model is compiled in, so build from src/fine-tuning with
+//   g++ -std=c++17 -O3 -Igsc_output_fixed -o calibrate tools/calibrate.cpp
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "model.c"
+
+#include "../engine/engine.h"
+#include "../engine/float_model.h"
+#include "../engine/language_model.h"
+#include "../engine/owned_model.h"
+#include "dataset.h"
+#include "generated_sources.h"
+
+using engine::number_t;
+
+static const int MAX_FRAC_BITS = 15;
+
+// Magnitudes in bins of 1/8 octave
+class MagnitudeHistogram {
+public:
+	static const int BINS_PER_OCTAVE = 8;
+	static const int MIN_EXPONENT = -24;
+	static const int MAX_EXPONENT = 24;
+
+	MagnitudeHistogram() : counts((MAX_EXPONENT - MIN_EXPONENT) * BINS_PER_OCTAVE, 0) {}
+
+	void add(float value) {
+		double magnitude = std::fabs(value);
+		total++;
+		if (magnitude == 0) {
+			zeros++;
+			return;
+		}
+		int bin = (int)std::floor((std::log2(magnitude) - MIN_EXPONENT) * BINS_PER_OCTAVE);
+		counts[std::max(0, std::min((int)counts.size() - 1, bin))]++;
+		max = std::max(max, magnitude);
+	}
+
+	// Expected squared error per value when stored with frac fractional bits in int16
+	double error(int frac) const {
+		const double step = std::ldexp(1.0, -frac), limit = (engine::NUMBER_T_MAX + 0.5) * step;
+		double sum = 0;
+		for (size_t b = 0; b < counts.size(); b++) {
+			if (!counts[b])
+				continue;
+			double value = std::exp2(MIN_EXPONENT + (b + 0.5) / BINS_PER_OCTAVE);
+			if (value > limit)
+				sum += counts[b] * (value - limit) * (value - limit);
+			else
+				sum += counts[b] * std::min(step * step / 12, value * value);
+		}
+		return total ? sum / total : 0;
+	}
+
+	size_t total = 0;
+	size_t zeros = 0;
+	double max = 0;
+
+private:
+	std::vector<size_t> counts;
+};
+
+struct LayerFormat {
+	int input_bits;
+	int weight_bits;
+	int output_bits;
+	double weight_error;
+	double output_error;
+};
+
+static double weight_error(const engine::Layer &layer, const engine::FloatModel &fm, size_t i, int frac) {
+	double sum = 0;
+	for (float w : fm.kernels[i]) {
+		double q = std::max<double>(engine::NUMBER_T_MIN, std::min<double>(engine::NUMBER_T_MAX, std::round(std::ldexp(w, frac))));
+		double e = std::ldexp(q, -frac) - w;
+		sum += e * e;
+	}
+	return sum / layer.weight_count();
+}
+
+static size_t top1(const std::vector<number_t> &output) {
+	return std::max_element(output.begin(), output.end()) - output.begin();
+}
+
+int main(int argc, const char *argv[]) {
+	std::string calibration_file, inputs_file, labels_file, sources = "gsc_output_fixed", output_dir;
+	size_t calibration_clips = 64, clips = 64;
+	bool usage = false;
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 14, "--calibration=") == 0)
+			calibration_file = arg.substr(14);
+		else if (arg.compare(0, 20, "--calibration-clips=") == 0)
+			usage = (calibration_clips = atoi(arg.c_str() + 20)) == 0;
+		else if (arg.compare(0, 9, "--inputs=") == 0)
+			inputs_file = arg.substr(9);
+		else if (arg.compare(0, 9, "--labels=") == 0)
+			labels_file = arg.substr(9);
+		else if (arg.compare(0, 8, "--clips=") == 0)
+			usage = (clips = atoi(arg.c_str() + 8)) == 0;
+		else if (arg.compare(0, 10, "--sources=") == 0)
+			sources = arg.substr(10);
+		else if (arg.compare(0, 9, "--output=") == 0)
+			output_dir = arg.substr(9);
+		else
+			usage = true;
+	}
+	if (usage || inputs_file.empty() != labels_file.empty()) {
+		std::cerr << "Usage: " << argv[0] << " [--calibration=FILE.csv | --calibration-clips=N]" << std::endl
+			<< "       [--inputs=x_test.csv --labels=y_test.csv | --clips=N] [--sources=gsc_output_fixed] [--output=DIR]" << std::endl;
+		exit(1);
+	}
+
+	const engine::Model model = LANGUAGE_MODEL("gsc_output_fixed");
+	for (const auto &layer : model.layers)
+		if (layer.has_weights() && layer.shift != model.fixed_point)
+			engine::fatal(layer.name + ": shift " + std::to_string(layer.shift) + " is not FIXED_POINT, the sources are already calibrated");
+	const engine::FloatModel fm(model);
+	const size_t L = model.layers.size();
+
+	// Float reference over the calibration clips
+	std::vector<MagnitudeHistogram> histograms(L);
+	std::vector<double> max_accumulator(L, 0);
+	for (const auto &clip : dataset::load_inputs(model, calibration_file, calibration_clips, 1)) {
+		std::vector<float> in(clip.size()), out;
+		for (size_t n = 0; n < clip.size(); n++)
+			in[n] = fm.input_value(clip[n]);
+		for (size_t i = 0; i < L; i++) {
+			const engine::Layer &layer = model.layers[i];
+			out.assign(layer.output_size(), 0);
+			if (layer.has_weights()) {
+				// Linear pass for the accumulators, activation applied afterwards
+				engine::Layer linear = layer;
+				linear.relu = false;
+				engine::float_reference::run_layer(fm, i, in.data(), out.data());
+				std::vector<float> pre(layer.output_size());
+				std::vector<float> zero_bias(layer.filters, 0);
+				if (layer.kind == engine::LayerKind::Dense)
+					engine::float_reference::dense(linear, fm.kernels[i].data(), zero_bias.data(), in.data(), pre.data());
+				else
+					engine::float_reference::conv1d(linear, fm.kernels[i].data(), zero_bias.data(), in.data(), pre.data());
+				for (float v : pre)
+					max_accumulator[i] = std::max(max_accumulator[i], (double)std::fabs(v));
+				for (float v : out)
+					histograms[i].add(v);
+			} else {
+				engine::float_reference::run_layer(fm, i, in.data(), out.data());
+			}
+			in.swap(out);
+		}
+	}
+
+	// Formats, layer by layer
+	std::vector<LayerFormat> formats(L);
+	int bits = model.fixed_point;
+	for (size_t i = 0; i < L; i++) {
+		const engine::Layer &layer = model.layers[i];
+		LayerFormat &f = formats[i];
+		f.input_bits = f.output_bits = f.weight_bits = bits;
+		f.weight_error = f.output_error = 0;
+		if (!layer.has_weights())
+			continue;
+
+		f.weight_error = INFINITY;
+		for (int w = 0; w <= MAX_FRAC_BITS; w++) {
+			if (max_accumulator[i] * std::ldexp(1.0, bits + w) >= std::ldexp(1.0, 30))
+				break;
+			double e = weight_error(layer, fm, i, w);
+			if (e < f.weight_error) {
+				f.weight_error = e;
+				f.weight_bits = w;
+			}
+		}
+		f.output_error = INFINITY;
+		for (int o = 0; o <= std::min(MAX_FRAC_BITS, bits + f.weight_bits); o++) {
+			double e = histograms[i].error(o);
+			if (e < f.output_error) {
+				f.output_error = e;
+				f.output_bits = o;
+			}
+		}
+		bits = f.output_bits;
+	}
+
+	// Rescaled int16 model
+	engine::OwnedModel calibrated(model);
+	for (size_t i = 0; i < L; i++) {
+		engine::Layer &layer = calibrated.get().layers[i];
+		if (!layer.has_weights())
+			continue;
+		const LayerFormat &f = formats[i];
+		for (auto &w : calibrated.kernel(i))
+			w = engine::clamp_to_number_t(std::lround(std::ldexp((double)w, f.weight_bits - model.fixed_point)));
+		for (auto &b : calibrated.bias(i))
+			b = engine::clamp_to_number_t(std::lround(std::ldexp((double)b, f.output_bits - model.fixed_point)));
+		layer.shift = f.input_bits + f.weight_bits - f.output_bits;
+	}
+	calibrated.update();
+	const engine::Model &cm = calibrated.get();
+
+	// Evaluation
+	auto inputs = dataset::load_inputs(model, inputs_file, clips);
+	dataset::Rows labels;
+	if (!labels_file.empty())
+		labels = dataset::read_csv(labels_file);
+	engine::ReferenceBackend reference;
+	std::vector<size_t> saturated(L, 0), saturated_calibrated(L, 0);
+	size_t right[3] = {}, agree_float[2] = {};
+	for (size_t n = 0; n < inputs.size(); n++) {
+		size_t classes[3];
+		for (int m = 0; m < 2; m++) {
+			const engine::Model &model_m = m ? cm : model;
+			engine::Engine runner(model_m, reference);
+			std::vector<number_t> in = inputs[n], out;
+			for (size_t i = 0; i < L; i++) {
+				out.assign(model_m.layers[i].output_size(), 0);
+				runner.run_layer(i, in.data(), out.data());
+				if (model_m.layers[i].has_weights())
+					for (number_t v : out)
+						(m ? saturated_calibrated : saturated)[i] += v == engine::NUMBER_T_MAX || v == engine::NUMBER_T_MIN;
+				in.swap(out);
+			}
+			classes[m] = top1(in);
+		}
+		std::vector<float> in(inputs[n].size()), out;
+		for (size_t k = 0; k < in.size(); k++)
+			in[k] = fm.input_value(inputs[n][k]);
+		for (size_t i = 0; i < L; i++) {
+			out.assign(model.layers[i].output_size(), 0);
+			engine::float_reference::run_layer(fm, i, in.data(), out.data());
+			in.swap(out);
+		}
+		classes[2] = std::max_element(in.begin(), in.end()) - in.begin();
+		for (int m = 0; m < 2; m++)
+			agree_float[m] += classes[m] == classes[2];
+		if (n < labels.size())
+			for (int m = 0; m < 3; m++)
+				right[m] += dataset::label_class(labels[n]) == classes[m];
+	}
+
+	std::cout << model.name << ": calibrated on " << calibration_clips << (calibration_file.empty() ? " synthetic" : "")
+		<< " clips, evaluated on " << inputs.size() << (inputs_file.empty() ? " synthetic" : "") << " clips" << std::endl;
+	std::cout << std::left << std::setw(20) << "layer" << std::right << std::setw(8) << "in" << std::setw(8) << "weight"
+		<< std::setw(8) << "out" << std::setw(7) << "shift" << std::setw(12) << "max |out|"
+		<< std::setw(13) << "rms error" << std::setw(13) << "(Q6.9)" << std::setw(11) << "sat Q6.9" << std::setw(11) << "sat new" << std::endl;
+	for (size_t i = 0; i < L; i++) {
+		const engine::Layer &layer = model.layers[i];
+		if (!layer.has_weights())
+			continue;
+		const LayerFormat &f = formats[i];
+		const double outputs = (double)layer.output_size() * inputs.size();
+		std::cout << std::left << std::setw(20) << layer.name << std::right << std::setw(8) << f.input_bits
+			<< std::setw(8) << f.weight_bits << std::setw(8) << f.output_bits << std::setw(7) << cm.layers[i].shift
+			<< std::setw(12) << std::setprecision(4) << histograms[i].max
+			<< std::scientific << std::setprecision(2) << std::setw(13) << std::sqrt(f.output_error)
+			<< std::setw(13) << std::sqrt(histograms[i].error(model.fixed_point)) << std::fixed << std::setprecision(4)
+			<< std::setw(11) << saturated[i] / outputs << std::setw(11) << saturated_calibrated[i] / outputs << std::endl;
+	}
+
+	auto rate = [&](size_t count) {
+		std::ostringstream s;
+		s << std::fixed << std::setprecision(3) << count / (double)inputs.size();
+		return s.str();
+	};
+	if (!labels.empty())
+		std::cout << "Accuracy: float " << rate(right[2]) << ", Q6.9 " << rate(right[0]) << ", calibrated " << rate(right[1]) << std::endl;
+	std::cout << "Top-1 agreement with float: Q6.9 " << rate(agree_float[0]) << ", calibrated " << rate(agree_float[1]) << std::endl;
+
+	if (!output_dir.empty()) {
+		generated_sources::write_model(sources, output_dir, cm);
+		std::cout << "Generated sources written to " << output_dir << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,206 @@
+// Clusters the int16 weights of a model variant to codebooks of 2, 4 or 16 levels
+// (engine/codebook.h) and reports, per level count, the top-1 agreement with the
+// unclustered model, the RMS error of the model outputs relative to theirs, the
+// largest relative RMS weight error of a layer, the flash size of the weights
+// stored as codebooks + packed indices against int16, the multiplications of the
+// codebook kernels against the MACs of the dense kernels, and the latency per clip.
+//
+// Each filter gets its own codebook (1-D k-means), or each layer with
+// --scope=layer; the layers listed in --keep stay int16, biases always do. The
+// codebook kernels are checked bit-exact against the reference kernels on the
+// clustered weights. Agreement is the quality measure: with --labels, accuracy is
+// added as in main.cpp, which only means something on the real test set.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -o codebook_eval tools/codebook_eval.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../engine/backends.h"
+#include "../engine/codebook.h"
+#include "../engine/owned_model.h"
+#include "../engine/variants.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+static size_t top1(const std::vector<number_t> &output) {
+	return std::max_element(output.begin(), output.end()) - output.begin();
+}
+
+int main(int argc, const char *argv[]) {
+	std::string variant_name = "fine-tuning", inputs_file, labels_file;
+	std::vector<size_t> levels = { 2, 4, 16 };
+	std::vector<std::string> keep;
+	engine::codebook::Scope scope = engine::codebook::Scope::Filter;
+	size_t clips = 64;
+	bool usage = false;
+
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 10, "--variant=") == 0)
+			variant_name = arg.substr(10);
+		else if (arg.compare(0, 9, "--inputs=") == 0)
+			inputs_file = arg.substr(9);
+		else if (arg.compare(0, 9, "--labels=") == 0)
+			labels_file = arg.substr(9);
+		else if (arg.compare(0, 8, "--clips=") == 0 && atoi(arg.c_str() + 8) > 0)
+			clips = atoi(arg.c_str() + 8);
+		else if (arg.compare(0, 9, "--levels=") == 0) {
+			levels.clear();
+			std::istringstream list(arg.substr(9));
+			std::string level;
+			while (std::getline(list, level, ',')) {
+				const int n = atoi(level.c_str());
+				usage = usage || n < 1 || n > (int)engine::codebook::MAX_LEVELS;
+				levels.push_back(n);
+			}
+			usage = usage || levels.empty();
+		} else if (arg == "--scope=filter" || arg == "--scope=layer")
+			scope = arg == "--scope=layer" ? engine::codebook::Scope::Layer : engine::codebook::Scope::Filter;
+		else if (arg.compare(0, 7, "--keep=") == 0) {
+			std::istringstream list(arg.substr(7));
+			std::string name;
+			while (std::getline(list, name, ','))
+				keep.push_back(name);
+		} else
+			usage = true;
+	}
+	if (usage || inputs_file.empty() != labels_file.empty()) {
+		std::cerr << "Usage: " << argv[0] << " [--variant=NAME] [--levels=2,4,16] [--scope=filter|layer] [--keep=LAYER,...]" << std::endl
+			<< "       [--inputs=x_test.csv --labels=y_test.csv | --clips=N]" << std::endl;
+		exit(1);
+	}
+
+	const variants::Variant &variant = variants::find(variant_name);
+	const engine::Model model = variant.describe();
+	for (const auto &name : keep) {
+		auto layer = std::find_if(model.layers.begin(), model.layers.end(), [&](const engine::Layer &l) { return l.name == name; });
+		if (layer == model.layers.end() || !layer->has_weights())
+			engine::fatal(variant_name + ": no conv1d/dense layer " + name);
+	}
+	auto inputs = dataset::load_inputs(model, inputs_file, clips);
+	dataset::Rows labels;
+	if (!labels_file.empty())
+		labels = dataset::read_csv(labels_file);
+
+	// Unclustered top-1 classes, accuracy and cost
+	std::vector<size_t> baseline;
+	std::vector<std::vector<number_t>> baseline_outputs;
+	size_t baseline_right = 0, dense_bytes = 0, macs = 0;
+	{
+		engine::ReferenceBackend reference;
+		reference.prepare(model);
+		engine::Engine runner(model, reference);
+		std::vector<number_t> output(model.output_size());
+		for (size_t n = 0; n < inputs.size(); n++) {
+			runner.run(inputs[n].data(), output.data());
+			baseline.push_back(top1(output));
+			baseline_outputs.push_back(output);
+			if (n < labels.size())
+				baseline_right += dataset::label_class(labels[n]) == baseline.back();
+		}
+		for (const auto &layer : model.layers) {
+			if (!layer.has_weights())
+				continue;
+			dense_bytes += (layer.weight_count() + layer.filters) * sizeof(number_t);
+			macs += layer.weight_count() * layer.out_samples;
+		}
+	}
+
+	std::cout << variant.name << ", " << (scope == engine::codebook::Scope::Filter ? "per-filter" : "per-layer") << " codebooks";
+	for (const auto &name : keep)
+		std::cout << (&name == &keep[0] ? ", int16 " : ",") << name;
+	std::cout << ", " << inputs.size() << (inputs_file.empty() ? " synthetic" : "") << " clips" << std::endl;
+	const bool accuracy = !labels.empty();
+	std::cout << std::right << std::setw(8) << "levels" << std::setw(6) << "bits" << std::setw(11) << "agreement";
+	if (accuracy)
+		std::cout << std::setw(10) << "accuracy";
+	std::cout << std::setw(12) << "output err" << std::setw(12) << "weight err" << std::setw(9) << "bytes" << std::setw(8) << "ratio" << std::setw(12) << "multiplies"
+		<< std::setw(8) << "of MACs" << std::setw(9) << "ref us" << std::setw(13) << "codebook us" << std::setw(7) << "exact" << std::endl;
+
+	std::cout << std::setw(8) << "int16" << std::setw(6) << 16 << std::setw(11) << "1.000";
+	if (accuracy)
+		std::cout << std::fixed << std::setprecision(3) << std::setw(10) << baseline_right / (double)inputs.size();
+	std::cout << std::setw(12) << "-" << std::setw(12) << "-" << std::setw(9) << dense_bytes << std::setw(8) << "1.00" << std::setw(12) << macs
+		<< std::setw(8) << "1.00" << std::setw(9) << "-" << std::setw(13) << "-" << std::setw(7) << "-" << std::endl;
+
+	for (size_t level : levels) {
+		const uint32_t bits = engine::codebook::index_bits(level);
+		engine::OwnedModel clustered(model);
+		double weight_error = 0;
+		for (size_t l = 0; l < model.layers.size(); l++) {
+			const engine::Layer &layer = model.layers[l];
+			if (!layer.has_weights() || std::find(keep.begin(), keep.end(), layer.name) != keep.end())
+				continue;
+			number_t *kernel = clustered.kernel(l).data();
+			engine::codebook::cluster_kernel(kernel, layer.filters, layer.channels * layer.kernel_size, level, scope);
+			weight_error = std::max(weight_error, engine::codebook::relative_rms_error(layer.kernel, kernel, layer.weight_count()));
+		}
+		clustered.update();
+		const engine::Model &m = clustered.get();
+
+		engine::ReferenceBackend reference;
+		engine::CodebookBackend codebook(bits, scope, keep);
+		reference.prepare(m);
+		codebook.prepare(m);
+		engine::Engine reference_runner(m, reference), codebook_runner(m, codebook);
+
+		size_t bytes = 0, multiplies = 0;
+		for (size_t l = 0; l < m.layers.size(); l++) {
+			const engine::Layer &layer = m.layers[l];
+			if (!layer.has_weights())
+				continue;
+			if (codebook.is_clustered(l)) {
+				bytes += codebook.weights(l).flash_bytes() + layer.filters * sizeof(number_t);
+				multiplies += engine::codebook::multiplies(layer, codebook.weights(l));
+			} else {
+				bytes += (layer.weight_count() + layer.filters) * sizeof(number_t);
+				multiplies += layer.weight_count() * layer.out_samples;
+			}
+		}
+
+		size_t right = 0, agree = 0;
+		double output_error = 0, output_energy = 0;
+		bool exact = true;
+		double reference_us = 0, codebook_us = 0;
+		std::vector<number_t> out_reference(m.output_size()), out_codebook(m.output_size());
+		for (size_t n = 0; n < inputs.size(); n++) {
+			auto t0 = std::chrono::steady_clock::now();
+			reference_runner.run(inputs[n].data(), out_reference.data());
+			auto t1 = std::chrono::steady_clock::now();
+			codebook_runner.run(inputs[n].data(), out_codebook.data());
+			auto t2 = std::chrono::steady_clock::now();
+			reference_us += std::chrono::duration<double, std::micro>(t1 - t0).count();
+			codebook_us += std::chrono::duration<double, std::micro>(t2 - t1).count();
+
+			exact = exact && out_reference == out_codebook;
+			size_t cls = top1(out_codebook);
+			agree += cls == baseline[n];
+			for (size_t k = 0; k < m.output_size(); k++) {
+				const double d = out_codebook[k] - baseline_outputs[n][k];
+				output_error += d * d;
+				output_energy += (double)baseline_outputs[n][k] * baseline_outputs[n][k];
+			}
+			if (n < labels.size())
+				right += dataset::label_class(labels[n]) == cls;
+		}
+
+		std::cout << std::fixed << std::setw(8) << level << std::setw(6) << bits << std::setprecision(3)
+			<< std::setw(11) << agree / (double)inputs.size();
+		if (accuracy)
+			std::cout << std::setw(10) << right / (double)inputs.size();
+		std::cout << std::setw(12) << (output_energy > 0 ? std::sqrt(output_error / output_energy) : 0.0)
+			<< std::setw(12) << weight_error << std::setw(9) << bytes
+			<< std::setprecision(2) << std::setw(8) << bytes / (double)dense_bytes << std::setw(12) << multiplies
+			<< std::setw(8) << multiplies / (double)macs << std::setprecision(1) << std::setw(9) << reference_us / inputs.size()
+			<< std::setw(13) << codebook_us / inputs.size() << std::setw(7) << (exact ? "yes" : "NO") << std::endl;
+	}
+	return 0;
+}
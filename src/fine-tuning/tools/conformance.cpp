@@ -0,0 +1,237 @@
+// Bit-exactness conformance of every engine backend against the generated MicroAI
+// code, on all model variants.
+//
+// Two levels of checks, each over the same input cases (silence, all-min,
+// all-max, alternating signs, uniform random and quiet random values):
+//  - layer: every conv1d, pooling and dense layer of a backend is run on a case
+//    input and compared with the generated layer function. Inputs are limited per
+//    channel to the values the previous layers can produce (range.h), so
+//    backends relying on the range analysis (narrow) are held to their contract.
+//  - model: the backend's Engine::run is compared with the generated cnn() on the
+//    case inputs (at full int16 scale) and on real or synthetic clips. A mismatch
+//    is replayed layer by layer against the generated layer functions to find the
+//    first layer that diverges.
+// The narrow backend is also checked with smaller input bounds, where it runs
+// layers with 16-bit accumulators: its case inputs and clips are then limited to
+// the bound. The first mismatch of each backend is reported with its layer,
+// channel and column (output sample); the exit status is 1 if any backend fails.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -o conformance tools/conformance.cpp
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../engine/backends.h"
+#include "../engine/range.h"
+#include "../engine/variants.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+static const char *const CASES[] = { "silence", "all-min", "all-max", "alternating", "random", "quiet" };
+
+// Case input of size values, value n within bounds[n / samples]
+static std::vector<number_t> make_case(const std::string &name, const std::vector<engine::Interval> &bounds,
+		size_t samples, size_t size, std::mt19937 &rng) {
+	std::vector<number_t> values(size);
+	for (size_t n = 0; n < size; n++) {
+		const engine::Interval &b = bounds[n / samples];
+		int64_t v = 0;
+		if (name == "all-min")
+			v = b.lo;
+		else if (name == "all-max")
+			v = b.hi;
+		else if (name == "alternating")
+			v = n % 2 ? b.lo : b.hi;
+		else if (name == "random")
+			v = std::uniform_int_distribution<int64_t>(b.lo, b.hi)(rng);
+		else if (name == "quiet")
+			v = std::uniform_int_distribution<int64_t>(std::max<int64_t>(b.lo, -512), std::min<int64_t>(b.hi, 512))(rng);
+		values[n] = (number_t)std::max(b.lo, std::min(b.hi, v));
+	}
+	return values;
+}
+
+// Index of the first differing value, or size
+static size_t first_mismatch(const std::vector<number_t> &expected, const std::vector<number_t> &actual) {
+	size_t n = 0;
+	while (n < expected.size() && expected[n] == actual[n])
+		n++;
+	return n;
+}
+
+// Bounds of the model input for the narrow backend, besides the full int16 range
+static const int64_t NARROW_BOUNDS[] = { 1, 4, 16 };
+
+struct Failure {
+	bool failed = false;
+	std::string message;
+
+	void record(const std::string &what, const engine::Layer &layer, size_t n,
+			const std::vector<number_t> &expected, const std::vector<number_t> &actual) {
+		if (failed)
+			return;
+		failed = true;
+		std::ostringstream s;
+		s << what << ": layer " << layer.name << ", channel " << n / layer.out_samples << ", column " << n % layer.out_samples
+			<< ": expected " << expected[n] << ", got " << actual[n];
+		message = s.str();
+	}
+};
+
+// Backend under test, with the bound of the model inputs it is checked on
+struct Candidate {
+	std::unique_ptr<engine::Backend> backend;
+	std::string name;
+	int64_t input_bound;
+};
+
+// Named model-level inputs and the generated cnn() outputs for them
+struct ModelInputs {
+	std::vector<std::pair<std::string, std::vector<number_t>>> inputs;
+	std::vector<std::vector<number_t>> expected;
+};
+
+// Replays input layer by layer, both runners on the generated output of the
+// previous layer; records the first layer whose outputs differ
+static bool replay(const engine::Model &model, engine::Engine &expected_runner, engine::Engine &runner,
+		const std::vector<number_t> &input, const std::string &what, Failure &failure) {
+	std::vector<number_t> in = input, expected, actual;
+	for (size_t i = 0; i < model.layers.size(); i++) {
+		const engine::Layer &layer = model.layers[i];
+		expected.assign(layer.output_size(), 0);
+		actual.assign(layer.output_size(), 0);
+		expected_runner.run_layer(i, in.data(), expected.data());
+		runner.run_layer(i, in.data(), actual.data());
+		size_t n = first_mismatch(expected, actual);
+		if (n < expected.size()) {
+			failure.record(what, layer, n, expected, actual);
+			return true;
+		}
+		in.swap(expected);
+	}
+	return false;
+}
+
+int main(int argc, const char *argv[]) {
+	std::string inputs_file, only;
+	size_t clips = 8;
+	for (int i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "--inputs=", 9))
+			inputs_file = argv[i] + 9;
+		else if (!strncmp(argv[i], "--clips=", 8) && atoi(argv[i] + 8) > 0)
+			clips = atoi(argv[i] + 8);
+		else if (!strncmp(argv[i], "--variant=", 10))
+			only = argv[i] + 10;
+		else {
+			std::cerr << "Usage: " << argv[0] << " [--inputs=x_test.csv | --clips=N] [--variant=NAME]" << std::endl;
+			std::cerr << "Without --inputs, N synthetic clips are used (default 8)" << std::endl;
+			exit(1);
+		}
+	}
+
+	bool all_passed = true;
+	for (const auto &variant : variants::all()) {
+		if (!only.empty() && only != variant.name)
+			continue;
+		const engine::Model model = variant.describe();
+
+		engine::GeneratedBackend generated;
+		generated.prepare(model);
+		engine::Engine expected_runner(model, generated);
+
+		// Every registry backend but the generated one, the sparse and Winograd kernels on
+		// every call, and narrow on smaller inputs
+		const int64_t full_bound = -engine::NUMBER_T_MIN;
+		std::vector<Candidate> candidates;
+		for (const auto &name : engine::backend_names())
+			if (name != "generated")
+				candidates.push_back({ engine::make_backend(name), name, full_bound });
+		candidates.push_back({ std::unique_ptr<engine::Backend>(new engine::SparseBackend(2)), "sparse (always)", full_bound });
+		candidates.push_back({ std::unique_ptr<engine::Backend>(new engine::WinogradBackend(true)), "winograd (always)", full_bound });
+		for (int64_t bound : NARROW_BOUNDS)
+			candidates.push_back({ std::unique_ptr<engine::Backend>(new engine::NarrowBackend(bound)),
+				"narrow (inputs within +-" + std::to_string(bound) + ")", bound });
+
+		// Model-level inputs per bound: the cases, then the clips limited to the bound
+		// (CSV clips are language clips only)
+		std::mt19937 rng(0);
+		std::map<int64_t, ModelInputs> model_inputs;
+		for (const auto &candidate : candidates) {
+			if (model_inputs.count(candidate.input_bound))
+				continue;
+			ModelInputs &m = model_inputs[candidate.input_bound];
+			const engine::Interval bound = engine::input_interval(candidate.input_bound);
+			const std::vector<engine::Interval> bounds(model.input_channels, bound);
+			for (const char *name : CASES)
+				m.inputs.emplace_back(name, make_case(name, bounds, model.input_samples, model.input_size(), rng));
+			if (inputs_file.empty() || variant.language) {
+				auto inputs = dataset::load_inputs(model, inputs_file, clips);
+				for (size_t n = 0; n < inputs.size(); n++) {
+					for (number_t &v : inputs[n])
+						v = (number_t)std::max(bound.lo, std::min(bound.hi, (int64_t)v));
+					m.inputs.emplace_back("clip " + std::to_string(n), inputs[n]);
+				}
+			}
+			for (const auto &input : m.inputs) {
+				std::vector<number_t> out(model.output_size());
+				variant.cnn(input.second.data(), out.data());
+				m.expected.push_back(out);
+			}
+		}
+
+		std::cout << variant.name << std::endl;
+		for (auto &candidate : candidates) {
+			engine::Backend &backend = *candidate.backend;
+			backend.prepare(model);
+			engine::Engine runner(model, backend);
+			const std::vector<engine::LayerRange> ranges = analyze_ranges(model, engine::input_interval(candidate.input_bound));
+			const ModelInputs &m = model_inputs.at(candidate.input_bound);
+			Failure failure;
+			size_t checks = 0;
+
+			for (size_t i = 0; i < model.layers.size() && !failure.failed; i++) {
+				const engine::Layer &layer = model.layers[i];
+				if (layer.kind == engine::LayerKind::Flatten)
+					continue;
+				for (const char *name : CASES) {
+					std::vector<number_t> input = make_case(name, ranges[i].input, layer.samples, layer.input_size(), rng);
+					std::vector<number_t> expected(layer.output_size()), actual(layer.output_size());
+					expected_runner.run_layer(i, input.data(), expected.data());
+					runner.run_layer(i, input.data(), actual.data());
+					checks++;
+					size_t n = first_mismatch(expected, actual);
+					if (n < expected.size()) {
+						failure.record(std::string("layer case ") + name, layer, n, expected, actual);
+						break;
+					}
+				}
+			}
+
+			for (size_t k = 0; k < m.inputs.size() && !failure.failed; k++) {
+				std::vector<number_t> actual(model.output_size());
+				runner.run(m.inputs[k].second.data(), actual.data());
+				checks++;
+				size_t n = first_mismatch(m.expected[k], actual);
+				const std::string what = "model input " + m.inputs[k].first;
+				if (n < actual.size() && !replay(model, expected_runner, runner, m.inputs[k].second, what, failure))
+					failure.record(what + " (no layer differs on replay)", model.layers.back(), n, m.expected[k], actual);
+			}
+
+			std::string name = candidate.name;
+			if (const auto *narrow = dynamic_cast<const engine::NarrowBackend *>(&backend))
+				name += ", " + std::to_string(std::count(narrow->narrow_layers().begin(), narrow->narrow_layers().end(), true))
+					+ " 16-bit layers";
+			all_passed = all_passed && !failure.failed;
+			std::cout << "  " << name << ": " << (failure.failed ? "FAIL, " + failure.message : "pass (" + std::to_string(checks) + " checks)") << std::endl;
+		}
+	}
+	return all_passed ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+// Test clips for the tools: the CSV files read by main.cpp, or synthetic audio.
+//
+// CSV rows hold one clip as [samples][channels] floats; like main.cpp, they are
+// converted to [channels][samples] number_t with the model's fixed point.
+// Synthetic clips mix tones and noise at loudness levels from near silence to
+// full scale, so activation statistics cover both quiet and loud inputs.
+
+#ifndef __TOOLS_DATASET_H__
+#define __TOOLS_DATASET_H__
+
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../engine/kernels.h"
+#include "../engine/trace.h"
+
+namespace dataset {
+
+typedef std::vector<std::vector<float>> Rows;
+
+inline Rows read_csv(const std::string &filename) {
+	Rows rows;
+	std::ifstream fin(filename);
+	if (!fin)
+		engine::fatal("opening \"" + filename + "\": " + strerror(errno));
+	std::string linestr;
+	while (std::getline(fin, linestr)) {
+		std::istringstream linestrs(linestr);
+		std::string floatstr;
+		std::vector<float> floats;
+		while (std::getline(linestrs, floatstr, ','))
+			floats.push_back(std::strtof(floatstr.c_str(), NULL));
+		rows.push_back(floats);
+	}
+	return rows;
+}
+
+// Same conversion as convert_input_vector() in main.cpp
+inline std::vector<engine::number_t> convert_input(const engine::Model &model, const std::vector<float> &row) {
+	const size_t C = model.input_channels, S = model.input_samples;
+	if (row.size() != C * S)
+		engine::fatal("input row of " + std::to_string(row.size()) + " values, " + model.name
+				+ " expects " + std::to_string(C * S));
+	std::vector<engine::number_t> out(C * S);
+	for (size_t i = 0; i < C; i++)
+		for (size_t j = 0; j < S; j++)
+			out[i * S + j] = engine::clamp_to_number_t((engine::long_number_t)(row[j * C + i] * (1 << model.fixed_point)));
+	return out;
+}
+
+// count clips of channels * samples floats in [-1, 1], loudness spread log-uniformly
+inline Rows synthetic(size_t channels, size_t samples, size_t count, unsigned seed = 0) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0, 1);
+	std::normal_distribution<float> noise(0, 1);
+	Rows rows(count, std::vector<float>(channels * samples));
+
+	for (size_t n = 0; n < count; n++) {
+		float loudness = std::pow(10.f, -3.f * unit(rng));	// -60 dB to 0 dB
+		float f1 = 80 + 900 * unit(rng), f2 = 300 + 3000 * unit(rng);
+		for (size_t j = 0; j < samples; j++) {
+			float t = j / 16000.f;
+			float envelope = 0.5f - 0.5f * std::cos(2 * (float)M_PI * 3 * t);
+			float tone = 0.6f * std::sin(2 * (float)M_PI * f1 * t) + 0.3f * std::sin(2 * (float)M_PI * f2 * t);
+			float v = loudness * (envelope * tone + 0.1f * noise(rng));
+			for (size_t i = 0; i < channels; i++)
+				rows[n][j * channels + i] = std::max(-1.f, std::min(1.f, v));
+		}
+	}
+	return rows;
+}
+
+// Converted clips from a CSV file, or count synthetic ones when filename is empty
+inline std::vector<std::vector<engine::number_t>> load_inputs(const engine::Model &model, const std::string &filename,
+		size_t count, unsigned seed = 0) {
+	Rows rows = filename.empty() ? synthetic(model.input_channels, model.input_samples, count, seed) : read_csv(filename);
+	std::vector<std::vector<engine::number_t>> inputs;
+	for (const auto &row : rows)
+		inputs.push_back(convert_input(model, row));
+	return inputs;
+}
+
+// Clips read one at a time, for corpora too large to load: rows of a CSV file, or
+// count synthetic clips when filename is empty. next() may be called from several
+// threads; each clip is handed out once.
+class Stream {
+public:
+	Stream(const engine::Model &model, const std::string &filename, size_t count, unsigned seed = 0)
+		: model(model), count(filename.empty() ? count : SIZE_MAX), seed(seed) {
+		if (!filename.empty()) {
+			fin.open(filename);
+			if (!fin)
+				engine::fatal("opening \"" + filename + "\": " + strerror(errno));
+		}
+	}
+
+	bool next(std::vector<engine::number_t> &clip) {
+		std::vector<float> row;
+		size_t index;
+		{
+			engine::trace::Scope span("decode", "input");
+			std::lock_guard<std::mutex> lock(mutex);
+			if (read >= count)
+				return false;
+			if (fin.is_open()) {
+				std::string linestr;
+				if (!std::getline(fin, linestr))
+					return false;
+				std::istringstream linestrs(linestr);
+				std::string floatstr;
+				while (std::getline(linestrs, floatstr, ','))
+					row.push_back(std::strtof(floatstr.c_str(), NULL));
+			}
+			index = read++;
+		}
+		if (!fin.is_open())
+			row = synthetic(model.input_channels, model.input_samples, 1, seed + index)[0];
+		engine::trace::Scope span("convert_input", "input");
+		clip = convert_input(model, row);
+		return true;
+	}
+
+private:
+	const engine::Model &model;
+	std::ifstream fin;
+	std::mutex mutex;
+	size_t count;
+	size_t read = 0;
+	unsigned seed;
+};
+
+// Index of the 1 in a one-hot label row
+inline size_t label_class(const std::vector<float> &label) {
+	for (size_t i = 0; i < label.size(); i++)
+		if (label[i] > 0)
+			return i;
+	return label.size();
+}
+
+} // namespace dataset
+
+#endif // __TOOLS_DATASET_H__
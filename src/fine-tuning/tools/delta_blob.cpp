@@ -0,0 +1,197 @@
+// Flash saving and latency cost of storing variants as deltas against a base
+// blob (engine/weight_delta.h) instead of full weight blobs.
+//
+// Every variant with the layer shapes, shifts and ReLUs of the base (a delta runs
+// with those of the base) is encoded against it. For each, the delta is checked to
+// give the same outputs as cnn() through DeltaBackend on synthetic clips, and the
+// tool reports its size against the full blob, the host time per clip of the
+// decode alone and of the reference engine with and without it, and the decode
+// cycles on a Cortex-M4 (engine/m4_cost.h) against the estimated latency of the
+// generated model. --variant shows the encoding of every layer;
+// --output writes the base blob and the deltas.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O2 -o delta_blob tools/delta_blob.cpp
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../engine/delta_model.h"
+#include "../engine/m4_cost.h"
+#include "../engine/variants.h"
+#include "bench.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+static std::string fixed(double v, int precision) {
+	std::ostringstream s;
+	s << std::fixed << std::setprecision(precision) << v;
+	return s.str();
+}
+
+static const char *encoding_name(uint32_t encoding) {
+	switch (encoding) {
+	case engine::blob::SAME: return "same";
+	case engine::blob::PACKED: return "packed";
+	case engine::blob::MASKED: return "masked";
+	}
+	return "?";
+}
+
+static bool same_layers(const engine::Model &a, const engine::Model &b) {
+	if (a.layers.size() != b.layers.size() || a.input_size() != b.input_size())
+		return false;
+	for (size_t i = 0; i < a.layers.size(); i++) {
+		const engine::Layer &x = a.layers[i], &y = b.layers[i];
+		if (x.kind != y.kind || x.channels != y.channels || x.samples != y.samples || x.filters != y.filters
+				|| x.kernel_size != y.kernel_size || x.stride != y.stride || x.out_samples != y.out_samples
+				|| x.shift != y.shift || x.relu != y.relu)
+			return false;
+	}
+	return true;
+}
+
+// Cortex-M4 cycles to decode every layer of the delta once
+static double m4_decode_cycles(const engine::blob::DeltaView &delta, const engine::m4::CycleCosts &costs) {
+	double cycles = 0;
+	for (uint32_t i = 0; i < delta.layers(); i++) {
+		const engine::blob::DeltaEntry &e = delta.layer(i);
+		if (e.encoding == engine::blob::SAME)
+			continue;	// The kernels read the base in place
+		const bool masked = e.encoding == engine::blob::MASKED;
+		cycles += costs.cycles(engine::m4::unpack(e.count, masked ? e.nonzero : e.count, e.bits, masked, true, costs));
+	}
+	return cycles;
+}
+
+static void write_file(const std::string &filename, const std::vector<uint8_t> &data) {
+	std::ofstream fout(filename, std::ios::binary);
+	if (!fout)
+		engine::fatal("cannot write \"" + filename + "\"");
+	fout.write((const char *)data.data(), data.size());
+}
+
+int main(int argc, const char *argv[]) {
+	std::string base_name = "full-data-pre-trained-0.6", only, output;
+	size_t clips = 8, repetitions = 5;
+	bool usage = false;
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 7, "--base=") == 0)
+			base_name = arg.substr(7);
+		else if (arg.compare(0, 10, "--variant=") == 0)
+			only = arg.substr(10);
+		else if (arg.compare(0, 8, "--clips=") == 0)
+			usage = (clips = atoi(arg.c_str() + 8)) == 0;
+		else if (arg.compare(0, 14, "--repetitions=") == 0)
+			usage = (repetitions = atoi(arg.c_str() + 14)) == 0;
+		else if (arg.compare(0, 9, "--output=") == 0)
+			output = arg.substr(9);
+		else
+			usage = true;
+	}
+	if (usage) {
+		std::cerr << "Usage: " << argv[0] << " [--base=full-data-pre-trained-0.6] [--variant=NAME] [--clips=N] [--repetitions=N] [--output=DIR]" << std::endl;
+		exit(1);
+	}
+
+	const variants::Variant &base_variant = variants::find(base_name);
+	const engine::Model base_model = base_variant.describe();
+	const std::vector<uint8_t> base_data = engine::blob::encode(base_model);
+	engine::blob::View base;
+	engine::blob::Status status = base.open(base_data.data(), base_data.size());
+	if (status != engine::blob::Status::OK)
+		engine::fatal(base_name + ": " + engine::blob::status_name(status));
+	const engine::Model shapes = engine::blob::blob_model(base);
+	if (!output.empty())
+		write_file(output + "/" + base_name + ".bin", base_data);
+
+	engine::m4::CycleCosts costs;
+	const double m4_model_cycles = engine::m4::total_cycles(
+		engine::m4::estimate(base_model, engine::m4::Implementation::Generated, costs));
+	const auto inputs = dataset::load_inputs(base_model, "", clips);
+
+	std::cout << "Base " << base_name << ": " << base_data.size() << " bytes; Cortex-M4 at " << costs.mhz
+		<< " MHz, generated model " << fixed(m4_model_cycles / (costs.mhz * 1e3), 1) << " ms" << std::endl;
+	std::cout << std::left << std::setw(28) << "variant" << std::right << std::setw(8) << "full B" << std::setw(9) << "delta B"
+		<< std::setw(7) << "ratio" << std::setw(10) << "decode us" << std::setw(9) << "ref ms" << std::setw(10) << "delta ms"
+		<< std::setw(8) << "added" << std::setw(11) << "M4 decode" << std::setw(8) << "added" << std::endl;
+
+	size_t full_total = base_data.size(), stored_total = base_data.size(), count = 1;
+	for (const auto &variant : variants::all()) {
+		const engine::Model model = variant.describe();
+		if (variant.name == base_name || (!only.empty() && only != variant.name) || !same_layers(model, base_model))
+			continue;
+		const std::vector<uint8_t> delta_data = engine::blob::encode_delta(base, model);
+		engine::blob::DeltaView delta;
+		status = delta.open(delta_data.data(), delta_data.size(), base);
+		if (status != engine::blob::Status::OK)
+			engine::fatal(std::string(variant.name) + ": " + engine::blob::status_name(status));
+		if (!output.empty())
+			write_file(output + "/" + variant.name + ".delta", delta_data);
+
+		engine::blob::DeltaBackend delta_backend(delta);
+		delta_backend.prepare(shapes);
+		engine::Engine delta_runner(shapes, delta_backend);
+		engine::ReferenceBackend reference;
+		reference.prepare(model);
+		engine::Engine reference_runner(model, reference);
+		std::vector<number_t> expected(model.output_size()), result(model.output_size());
+		for (const auto &clip : inputs) {
+			variant.cnn(clip.data(), expected.data());
+			delta_runner.run(clip.data(), result.data());
+			if (result != expected)
+				engine::fatal(std::string(variant.name) + ": delta model differs from cnn()");
+		}
+
+		size_t scratch_size = 0;
+		for (uint32_t i = 0; i < delta.layers(); i++)
+			scratch_size = std::max<size_t>(scratch_size, delta.layer(i).count);
+		std::vector<number_t> scratch(scratch_size);
+		const double decode_ns = bench::percentile(bench::time_samples([&]() {
+			for (uint32_t i = 0; i < delta.layers(); i++)
+				delta.decode(i, scratch.data());
+		}, repetitions), 0.5);
+		const double reference_ns = bench::percentile(bench::time_samples([&]() {
+			reference_runner.run(inputs[0].data(), result.data());
+		}, repetitions), 0.5);
+		const double delta_ns = bench::percentile(bench::time_samples([&]() {
+			delta_runner.run(inputs[0].data(), result.data());
+		}, repetitions), 0.5);
+		const double m4_decode = m4_decode_cycles(delta, costs);
+
+		const size_t full_size = engine::blob::encode(model).size();
+		full_total += full_size;
+		stored_total += delta_data.size();
+		count++;
+		std::cout << std::left << std::setw(28) << variant.name << std::right << std::setw(8) << full_size
+			<< std::setw(9) << delta_data.size() << std::setw(7) << fixed((double)delta_data.size() / full_size, 2)
+			<< std::setw(10) << fixed(decode_ns / 1e3, 1) << std::setw(9) << fixed(reference_ns / 1e6, 2)
+			<< std::setw(10) << fixed(delta_ns / 1e6, 2) << std::setw(7) << fixed(100 * (delta_ns / reference_ns - 1), 1) << "%"
+			<< std::setw(8) << fixed(m4_decode / (costs.mhz * 1e3), 2) << " ms" << std::setw(7)
+			<< fixed(100 * m4_decode / m4_model_cycles, 2) << "%" << std::endl;
+
+		if (only.empty())
+			continue;
+		std::cout << std::endl << std::left << std::setw(22) << "layer" << std::right << std::setw(8) << "values"
+			<< std::setw(10) << "encoding" << std::setw(6) << "bits" << std::setw(10) << "nonzero" << std::setw(8) << "full B"
+			<< std::setw(9) << "delta B" << std::endl;
+		for (uint32_t i = 0; i < delta.layers(); i++) {
+			const engine::blob::DeltaEntry &e = delta.layer(i);
+			if (!e.count)
+				continue;
+			std::cout << std::left << std::setw(22) << model.layers[i].name << std::right << std::setw(8) << e.count
+				<< std::setw(10) << encoding_name(e.encoding) << std::setw(6) << e.bits
+				<< std::setw(9) << fixed(100.0 * e.nonzero / e.count, 1) << "%" << std::setw(8) << e.count * sizeof(number_t)
+				<< std::setw(9) << e.size << std::endl;
+		}
+	}
+	std::cout << std::endl << count << " variants in full: " << full_total << " bytes of flash; base and "
+		<< count - 1 << " deltas: " << stored_total << " bytes (" << fixed(100 * (1 - (double)stored_total / full_total), 1)
+		<< "% less), identical to cnn() on " << clips << " clips" << std::endl;
+	return 0;
+}
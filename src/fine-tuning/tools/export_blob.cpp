@@ -0,0 +1,107 @@
+// Exports the compiled-in weights of the variants as weight blobs
+// (engine/weight_blob.h) and checks them.
+//
+// Every blob written is mapped back (engine/blob_model.h) and the Model read
+// from it is run on the reference engine against the variant's cnn() on
+// synthetic clips; any difference is fatal. --check prints the header and layer
+// table of existing blobs after validating them.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O2 -o export_blob tools/export_blob.cpp
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../engine/blob_model.h"
+#include "../engine/engine.h"
+#include "../engine/variants.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+static void print_blob(const std::string &filename) {
+	engine::blob::MappedBlob mapped(filename);
+	const engine::blob::View &view = mapped.get();
+	const engine::blob::Header &h = view.header();
+	std::cout << filename << ": " << h.model_name << ", version " << h.version << ", " << h.total_size << " bytes, crc32 "
+		<< std::hex << std::setw(8) << std::setfill('0') << h.crc32 << std::dec << std::setfill(' ') << ", input "
+		<< h.input_channels << "x" << h.input_samples << ", Q" << 15 - h.fixed_point << "." << h.fixed_point << std::endl;
+	for (uint32_t i = 0; i < view.layers(); i++) {
+		const engine::blob::LayerEntry &e = view.layer(i);
+		std::cout << "  " << std::left << std::setw(20) << e.name << std::right << std::setw(12)
+			<< engine::layer_kind_name(engine::blob::layer_kind(e.kind)) << "  " << e.channels << "x" << e.samples << " -> "
+			<< e.filters << "x" << e.out_samples;
+		if (e.has_weights())
+			std::cout << ", " << e.weight_count() << " weights at " << e.kernel_offset << ", bias at " << e.bias_offset;
+		std::cout << std::endl;
+	}
+}
+
+// Blob model on the reference engine against cnn(); number of differing outputs
+static size_t compare(const variants::Variant &variant, const engine::Model &model, size_t clips) {
+	engine::ReferenceBackend backend;
+	backend.prepare(model);
+	engine::Engine runner(model, backend);
+	std::vector<number_t> expected(model.output_size()), output(model.output_size());
+	size_t mismatches = 0;
+	for (const auto &clip : dataset::load_inputs(model, "", clips)) {
+		variant.cnn(clip.data(), expected.data());
+		runner.run(clip.data(), output.data());
+		for (size_t i = 0; i < output.size(); i++)
+			mismatches += output[i] != expected[i];
+	}
+	return mismatches;
+}
+
+int main(int argc, const char *argv[]) {
+	std::string only, output;
+	std::vector<std::string> check;
+	size_t clips = 8;
+	bool usage = false;
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 10, "--variant=") == 0)
+			only = arg.substr(10);
+		else if (arg.compare(0, 9, "--output=") == 0)
+			output = arg.substr(9);
+		else if (arg.compare(0, 8, "--clips=") == 0)
+			usage = (clips = atoi(arg.c_str() + 8)) == 0;
+		else if (arg.compare(0, 8, "--check=") == 0)
+			check.push_back(arg.substr(8));
+		else
+			usage = true;
+	}
+	if (usage || (output.empty() && check.empty())) {
+		std::cerr << "Usage: " << argv[0] << " --output=DIR | --variant=NAME --output=FILE.bin [--clips=N]" << std::endl
+			<< "       " << argv[0] << " --check=FILE.bin..." << std::endl;
+		std::cerr << "Without --variant every variant is written to DIR/NAME.bin" << std::endl;
+		exit(1);
+	}
+
+	for (const auto &filename : check)
+		print_blob(filename);
+	if (output.empty())
+		return 0;
+
+	for (const auto &variant : variants::all()) {
+		if (!only.empty() && only != variant.name)
+			continue;
+		const std::string filename = only.empty() ? output + "/" + variant.name + ".bin" : output;
+		{
+			std::ofstream fout(filename, std::ios::binary);
+			if (!fout)
+				engine::fatal("cannot write \"" + filename + "\"");
+			engine::blob::write(fout, variant.describe());
+		}
+		engine::blob::MappedBlob mapped(filename);
+		const engine::Model model = engine::blob::blob_model(mapped.get());
+		const size_t mismatches = compare(variant, model, clips);
+		if (mismatches)
+			engine::fatal(filename + ": " + std::to_string(mismatches) + " outputs differ from cnn()");
+		std::cout << filename << ": " << mapped.get().header().total_size << " bytes, " << model.weight_count()
+			<< " weights, identical to cnn() on " << clips << " clips" << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,128 @@
+// Runs model variants on the float32 engine of engine/float_engine.h and compares
+// it with the int16 models: accuracy (or top-1 agreement with int16), largest
+// deviation from the scalar float reference, and latency per clip of the int16
+// reference and GEMM engines and of the scalar and vectorised float kernels.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -march=native -o float_eval tools/float_eval.cpp
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../engine/backends.h"
+#include "../engine/float_engine.h"
+#include "../engine/variants.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+typedef std::chrono::steady_clock Clock;
+
+template<typename T>
+static size_t top1(const std::vector<T> &output) {
+	return std::max_element(output.begin(), output.end()) - output.begin();
+}
+
+template<typename Fn>
+static double elapsed_us(Fn fn) {
+	auto start = Clock::now();
+	fn();
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+int main(int argc, const char *argv[]) {
+	std::string only, inputs_file, labels_file;
+	size_t clips = 64;
+	bool usage = false;
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 10, "--variant=") == 0)
+			only = arg.substr(10);
+		else if (arg.compare(0, 9, "--inputs=") == 0)
+			inputs_file = arg.substr(9);
+		else if (arg.compare(0, 9, "--labels=") == 0)
+			labels_file = arg.substr(9);
+		else if (arg.compare(0, 8, "--clips=") == 0)
+			usage = (clips = atoi(arg.c_str() + 8)) == 0;
+		else
+			usage = true;
+	}
+	if (usage || inputs_file.empty() != labels_file.empty()) {
+		std::cerr << "Usage: " << argv[0] << " [--variant=NAME] [--inputs=x_test.csv --labels=y_test.csv | --clips=N]" << std::endl;
+		exit(1);
+	}
+	dataset::Rows labels;
+	if (!labels_file.empty())
+		labels = dataset::read_csv(labels_file);
+
+	std::cout << std::left << std::setw(28) << "variant" << std::right << std::setw(10) << "int16 acc" << std::setw(10) << "float acc"
+		<< std::setw(11) << "agreement" << std::setw(11) << "max dev" << std::setw(9) << "ref us" << std::setw(9) << "gemm us"
+		<< std::setw(11) << "float ref" << std::setw(11) << "float us" << std::endl;
+
+	for (const auto &variant : variants::all()) {
+		if (!only.empty() && only != variant.name)
+			continue;
+		if (!inputs_file.empty() && !variant.language)
+			continue;
+		const engine::Model model = variant.describe();
+
+		engine::ReferenceBackend reference;
+		engine::GemmBackend gemm;
+		gemm.prepare(model);
+		engine::Engine runner_ref(model, reference), runner_gemm(model, gemm);
+		engine::FloatEngine runner_float(model);
+		const engine::FloatModel &fm = runner_float.get_weights();
+
+		auto inputs = dataset::load_inputs(model, inputs_file, clips);
+		std::vector<number_t> out16(model.output_size());
+		std::vector<float> out_float(model.output_size()), in, out;
+		size_t right16 = 0, right_float = 0, agree = 0;
+		double us_ref = 0, us_gemm = 0, us_float_ref = 0, us_float = 0, deviation = 0;
+		for (size_t n = 0; n < inputs.size(); n++) {
+			const number_t *clip = inputs[n].data();
+			us_ref += elapsed_us([&]() { runner_ref.run(clip, out16.data()); });
+			us_gemm += elapsed_us([&]() { runner_gemm.run(clip, out16.data()); });
+			us_float += elapsed_us([&]() { runner_float.run(clip, out_float.data()); });
+
+			// Scalar float reference, layer by layer
+			us_float_ref += elapsed_us([&]() {
+				in.resize(model.input_size());
+				for (size_t k = 0; k < in.size(); k++)
+					in[k] = fm.input_value(clip[k]);
+				for (size_t i = 0; i < model.layers.size(); i++) {
+					out.resize(model.layers[i].output_size());
+					engine::float_reference::run_layer(fm, i, in.data(), out.data());
+					in.swap(out);
+				}
+			});
+			for (size_t k = 0; k < in.size(); k++)
+				deviation = std::max(deviation, (double)std::fabs(in[k] - out_float[k]) / std::max(1.f, std::fabs(in[k])));
+
+			agree += top1(out16) == top1(out_float);
+			if (n < labels.size()) {
+				right16 += dataset::label_class(labels[n]) == top1(out16);
+				right_float += dataset::label_class(labels[n]) == top1(out_float);
+			}
+		}
+
+		auto accuracy = [&](size_t right) {
+			std::ostringstream s;
+			if (labels.empty())
+				s << "-";
+			else
+				s << std::fixed << std::setprecision(3) << right / (double)inputs.size();
+			return s.str();
+		};
+		const double count = inputs.size();
+		std::cout << std::left << std::setw(28) << variant.name << std::right << std::setw(10) << accuracy(right16)
+			<< std::setw(10) << accuracy(right_float) << std::fixed << std::setprecision(3) << std::setw(11) << agree / count
+			<< std::scientific << std::setprecision(1) << std::setw(11) << deviation << std::fixed
+			<< std::setw(9) << us_ref / count << std::setw(9) << us_gemm / count
+			<< std::setw(11) << us_float_ref / count << std::setw(11) << us_float / count << std::endl;
+	}
+	return 0;
+}
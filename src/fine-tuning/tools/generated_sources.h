@@ -0,0 +1,194 @@
+// Rewrites a MicroAI-generated source directory (model.c, one .c file per layer
+// and weights/*.c, like gsc_output_fixed) for a modified Model.
+//
+// Every file is copied; in the layer files the #define lines giving channel and
+// filter counts are replaced by the model's, and weights/<layer>.c is written in
+// the generated format from the model's weights. A conv1d/dense layer whose shift
+// differs from FIXED_POINT gets it as a <LAYER>_SHIFT macro, used in place of
+// scale_number_t() and read back by the model descriptions (language_model.h).
+// Layer names, kernel sizes, strides and activations must be those of the
+// generated model.
+
+#ifndef __TOOLS_GENERATED_SOURCES_H__
+#define __TOOLS_GENERATED_SOURCES_H__
+
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "../engine/model_desc.h"
+
+namespace generated_sources {
+
+inline std::string read_file(const std::string &path) {
+	std::ifstream in(path);
+	if (!in)
+		engine::fatal("opening \"" + path + "\": " + strerror(errno));
+	std::ostringstream s;
+	s << in.rdbuf();
+	return s.str();
+}
+
+inline void write_file(const std::string &path, const std::string &contents) {
+	std::ofstream out(path);
+	if (!out || !(out << contents))
+		engine::fatal("writing \"" + path + "\": " + strerror(errno));
+}
+
+// Replaces the value of every "#define NAME value" line for the names in defines
+inline std::string replace_defines(const std::string &source, const std::map<std::string, std::string> &defines) {
+	std::istringstream in(source);
+	std::ostringstream out;
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream tokens(line);
+		std::string directive, name;
+		tokens >> directive >> name;
+		auto define = defines.find(name);
+		if (directive == "#define" && define != defines.end()) {
+			// Keep the alignment of the value
+			size_t value = line.find_first_not_of(" \t", line.find(name) + name.size());
+			line = line.substr(0, value == std::string::npos ? line.size() : value) + define->second;
+		}
+		out << line << "\n";
+	}
+	return out.str();
+}
+
+// Name of the shift macro of a layer: conv1d_1 -> CONV1D_1_SHIFT
+inline std::string shift_macro(const engine::Layer &layer) {
+	std::string name;
+	for (char c : layer.name)
+		name += (char)toupper((unsigned char)c);
+	return name + "_SHIFT";
+}
+
+// Defines or updates the shift macro of a layer file, before its first #define
+inline std::string set_shift(const std::string &source, const engine::Layer &layer) {
+	const std::string macro = shift_macro(layer), value = std::to_string(layer.shift);
+	if (source.find("#define " + macro + " ") != std::string::npos)
+		return replace_defines(source, { { macro, value } });
+	size_t pos = source.find("#define");
+	pos = pos == std::string::npos ? 0 : pos;
+	return source.substr(0, pos) + "#define " + macro + " " + value + "\n\n" + source.substr(pos);
+}
+
+// scale_number_t(expr) -> (expr >> shift)
+inline std::string replace_scale(const std::string &source, const std::string &shift) {
+	static const std::string call = "scale_number_t(";
+	std::string out = source;
+	for (size_t pos = out.find(call); pos != std::string::npos; pos = out.find(call, pos)) {
+		size_t end = pos + call.size();
+		for (int depth = 1; depth > 0 && end < out.size(); end++)
+			depth += out[end] == '(' ? 1 : out[end] == ')' ? -1 : 0;
+		const std::string expr = out.substr(pos + call.size(), end - 1 - pos - call.size());
+		const std::string replacement = "(" + expr + " >> " + shift + ")";
+		out.replace(pos, end - pos, replacement);
+		pos += replacement.size();
+	}
+	return out;
+}
+
+// Shape defines of a layer file and of its weights file
+inline std::map<std::string, std::string> layer_defines(const engine::Layer &layer) {
+	switch (layer.kind) {
+	case engine::LayerKind::Conv1D:
+		return { { "INPUT_CHANNELS", std::to_string(layer.channels) }, { "CONV_FILTERS", std::to_string(layer.filters) } };
+	case engine::LayerKind::MaxPool1D:
+	case engine::LayerKind::AvgPool1D:
+		return { { "INPUT_CHANNELS", std::to_string(layer.channels) } };
+	case engine::LayerKind::Flatten:
+		// Keras order [samples][channels]
+		return { { "INPUT_DIM", "[" + std::to_string(layer.samples) + "][" + std::to_string(layer.channels) + "]" },
+			{ "OUTPUT_DIM", std::to_string(layer.filters) } };
+	case engine::LayerKind::Dense:
+		return { { "INPUT_SAMPLES", std::to_string(layer.channels) }, { "FC_UNITS", std::to_string(layer.filters) } };
+	}
+	return {};
+}
+
+// weights/<layer>.c body after the header comment, in the generated format
+inline std::string weights_source(const engine::Layer &layer) {
+	const bool conv = layer.kind == engine::LayerKind::Conv1D;
+	const char *filters = conv ? "CONV_FILTERS" : "FC_UNITS";
+	std::ostringstream s;
+	if (conv)
+		s << "#define INPUT_CHANNELS    " << layer.channels << "\n#define CONV_FILTERS      " << layer.filters
+			<< "\n#define CONV_KERNEL_SIZE  " << layer.kernel_size << "\n";
+	else
+		s << "#define INPUT_SAMPLES " << layer.channels << "\n#define FC_UNITS " << layer.filters << "\n";
+
+	s << "\n\nconst int16_t " << layer.name << "_bias[" << filters << "] = {";
+	for (size_t f = 0; f < layer.filters; f++)
+		s << (f ? ", " : "") << layer.bias[f];
+	s << "}\n;\n\n";
+
+	if (conv)
+		s << "const int16_t " << layer.name << "_kernel[CONV_FILTERS][INPUT_CHANNELS][CONV_KERNEL_SIZE] = {";
+	else
+		s << "const int16_t " << layer.name << "_kernel[FC_UNITS][INPUT_SAMPLES] = {";
+	const size_t rows = conv ? layer.channels : 1, K = conv ? layer.kernel_size : layer.channels;
+	for (size_t f = 0; f < layer.filters; f++) {
+		s << (f ? ", " : "") << (conv ? "{" : "");
+		for (size_t c = 0; c < rows; c++) {
+			s << (c ? ", " : "") << "{";
+			const engine::number_t *w = layer.kernel + (f * rows + c) * K;
+			for (size_t x = 0; x < K; x++)
+				s << (x ? ", " : "") << w[x];
+			s << "}\n";
+		}
+		s << (conv ? "}\n" : "");
+	}
+	s << "}\n;\n\n";
+
+	if (conv)
+		s << "#undef INPUT_CHANNELS\n#undef CONV_FILTERS\n#undef CONV_KERNEL_SIZE\n";
+	else
+		s << "#undef INPUT_SAMPLES\n#undef FC_UNITS\n";
+	return s.str();
+}
+
+// Copies the generated sources of src_dir into dst_dir, shapes and weights from model
+inline void write_model(const std::string &src_dir, const std::string &dst_dir, const engine::Model &model) {
+	std::map<std::string, const engine::Layer *> layers;
+	for (const auto &layer : model.layers)
+		layers[layer.name + ".c"] = &layer;
+
+	mkdir(dst_dir.c_str(), 0755);
+	mkdir((dst_dir + "/weights").c_str(), 0755);
+	for (const std::string sub : { "", "/weights" }) {
+		DIR *dir = opendir((src_dir + sub).c_str());
+		if (!dir)
+			engine::fatal("opening \"" + src_dir + sub + "\": " + strerror(errno));
+		while (struct dirent *entry = readdir(dir)) {
+			const std::string file = entry->d_name;
+			if (file.size() < 3 || (file.compare(file.size() - 2, 2, ".c") && file.compare(file.size() - 2, 2, ".h")))
+				continue;
+			std::string source = read_file(src_dir + sub + "/" + file);
+			auto layer = layers.find(file);
+			if (layer != layers.end() && sub.empty()) {
+				source = replace_defines(source, layer_defines(*layer->second));
+				// A layer rewritten before keeps its macro, with the new value
+				const engine::Layer &l = *layer->second;
+				if (l.has_weights() && (l.shift != model.fixed_point || source.find("#define " + shift_macro(l) + " ") != std::string::npos))
+					source = replace_scale(set_shift(source, l), shift_macro(l));
+			} else if (layer != layers.end()) {
+				// Keep the generator's header comment
+				source = source.substr(0, source.find("#define")) + weights_source(*layer->second);
+			}
+			write_file(dst_dir + sub + "/" + file, source);
+		}
+		closedir(dir);
+	}
+}
+
+} // namespace generated_sources
+
+#endif // __TOOLS_GENERATED_SOURCES_H__
@@ -0,0 +1,119 @@
+// Quantises model variants to the int8 mode of engine/int8.h and compares them
+// with the int16 models: accuracy (or top-1 agreement with int16), weight and
+// activation memory, and latency per clip.
+//
+// Activation scales are calibrated on --calibration clips (a CSV file like
+// x_test.csv, e.g. training clips) or on synthetic clips different from the
+// evaluation ones.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -o int8_eval tools/int8_eval.cpp
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../engine/backends.h"
+#include "../engine/int8.h"
+#include "../engine/variants.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+template<typename T>
+static size_t top1(const std::vector<T> &output) {
+	return std::max_element(output.begin(), output.end()) - output.begin();
+}
+
+int main(int argc, const char *argv[]) {
+	std::string only, calibration_file, inputs_file, labels_file;
+	size_t calibration_clips = 64, clips = 64;
+	bool usage = false;
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 10, "--variant=") == 0)
+			only = arg.substr(10);
+		else if (arg.compare(0, 14, "--calibration=") == 0)
+			calibration_file = arg.substr(14);
+		else if (arg.compare(0, 20, "--calibration-clips=") == 0)
+			usage = (calibration_clips = atoi(arg.c_str() + 20)) == 0;
+		else if (arg.compare(0, 9, "--inputs=") == 0)
+			inputs_file = arg.substr(9);
+		else if (arg.compare(0, 9, "--labels=") == 0)
+			labels_file = arg.substr(9);
+		else if (arg.compare(0, 8, "--clips=") == 0)
+			usage = (clips = atoi(arg.c_str() + 8)) == 0;
+		else
+			usage = true;
+	}
+	if (usage || inputs_file.empty() != labels_file.empty()) {
+		std::cerr << "Usage: " << argv[0] << " [--variant=NAME] [--calibration=FILE.csv | --calibration-clips=N]" << std::endl
+			<< "       [--inputs=x_test.csv --labels=y_test.csv | --clips=N]" << std::endl;
+		exit(1);
+	}
+	dataset::Rows labels;
+	if (!labels_file.empty())
+		labels = dataset::read_csv(labels_file);
+
+	std::cout << std::left << std::setw(28) << "variant" << std::right << std::setw(10) << "int16 acc" << std::setw(10) << "int8 acc"
+		<< std::setw(11) << "agreement" << std::setw(13) << "int16 bytes" << std::setw(12) << "int8 bytes"
+		<< std::setw(11) << "int16 RAM" << std::setw(10) << "int8 RAM" << std::setw(10) << "gemm us" << std::setw(10) << "int8 us" << std::endl;
+
+	for (const auto &variant : variants::all()) {
+		if (!only.empty() && only != variant.name)
+			continue;
+		if (!inputs_file.empty() && !variant.language)
+			continue;
+		const engine::Model model = variant.describe();
+
+		engine::int8::Calibration calibration;
+		for (const auto &clip : dataset::load_inputs(model, calibration_file, calibration_clips, 1))
+			calibration.observe(model, clip.data());
+		const engine::int8::Model q = engine::int8::quantize(model, calibration);
+
+		engine::GemmBackend gemm;
+		gemm.prepare(model);
+		engine::Engine runner16(model, gemm);
+		engine::int8::Engine runner8(q);
+
+		auto inputs = dataset::load_inputs(model, inputs_file, clips);
+		std::vector<number_t> out16(model.output_size());
+		std::vector<engine::int8::q7_t> out8(model.output_size());
+		size_t right16 = 0, right8 = 0, agree = 0;
+		double us16 = 0, us8 = 0;
+		for (size_t n = 0; n < inputs.size(); n++) {
+			auto t0 = std::chrono::steady_clock::now();
+			runner16.run(inputs[n].data(), out16.data());
+			auto t1 = std::chrono::steady_clock::now();
+			runner8.run(inputs[n].data(), out8.data());
+			auto t2 = std::chrono::steady_clock::now();
+			us16 += std::chrono::duration<double, std::micro>(t1 - t0).count();
+			us8 += std::chrono::duration<double, std::micro>(t2 - t1).count();
+
+			agree += top1(out16) == top1(out8);
+			if (n < labels.size()) {
+				right16 += dataset::label_class(labels[n]) == top1(out16);
+				right8 += dataset::label_class(labels[n]) == top1(out8);
+			}
+		}
+
+		auto accuracy = [&](size_t right) {
+			std::ostringstream s;
+			if (labels.empty())
+				s << "-";
+			else
+				s << std::fixed << std::setprecision(3) << right / (double)inputs.size();
+			return s.str();
+		};
+		const size_t weights16 = model.weight_count() * sizeof(number_t);
+		const size_t ram16 = 2 * model.max_activation_size() * sizeof(number_t);
+		std::cout << std::left << std::setw(28) << variant.name << std::right << std::setw(10) << accuracy(right16)
+			<< std::setw(10) << accuracy(right8) << std::fixed << std::setprecision(3) << std::setw(11) << agree / (double)inputs.size()
+			<< std::setw(13) << weights16 << std::setw(12) << q.weight_bytes()
+			<< std::setw(11) << ram16 << std::setw(10) << q.ram_bytes() << std::setprecision(1)
+			<< std::setw(10) << us16 / inputs.size() << std::setw(10) << us8 / inputs.size() << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,191 @@
+// Minimal JSON reader for the files written by the tools (benchmarks, reports).
+//
+// Parses the whole grammar into a tree of Values; numbers are doubles and
+// strings are kept raw apart from the usual escapes (\uXXXX is kept as ASCII
+// when possible). Errors are fatal, like the other file readers.
+
+#ifndef __TOOLS_JSON_H__
+#define __TOOLS_JSON_H__
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../engine/model_desc.h"
+
+namespace json {
+
+struct Value {
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0;
+	std::string string;
+	std::vector<Value> array;
+	std::map<std::string, Value> object;
+
+	bool has(const std::string &key) const { return type == Type::Object && object.count(key); }
+
+	const Value &operator[](const std::string &key) const {
+		auto it = object.find(key);
+		if (type != Type::Object || it == object.end())
+			engine::fatal("JSON: missing member \"" + key + "\"");
+		return it->second;
+	}
+
+	std::vector<double> numbers() const {
+		std::vector<double> values;
+		for (const auto &v : array)
+			values.push_back(v.number);
+		return values;
+	}
+};
+
+class Parser {
+public:
+	explicit Parser(const std::string &text) : text(text) {}
+
+	Value parse() {
+		Value v = value();
+		skip_space();
+		if (pos != text.size())
+			error("trailing characters");
+		return v;
+	}
+
+private:
+	const std::string &text;
+	size_t pos = 0;
+
+	[[noreturn]] void error(const std::string &msg) {
+		engine::fatal("JSON: " + msg + " at offset " + std::to_string(pos));
+	}
+
+	void skip_space() {
+		while (pos < text.size() && strchr(" \t\r\n", text[pos]))
+			pos++;
+	}
+
+	bool consume(char c) {
+		skip_space();
+		if (pos < text.size() && text[pos] == c) {
+			pos++;
+			return true;
+		}
+		return false;
+	}
+
+	void expect(char c) {
+		if (!consume(c))
+			error(std::string("expected '") + c + "'");
+	}
+
+	bool literal(const char *word) {
+		size_t n = strlen(word);
+		if (text.compare(pos, n, word) != 0)
+			return false;
+		pos += n;
+		return true;
+	}
+
+	std::string string_value() {
+		expect('"');
+		std::string s;
+		while (pos < text.size() && text[pos] != '"') {
+			char c = text[pos++];
+			if (c == '\\' && pos < text.size()) {
+				c = text[pos++];
+				switch (c) {
+				case 'n': s += '\n'; break;
+				case 't': s += '\t'; break;
+				case 'r': s += '\r'; break;
+				case 'b': s += '\b'; break;
+				case 'f': s += '\f'; break;
+				case 'u': {
+					long code = strtol(text.substr(pos, 4).c_str(), NULL, 16);
+					pos += 4;
+					s += code < 128 ? (char)code : '?';
+					break;
+				}
+				default: s += c;
+				}
+			} else {
+				s += c;
+			}
+		}
+		expect('"');
+		return s;
+	}
+
+	Value value() {
+		skip_space();
+		if (pos >= text.size())
+			error("unexpected end");
+		Value v;
+		char c = text[pos];
+		if (c == '{') {
+			pos++;
+			v.type = Value::Type::Object;
+			if (!consume('}')) {
+				do {
+					skip_space();
+					std::string key = string_value();
+					expect(':');
+					v.object[key] = value();
+				} while (consume(','));
+				expect('}');
+			}
+		} else if (c == '[') {
+			pos++;
+			v.type = Value::Type::Array;
+			if (!consume(']')) {
+				do
+					v.array.push_back(value());
+				while (consume(','));
+				expect(']');
+			}
+		} else if (c == '"') {
+			v.type = Value::Type::String;
+			v.string = string_value();
+		} else if (literal("true")) {
+			v.type = Value::Type::Bool;
+			v.boolean = true;
+		} else if (literal("false")) {
+			v.type = Value::Type::Bool;
+		} else if (literal("null")) {
+			v.type = Value::Type::Null;
+		} else {
+			char *end;
+			v.type = Value::Type::Number;
+			v.number = strtod(text.c_str() + pos, &end);
+			if (end == text.c_str() + pos)
+				error("unexpected character");
+			pos = end - text.c_str();
+		}
+		return v;
+	}
+};
+
+inline Value parse(const std::string &text) {
+	return Parser(text).parse();
+}
+
+inline Value read_file(const std::string &filename) {
+	std::ifstream fin(filename);
+	if (!fin)
+		engine::fatal("opening \"" + filename + "\": " + strerror(errno));
+	std::stringstream buffer;
+	buffer << fin.rdbuf();
+	return parse(buffer.str());
+}
+
+} // namespace json
+
+#endif // __TOOLS_JSON_H__
@@ -0,0 +1,217 @@
+// Cortex-M4 latency estimate of every model variant from its layer shapes
+// (engine/m4_cost.h), per layer and in total, for the generated kernels and a
+// CMSIS-NN style dual-MAC implementation.
+//
+// Calibration: --measured=NAME:MS gives the `Time (ms)` that loop() printed for a
+// variant (or NAME:FILE, a serial log whose "Time (ms): N" lines are reduced to
+// their median). One scale factor is fitted to the generated-kernel estimates by
+// least squares and applied to every prediction; --factor reuses a stored one.
+// --architecture describes a model that does not exist yet, to screen it before
+// training: comma-separated conv:FILTERS:KERNEL:STRIDE, max:POOL, avg:POOL and
+// dense:UNITS layers on a --input=CHANNELSxSAMPLES input (1x16000), conv1d with
+// ReLU and dense linear like the current models.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O2 -o m4_estimate tools/m4_estimate.cpp
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../engine/m4_cost.h"
+#include "../engine/variants.h"
+#include "bench.h"
+
+using engine::m4::Implementation;
+
+struct Measurement {
+	std::string variant;
+	double ms;
+};
+
+// Milliseconds, or the median of the "Time (ms): N" lines of a serial log
+static double parse_measurement(const std::string &value) {
+	char *end;
+	double ms = strtod(value.c_str(), &end);
+	if (!value.empty() && *end == '\0')
+		return ms;
+	std::ifstream fin(value);
+	if (!fin)
+		engine::fatal("opening \"" + value + "\": " + strerror(errno));
+	std::vector<double> times;
+	std::string line;
+	while (std::getline(fin, line)) {
+		size_t pos = line.find("Time (ms):");
+		if (pos != std::string::npos)
+			times.push_back(atof(line.c_str() + pos + 10));
+	}
+	if (times.empty())
+		engine::fatal("no \"Time (ms):\" line in \"" + value + "\"");
+	return bench::percentile(times, 0.5);
+}
+
+// Model of shapes only (no weights) from an --architecture description
+static engine::Model parse_architecture(const std::string &spec, size_t channels, size_t samples, int fixed_point) {
+	engine::Model model;
+	model.name = "architecture";
+	model.input_channels = channels;
+	model.input_samples = samples;
+	model.fixed_point = fixed_point;
+	std::istringstream layers(spec);
+	std::string item;
+	while (std::getline(layers, item, ',')) {
+		std::vector<size_t> args;
+		std::istringstream fields(item);
+		std::string kind, field;
+		std::getline(fields, kind, ':');
+		while (std::getline(fields, field, ':'))
+			args.push_back(atoi(field.c_str()));
+
+		engine::Layer layer;
+		layer.channels = channels;
+		layer.samples = samples;
+		layer.kernel = nullptr;
+		layer.bias = nullptr;
+		layer.shift = fixed_point;
+		layer.relu = false;
+		if (kind == "conv" && args.size() == 3 && args[0] && args[1] && args[2]) {
+			layer.kind = engine::LayerKind::Conv1D;
+			layer.filters = args[0];
+			layer.kernel_size = args[1];
+			layer.stride = args[2];
+			layer.relu = true;
+		} else if ((kind == "max" || kind == "avg") && args.size() == 1 && args[0]) {
+			layer.kind = kind == "max" ? engine::LayerKind::MaxPool1D : engine::LayerKind::AvgPool1D;
+			layer.filters = channels;
+			layer.kernel_size = layer.stride = args[0];
+		} else if (kind == "dense" && args.size() == 1 && args[0]) {
+			layer.kind = engine::LayerKind::Dense;
+			layer.channels = channels * samples;
+			layer.samples = 1;
+			layer.filters = args[0];
+			layer.kernel_size = layer.stride = 1;
+		} else {
+			engine::fatal("bad architecture layer \"" + item + "\"");
+		}
+		if (layer.samples < layer.kernel_size)
+			engine::fatal("layer \"" + item + "\" is larger than its input");
+		layer.out_samples = (layer.samples - layer.kernel_size) / layer.stride + 1;
+		layer.name = item;
+		model.layers.push_back(layer);
+		channels = layer.filters;
+		samples = layer.out_samples;
+	}
+	if (model.layers.empty())
+		engine::fatal("empty architecture");
+	return model;
+}
+
+static std::string fixed(double v, int precision) {
+	std::ostringstream s;
+	s << std::fixed << std::setprecision(precision) << v;
+	return s.str();
+}
+
+static void print_layers(const engine::Model &model, const engine::m4::CycleCosts &costs, double factor) {
+	const auto generated = engine::m4::estimate(model, Implementation::Generated, costs);
+	const auto dual = engine::m4::estimate(model, Implementation::Dual16, costs);
+	const double total = engine::m4::total_cycles(generated);
+	std::cout << std::endl << model.name << std::endl;
+	std::cout << std::left << std::setw(22) << "layer" << std::right << std::setw(10) << "MACs" << std::setw(10) << "loads"
+		<< std::setw(9) << "flash" << std::setw(10) << "compares" << std::setw(10) << "branches" << std::setw(11) << "cycles"
+		<< std::setw(9) << "ms" << std::setw(7) << "share" << std::setw(11) << "dual16 ms" << std::endl;
+	for (size_t i = 0; i < generated.size(); i++) {
+		const engine::m4::LayerEstimate &g = generated[i];
+		std::cout << std::left << std::setw(22) << g.layer->name << std::right << std::setw(10) << (size_t)g.ops.macs
+			<< std::setw(10) << (size_t)g.ops.loads << std::setw(9) << (size_t)g.ops.flash_misses
+			<< std::setw(10) << (size_t)g.ops.compares << std::setw(10) << (size_t)(g.ops.taken + g.ops.not_taken)
+			<< std::setw(11) << (size_t)g.cycles << std::setw(9) << fixed(factor * g.cycles / (costs.mhz * 1e3), 2)
+			<< std::setw(6) << fixed(100 * g.cycles / total, 0) << "%"
+			<< std::setw(11) << fixed(factor * dual[i].cycles / (costs.mhz * 1e3), 2) << std::endl;
+	}
+}
+
+int main(int argc, const char *argv[]) {
+	std::string only, architecture;
+	size_t input_channels = 1, input_samples = 16000;
+	std::vector<Measurement> measured;
+	engine::m4::CycleCosts costs;
+	double factor = 1;
+	bool usage = false;
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 10, "--variant=") == 0) {
+			only = arg.substr(10);
+		} else if (arg.compare(0, 15, "--architecture=") == 0) {
+			architecture = arg.substr(15);
+		} else if (arg.compare(0, 8, "--input=") == 0) {
+			usage = sscanf(arg.c_str() + 8, "%zux%zu", &input_channels, &input_samples) != 2 || !input_channels || !input_samples;
+		} else if (arg.compare(0, 11, "--measured=") == 0) {
+			size_t colon = arg.find(':', 11);
+			usage = colon == std::string::npos;
+			if (!usage)
+				measured.push_back({ arg.substr(11, colon - 11), parse_measurement(arg.substr(colon + 1)) });
+		} else if (arg.compare(0, 9, "--factor=") == 0) {
+			usage = (factor = atof(arg.c_str() + 9)) <= 0;
+		} else if (arg.compare(0, 6, "--mhz=") == 0) {
+			usage = (costs.mhz = atof(arg.c_str() + 6)) <= 0;
+		} else if (arg.compare(0, 14, "--wait-states=") == 0) {
+			costs.flash_wait_states = atoi(arg.c_str() + 14);
+			usage = costs.flash_wait_states < 0;
+		} else {
+			usage = true;
+		}
+	}
+	if (usage) {
+		std::cerr << "Usage: " << argv[0] << " [--variant=NAME] [--measured=NAME:MS|NAME:SERIAL_LOG]... [--factor=K]" << std::endl
+			<< "       [--architecture=conv:F:K:S,max:P,avg:P,dense:U,... [--input=1x16000]] [--mhz=80] [--wait-states=4]" << std::endl;
+		exit(1);
+	}
+
+	std::vector<engine::Model> models;
+	for (const auto &v : variants::all())
+		models.push_back(v.describe());
+	auto find = [&](const std::string &name) -> const engine::Model & {
+		variants::find(name);	// Fatal for an unknown name
+		return *std::find_if(models.begin(), models.end(), [&](const engine::Model &m) { return m.name == name; });
+	};
+
+	// Least-squares scale of the generated-kernel estimates onto the measurements
+	if (!measured.empty()) {
+		double num = 0, den = 0;
+		for (const auto &m : measured) {
+			const double predicted = engine::m4::total_cycles(
+				engine::m4::estimate(find(m.variant), Implementation::Generated, costs)) / (costs.mhz * 1e3);
+			num += m.ms * predicted;
+			den += predicted * predicted;
+		}
+		factor = num / den;
+	}
+
+	std::cout << "Cortex-M4 at " << costs.mhz << " MHz, " << costs.flash_wait_states << " flash wait states, calibration factor "
+		<< fixed(factor, 3) << (measured.empty() ? " (uncalibrated)" : "") << std::endl;
+	std::cout << std::left << std::setw(28) << "variant" << std::right << std::setw(11) << "MACs" << std::setw(13) << "cycles"
+		<< std::setw(10) << "model ms" << std::setw(8) << "ms" << std::setw(11) << "dual16 ms" << std::setw(11) << "measured"
+		<< std::setw(8) << "error" << std::endl;
+	for (const auto &model : models) {
+		const double cycles = engine::m4::total_cycles(engine::m4::estimate(model, Implementation::Generated, costs));
+		const double dual = engine::m4::total_cycles(engine::m4::estimate(model, Implementation::Dual16, costs));
+		const double ms = cycles / (costs.mhz * 1e3);
+		std::cout << std::left << std::setw(28) << model.name << std::right << std::setw(11) << model.macs()
+			<< std::setw(13) << (size_t)cycles << std::setw(10) << fixed(ms, 1) << std::setw(8) << fixed(factor * ms, 1)
+			<< std::setw(11) << fixed(factor * dual / (costs.mhz * 1e3), 1);
+		for (const auto &m : measured)
+			if (m.variant == model.name)
+				std::cout << std::setw(11) << fixed(m.ms, 1) << std::setw(7) << fixed(100 * (factor * ms / m.ms - 1), 0) << "%";
+		std::cout << std::endl;
+	}
+
+	if (!only.empty())
+		print_layers(find(only), costs, factor);
+	if (!architecture.empty())
+		print_layers(parse_architecture(architecture, input_channels, input_samples, models[0].fixed_point), costs, factor);
+	return 0;
+}
@@ -0,0 +1,238 @@
+// Per-kernel microbenchmark over every distinct layer shape of the model variants.
+//
+// Layers are grouped by (kind, channels, samples, filters, kernel size, stride);
+// each distinct shape is benchmarked once, with the weights of its first layer and
+// the input that layer sees on a synthetic clip (so the zero-skipping kernels get
+// realistic sparsity). Every kernel implementation applying to the shape is timed
+// on warm caches over --repetitions samples, on a thread pinned to --cpu; with
+// --threads=N, N pinned threads run the kernel concurrently on their own buffers
+// (shared-cache contention). Reported per implementation: ns per call
+// (median, spread), MAC/s and bytes/s (input, output and weights touched once per
+// call). --json writes everything, raw samples included, for bench_compare.
+//
+// Shapes come from the single-file gsc_model_fixed.h of each variant, compiled
+// side by side in namespaces by engine/variants.h. The multi-file
+// gsc_output_fixed directories cover only six of the nine models (not
+// half-data-pre-trained, pre-training or gsc), and each one's model.c defines the
+// same global cnn() and layer symbols, so a program can compile only one of them.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -pthread -o microbench tools/microbench.cpp
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../engine/backends.h"
+#include "../engine/variants.h"
+#include "bench.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+struct Shape {
+	engine::LayerKind kind;
+	size_t channels, samples, filters, kernel_size, stride;
+
+	explicit Shape(const engine::Layer &l)
+		: kind(l.kind), channels(l.channels), samples(l.samples), filters(l.filters), kernel_size(l.kernel_size), stride(l.stride) {}
+
+	bool operator==(const Shape &o) const {
+		return kind == o.kind && channels == o.channels && samples == o.samples && filters == o.filters
+			&& kernel_size == o.kernel_size && stride == o.stride;
+	}
+
+	std::string key() const {
+		return std::string(engine::layer_kind_name(kind)) + " c" + std::to_string(channels) + " s" + std::to_string(samples)
+			+ " f" + std::to_string(filters) + " k" + std::to_string(kernel_size) + " st" + std::to_string(stride);
+	}
+};
+
+struct Group {
+	Shape shape;
+	size_t model;		// Index in models of the benchmarked layer
+	size_t layer;
+	std::vector<std::string> layers;	// "variant/layer" of every layer with this shape
+};
+
+struct Result {
+	std::string implementation;
+	std::vector<double> samples;	// ns per call
+};
+
+// Implementations that differ from the reference for a layer (the others fall back to it)
+static std::vector<std::string> implementations(const engine::Layer &layer, bool threads) {
+	std::vector<std::string> names = { "reference" };
+	if (!threads)
+		names.push_back("generated");	// Static accumulators: single thread only
+	if (layer.kind == engine::LayerKind::Conv1D) {
+		names.insert(names.end(), { "gemm", "narrow", "sparse", "sparse (always)", "block-sparse" });
+		if (engine::winograd::applicable(layer))
+			names.insert(names.end(), { "winograd", "winograd (always)" });
+	} else if (layer.kind == engine::LayerKind::Dense) {
+		names.insert(names.end(), { "sparse", "sparse (always)", "block-sparse" });
+	}
+	return names;
+}
+
+static std::unique_ptr<engine::Backend> make_implementation(const std::string &name) {
+	if (name == "sparse (always)")
+		return std::unique_ptr<engine::Backend>(new engine::SparseBackend(2));
+	if (name == "winograd (always)")
+		return std::unique_ptr<engine::Backend>(new engine::WinogradBackend(true));
+	return engine::make_backend(name);
+}
+
+int main(int argc, const char *argv[]) {
+	std::string only, json_file;
+	size_t repetitions = 30, threads = 1;
+	int cpu = 0;
+	double min_sample_us = 2000;
+	bool usage = false;
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 10, "--variant=") == 0)
+			only = arg.substr(10);
+		else if (arg.compare(0, 14, "--repetitions=") == 0)
+			usage = (repetitions = atoi(arg.c_str() + 14)) == 0;
+		else if (arg.compare(0, 16, "--min-sample-us=") == 0)
+			usage = (min_sample_us = atof(arg.c_str() + 16)) <= 0;
+		else if (arg.compare(0, 10, "--threads=") == 0)
+			usage = (threads = atoi(arg.c_str() + 10)) == 0;
+		else if (arg.compare(0, 6, "--cpu=") == 0)
+			cpu = atoi(arg.c_str() + 6);
+		else if (arg.compare(0, 7, "--json=") == 0)
+			json_file = arg.substr(7);
+		else
+			usage = true;
+	}
+	if (usage) {
+		std::cerr << "Usage: " << argv[0] << " [--variant=NAME] [--repetitions=N] [--min-sample-us=US] [--threads=N] [--cpu=FIRST]"
+			<< " [--json=FILE]" << std::endl;
+		exit(1);
+	}
+	const int cpus = std::max(1u, std::thread::hardware_concurrency());
+	if (!bench::pin_thread(cpu % cpus))
+		std::cerr << "Warning: cannot pin to CPU " << cpu % cpus << std::endl;
+
+	// Distinct shapes
+	std::vector<engine::Model> models;
+	models.reserve(variants::all().size());
+	std::vector<Group> groups;
+	for (const auto &variant : variants::all()) {
+		if (!only.empty() && only != variant.name)
+			continue;
+		models.push_back(variant.describe());
+		const engine::Model &model = models.back();
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			const engine::Layer &layer = model.layers[i];
+			if (layer.kind == engine::LayerKind::Flatten)
+				continue;
+			Shape shape(layer);
+			auto g = std::find_if(groups.begin(), groups.end(), [&](const Group &g) { return g.shape == shape; });
+			if (g == groups.end())
+				g = groups.insert(groups.end(), Group{ shape, models.size() - 1, i, {} });
+			g->layers.push_back(std::string(variant.name) + "/" + layer.name);
+		}
+	}
+
+	std::vector<std::vector<Result>> results(groups.size());
+	std::cout << std::left << std::setw(44) << "shape" << std::setw(17) << "kernel" << std::right << std::setw(12) << "ns/call"
+		<< std::setw(9) << "+-%" << std::setw(10) << "GMAC/s" << std::setw(10) << "GB/s" << std::endl;
+	for (size_t g = 0; g < groups.size(); g++) {
+		const engine::Model &model = models[groups[g].model];
+		const size_t index = groups[g].layer;
+		const engine::Layer &layer = model.layers[index];
+
+		// Layer input on a synthetic clip
+		engine::ReferenceBackend reference;
+		engine::Engine prefix(model, reference);
+		std::vector<number_t> input = dataset::load_inputs(model, "", 1)[0], out;
+		for (size_t i = 0; i < index; i++) {
+			out.assign(model.layers[i].output_size(), 0);
+			prefix.run_layer(i, input.data(), out.data());
+			input.swap(out);
+		}
+
+		const double macs = layer.kind == engine::LayerKind::Conv1D || layer.kind == engine::LayerKind::Dense
+			? layer.macs() : layer.output_size() * layer.kernel_size;
+		const double bytes = (layer.input_size() + layer.output_size() + layer.weight_count()
+			+ (layer.bias ? layer.filters : 0)) * sizeof(number_t);
+		for (const auto &name : implementations(layer, threads > 1)) {
+			std::unique_ptr<engine::Backend> backend = make_implementation(name);
+			backend->prepare(model);
+			Result result = { name, {} };
+
+			std::vector<std::vector<double>> per_thread(threads);
+			std::atomic<size_t> ready(0);
+			auto worker = [&](size_t t) {
+				if (t > 0 && !bench::pin_thread((cpu + t) % cpus))
+					std::cerr << "Warning: cannot pin to CPU " << (cpu + t) % cpus << std::endl;
+				engine::Engine runner(model, *backend);
+				std::vector<number_t> in = input, output(layer.output_size());
+				// Start together so the threads overlap
+				ready++;
+				while (ready < threads)
+					std::this_thread::yield();
+				per_thread[t] = bench::time_samples([&]() { runner.run_layer(index, in.data(), output.data()); },
+						repetitions, min_sample_us);
+			};
+			std::vector<std::thread> workers;
+			for (size_t t = 1; t < threads; t++)
+				workers.emplace_back(worker, t);
+			worker(0);
+			for (auto &w : workers)
+				w.join();
+			for (const auto &samples : per_thread)
+				result.samples.insert(result.samples.end(), samples.begin(), samples.end());
+
+			const bench::Summary s = bench::summarize(result.samples);
+			std::cout << std::left << std::setw(44) << groups[g].shape.key() << std::setw(17) << name << std::right
+				<< std::fixed << std::setprecision(0) << std::setw(12) << s.median << std::setprecision(1)
+				<< std::setw(9) << 100 * (s.p90 - s.p10) / 2 / s.median << std::setprecision(2)
+				<< std::setw(10) << macs / s.median << std::setw(10) << bytes / s.median << std::endl;
+			results[g].push_back(result);
+		}
+	}
+
+	if (!json_file.empty()) {
+		std::ofstream fout(json_file);
+		if (!fout)
+			engine::fatal("cannot write \"" + json_file + "\"");
+		fout << "{\n  \"benchmark\": \"microbench\",\n  \"threads\": " << threads << ",\n  \"repetitions\": " << repetitions
+			<< ",\n  \"kernels\": [";
+		bool first = true;
+		for (size_t g = 0; g < groups.size(); g++) {
+			const Shape &shape = groups[g].shape;
+			const engine::Layer &layer = models[groups[g].model].layers[groups[g].layer];
+			const double macs = layer.kind == engine::LayerKind::Conv1D || layer.kind == engine::LayerKind::Dense
+				? layer.macs() : layer.output_size() * layer.kernel_size;
+			const double bytes = (layer.input_size() + layer.output_size() + layer.weight_count()
+				+ (layer.bias ? layer.filters : 0)) * sizeof(number_t);
+			for (const auto &r : results[g]) {
+				const bench::Summary s = bench::summarize(r.samples);
+				fout << (first ? "" : ",") << "\n    { \"name\": \"" << shape.key() << " / " << r.implementation
+					<< "\", \"kind\": \"" << engine::layer_kind_name(shape.kind) << "\", \"channels\": " << shape.channels
+					<< ", \"samples\": " << shape.samples << ", \"filters\": " << shape.filters
+					<< ", \"kernel_size\": " << shape.kernel_size << ", \"stride\": " << shape.stride
+					<< ", \"implementation\": \"" << r.implementation << "\", \"layers\": [";
+				for (size_t l = 0; l < groups[g].layers.size(); l++)
+					fout << (l ? ", " : "") << "\"" << groups[g].layers[l] << "\"";
+				fout << "],\n      \"macs\": " << macs << ", \"bytes\": " << bytes << ", \"mac_per_s\": " << macs / s.median * 1e9
+					<< ", \"bytes_per_s\": " << bytes / s.median * 1e9 << ",\n      \"ns_per_call\": ";
+				bench::write_json(fout, s);
+				fout << ",\n      \"samples\": ";
+				bench::write_json(fout, r.samples);
+				fout << " }";
+				first = false;
+			}
+		}
+		fout << "\n  ]\n}\n";
+	}
+	return 0;
+}
@@ -0,0 +1,125 @@
+// Runs the model variants with per-layer fixed-point formats (engine/fixed.h)
+// chosen at build time, and compares them with the int16 Q6.9 models.
+//
+// The all-Q6.9 configuration must be bit-exact with the generated cnn() (the
+// exit status is 1 otherwise); the others report the top-1 agreement with it.
+// Fixed formats chosen without calibration saturate easily in int8.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -o mixed_precision tools/mixed_precision.cpp
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../engine/fixed.h"
+#include "../engine/variants.h"
+#include "dataset.h"
+
+using engine::Fixed;
+using engine::LayerPrecision;
+using engine::number_t;
+using engine::Q6_9;
+
+// Formats of the configurations
+typedef Fixed<int16_t, 12> Q3_12;	// Input and first conv: audio rarely exceeds +-8
+typedef Fixed<int8_t, 7> Q0_7;		// Weights below 1 in magnitude
+typedef Fixed<int8_t, 3> Q4_3;
+typedef Fixed<int8_t, 2> Q5_2;
+
+template<typename T>
+static size_t top1(const std::vector<T> &output) {
+	size_t best = 0;
+	for (size_t i = 1; i < output.size(); i++)
+		if (output[best].raw < output[i].raw)
+			best = i;
+	return best;
+}
+
+struct Result {
+	size_t agree = 0;
+	size_t identical = 0;	// Same raw outputs as the generated cnn() (all-Q6.9 only)
+};
+
+template<typename Engine>
+static Result compare(Engine &engine, const variants::Variant &variant, const std::vector<std::vector<number_t>> &inputs) {
+	Result r;
+	const engine::Model &model = engine.get_model();
+	std::vector<number_t> expected(model.output_size());
+	std::vector<typename Engine::Output> actual(model.output_size());
+	for (const auto &input : inputs) {
+		variant.cnn(input.data(), expected.data());
+		engine.run(input.data(), actual.data());
+		size_t best = std::max_element(expected.begin(), expected.end()) - expected.begin();
+		r.agree += top1(actual) == best;
+		bool same = true;
+		for (size_t i = 0; i < expected.size(); i++)
+			same = same && expected[i] == (number_t)actual[i].raw;
+		r.identical += same;
+	}
+	return r;
+}
+
+template<typename Engine>
+static void report(const char *config, const variants::Variant &variant, const engine::Model &model,
+		const std::vector<std::vector<number_t>> &inputs, size_t weight_bytes, bool expect_exact, bool &ok) {
+	Engine engine(model);
+	Result r = compare(engine, variant, inputs);
+	bool exact = r.identical == inputs.size();
+	ok = ok && (!expect_exact || exact);
+	std::cout << std::left << std::setw(28) << variant.name << std::setw(18) << config << std::right << std::fixed
+		<< std::setprecision(3) << std::setw(11) << r.agree / (double)inputs.size()
+		<< std::setw(11) << (expect_exact ? (exact ? "yes" : "NO") : "-")
+		<< std::setw(14) << weight_bytes << std::endl;
+}
+
+int main(int argc, const char *argv[]) {
+	std::string inputs_file;
+	size_t clips = 64;
+	for (int i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "--inputs=", 9))
+			inputs_file = argv[i] + 9;
+		else if (!strncmp(argv[i], "--clips=", 8) && atoi(argv[i] + 8) > 0)
+			clips = atoi(argv[i] + 8);
+		else {
+			std::cerr << "Usage: " << argv[0] << " [--inputs=x_test.csv | --clips=N]" << std::endl;
+			exit(1);
+		}
+	}
+
+	std::cout << std::left << std::setw(28) << "variant" << std::setw(18) << "precision" << std::right << std::setw(11) << "agreement"
+		<< std::setw(11) << "bit-exact" << std::setw(14) << "weight bytes" << std::endl;
+
+	bool ok = true;
+	for (const auto &variant : variants::all()) {
+		if (!inputs_file.empty() && !variant.language)
+			continue;
+		const engine::Model model = variant.describe();
+		auto inputs = dataset::load_inputs(model, inputs_file, clips);
+		const size_t weights = model.weight_count();
+
+		if (!variant.language) {
+			typedef LayerPrecision<Q6_9> L;
+			report<engine::FixedEngine<Q6_9, L, L, L>>("Q6.9", variant, model, inputs, 2 * weights, true, ok);
+			continue;
+		}
+
+		typedef LayerPrecision<Q6_9> L;
+		report<engine::FixedEngine<Q6_9, L, L, L, L, L>>("Q6.9", variant, model, inputs, 2 * weights, true, ok);
+
+		// Finer input and first conv output, Q6.9 afterwards
+		report<engine::FixedEngine<Q3_12, LayerPrecision<Q3_12>, L, L, L, L>>(
+				"Q3.12 first, Q6.9", variant, model, inputs, 2 * weights, false, ok);
+
+		// int8 weights, int16 activations
+		typedef LayerPrecision<Q6_9, Q0_7> W8;
+		report<engine::FixedEngine<Q6_9, W8, W8, W8, W8, W8>>("Q6.9 / w Q0.7", variant, model, inputs, weights, false, ok);
+
+		// int8 weights and activations after the int16 first layer
+		typedef LayerPrecision<Q4_3, Q0_7> A8;
+		typedef LayerPrecision<Q5_2, Q0_7> B8;
+		report<engine::FixedEngine<Q6_9, LayerPrecision<Q6_9, Q0_7>, A8, A8, B8, B8>>("Q6.9, then int8", variant, model, inputs, weights, false, ok);
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+// End-to-end benchmark of the model variants: single-clip latency percentiles
+// and multi-thread throughput of each implementation, in one comparison table.
+//
+// All variants are compiled into this binary (engine/variants.h) and run on the
+// same clips, real (--inputs) or synthetic. Latency: every clip is scored
+// --repetitions times on one pinned thread, each run timed on its own, after a
+// warm-up pass. Throughput: --threads pinned threads, each with its own Engine,
+// score the clips in turn for --seconds. The generated cnn() keeps static state, so
+// it is only timed on one thread. --json writes the table and the latency samples
+// for bench_compare.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -march=native -pthread -o model_bench tools/model_bench.cpp
+
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../engine/backends.h"
+#include "../engine/float_engine.h"
+#include "../engine/variants.h"
+#include "bench.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+static const char *const IMPLEMENTATIONS[] = { "cnn", "reference", "gemm", "winograd", "sparse", "float" };
+
+// Scores one clip; one Runner per thread
+class Runner {
+public:
+	// backend: engine implementation, else the float engine if use_float, else cnn()
+	Runner(const variants::Variant &variant, const engine::Model &model, engine::Backend *backend, bool use_float)
+		: variant(variant), output(model.output_size()), float_output(model.output_size()) {
+		if (backend)
+			engine.reset(new engine::Engine(model, *backend));
+		else if (use_float)
+			float_engine.reset(new engine::FloatEngine(model));
+	}
+
+	void run(const number_t *input) {
+		if (engine)
+			engine->run(input, output.data());
+		else if (float_engine)
+			float_engine->run(input, float_output.data());
+		else
+			variant.cnn(input, output.data());
+	}
+
+private:
+	const variants::Variant &variant;
+	std::unique_ptr<engine::Engine> engine;
+	std::unique_ptr<engine::FloatEngine> float_engine;
+	std::vector<number_t> output;
+	std::vector<float> float_output;
+};
+
+struct Row {
+	std::string variant;
+	std::string implementation;
+	std::vector<double> latency_us;
+	double clips_per_s;		// 0 when not measured
+};
+
+int main(int argc, const char *argv[]) {
+	std::string inputs_file, only, json_file;
+	size_t clips = 16, repetitions = 10, threads = std::max(1u, std::thread::hardware_concurrency());
+	double seconds = 1;
+	int cpu = 0;
+	bool include_gsc = false, usage = false;
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 9, "--inputs=") == 0)
+			inputs_file = arg.substr(9);
+		else if (arg.compare(0, 8, "--clips=") == 0)
+			usage = (clips = atoi(arg.c_str() + 8)) == 0;
+		else if (arg.compare(0, 10, "--variant=") == 0)
+			only = arg.substr(10);
+		else if (arg.compare(0, 14, "--repetitions=") == 0)
+			usage = (repetitions = atoi(arg.c_str() + 14)) == 0;
+		else if (arg.compare(0, 10, "--threads=") == 0)
+			usage = (threads = atoi(arg.c_str() + 10)) == 0;
+		else if (arg.compare(0, 10, "--seconds=") == 0)
+			usage = (seconds = atof(arg.c_str() + 10)) <= 0;
+		else if (arg.compare(0, 6, "--cpu=") == 0)
+			cpu = atoi(arg.c_str() + 6);
+		else if (arg == "--gsc")
+			include_gsc = true;
+		else if (arg.compare(0, 7, "--json=") == 0)
+			json_file = arg.substr(7);
+		else
+			usage = true;
+	}
+	if (usage) {
+		std::cerr << "Usage: " << argv[0] << " [--inputs=x_test.csv | --clips=N] [--variant=NAME] [--gsc] [--repetitions=N]" << std::endl
+			<< "       [--threads=N] [--seconds=S] [--cpu=FIRST] [--json=FILE]" << std::endl;
+		exit(1);
+	}
+	const int cpus = std::max(1u, std::thread::hardware_concurrency());
+	if (!bench::pin_thread(cpu % cpus))
+		std::cerr << "Warning: cannot pin to CPU " << cpu % cpus << std::endl;
+
+	std::vector<Row> rows;
+	for (const auto &variant : variants::all()) {
+		if (!only.empty() ? only != variant.name : !variant.language && !include_gsc)
+			continue;
+		const engine::Model model = variant.describe();
+		const auto inputs = dataset::load_inputs(model, inputs_file, clips);
+
+		for (const char *implementation : IMPLEMENTATIONS) {
+			const std::string name = implementation;
+			std::unique_ptr<engine::Backend> backend;
+			if (name != "cnn" && name != "float") {
+				backend = engine::make_backend(name);
+				backend->prepare(model);
+			}
+			const bool use_float = name == "float";
+			Row row = { variant.name, name, {}, 0 };
+
+			// Latency, one thread
+			Runner runner(variant, model, backend.get(), use_float);
+			for (const auto &clip : inputs)
+				runner.run(clip.data());
+			for (size_t r = 0; r < repetitions; r++)
+				for (const auto &clip : inputs) {
+					auto start = bench::Clock::now();
+					runner.run(clip.data());
+					row.latency_us.push_back(bench::elapsed_ns(start) / 1000);
+				}
+
+			// Throughput
+			if (name != "cnn" || threads == 1) {
+				std::atomic<size_t> scored(0);
+				std::atomic<bool> stop(false);
+				auto worker = [&](size_t t) {
+					if (t > 0)
+						bench::pin_thread((cpu + t) % cpus);
+					Runner local(variant, model, backend.get(), use_float);
+					size_t n = 0;
+					for (size_t k = t; !stop; k++, n++)
+						local.run(inputs[k % inputs.size()].data());
+					scored += n;
+				};
+				auto start = bench::Clock::now();
+				std::vector<std::thread> workers;
+				for (size_t t = 1; t < threads; t++)
+					workers.emplace_back(worker, t);
+				std::thread timer([&]() {
+					std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+					stop = true;
+				});
+				worker(0);
+				timer.join();
+				for (auto &w : workers)
+					w.join();
+				row.clips_per_s = scored / (bench::elapsed_ns(start) * 1e-9);
+			}
+			rows.push_back(row);
+		}
+	}
+
+	std::cout << clips << (inputs_file.empty() ? " synthetic" : "") << " clips, " << repetitions << " repetitions, "
+		<< threads << " threads" << std::endl;
+	std::cout << std::left << std::setw(28) << "variant" << std::setw(11) << "kernel" << std::right << std::setw(9) << "p50 us"
+		<< std::setw(9) << "p90 us" << std::setw(9) << "p99 us" << std::setw(9) << "max us" << std::setw(11) << "clips/s"
+		<< std::setw(11) << "vs cnn" << std::endl;
+	for (const auto &row : rows) {
+		const double p50 = bench::percentile(row.latency_us, 0.5);
+		double cnn_p50 = 0;
+		for (const auto &r : rows)
+			if (r.variant == row.variant && r.implementation == "cnn")
+				cnn_p50 = bench::percentile(r.latency_us, 0.5);
+		std::cout << std::left << std::setw(28) << row.variant << std::setw(11) << row.implementation << std::right
+			<< std::fixed << std::setprecision(1) << std::setw(9) << p50 << std::setw(9) << bench::percentile(row.latency_us, 0.9)
+			<< std::setw(9) << bench::percentile(row.latency_us, 0.99) << std::setw(9) << bench::summarize(row.latency_us).max
+			<< std::setprecision(0) << std::setw(11) << (row.clips_per_s > 0 ? std::to_string((long)row.clips_per_s) : "-")
+			<< std::setprecision(2) << std::setw(10) << (p50 > 0 ? cnn_p50 / p50 : 0) << "x" << std::endl;
+	}
+
+	if (!json_file.empty()) {
+		std::ofstream fout(json_file);
+		if (!fout)
+			engine::fatal("cannot write \"" + json_file + "\"");
+		fout << "{\n  \"benchmark\": \"model_bench\",\n  \"threads\": " << threads << ",\n  \"clips\": " << clips
+			<< ",\n  \"models\": [";
+		for (size_t r = 0; r < rows.size(); r++) {
+			fout << (r ? "," : "") << "\n    { \"name\": \"" << rows[r].variant << " / " << rows[r].implementation
+				<< "\", \"variant\": \"" << rows[r].variant << "\", \"implementation\": \"" << rows[r].implementation
+				<< "\", \"clips_per_s\": " << rows[r].clips_per_s << ",\n      \"latency_us\": ";
+			bench::write_json(fout, bench::summarize(rows[r].latency_us));
+			fout << ",\n      \"samples\": ";
+			bench::write_json(fout, rows[r].latency_us);
+			fout << " }";
+		}
+		fout << "\n  ]\n}\n";
+	}
+	return 0;
+}
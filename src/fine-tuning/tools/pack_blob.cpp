@@ -0,0 +1,187 @@
+// Compression ratio, decode cost and bit-exactness of the compressed weight blobs
+// (engine/weight_pack.h) of every variant.
+//
+// Each variant is encoded, every decoded layer is compared with the compiled-in
+// kernel and bias, and the model is run through PackedBackend against cnn() on
+// synthetic clips. The tool reports the blob size against the plain weight blob,
+// the kernel bits per weight, the host time per clip of the decode, and the decode
+// cycles on a Cortex-M4 (engine/m4_cost.h) against the estimated latency of the
+// generated model. --variant shows the encoding of every layer; --output writes
+// the compressed blobs.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O2 -o pack_blob tools/pack_blob.cpp
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../engine/m4_cost.h"
+#include "../engine/pack_model.h"
+#include "../engine/variants.h"
+#include "bench.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+static std::string fixed(double v, int precision) {
+	std::ostringstream s;
+	s << std::fixed << std::setprecision(precision) << v;
+	return s.str();
+}
+
+// Cortex-M4 cycles to decode the kernel and copy the bias of layer i
+static double m4_decode_cycles(const engine::blob::PackView &pack, uint32_t i, const engine::Layer &layer,
+		const engine::m4::CycleCosts &costs) {
+	const engine::blob::PackEntry &e = pack.entry(i);
+	const double weights = e.layer.weight_count();
+	engine::m4::OpCounts ops;
+	if (e.encoding == engine::blob::PACK_FIXED) {
+		ops = engine::m4::unpack(weights, weights, e.bits, false, false, costs);
+	} else {
+		// Code length of every high part from the table, then of every weight
+		const uint8_t *payload = (const uint8_t *)&pack.header() + e.layer.kernel_offset;
+		uint16_t count[16];
+		memcpy(count, payload, sizeof(count));
+		std::vector<uint32_t> length(256, 0);
+		for (uint32_t len = 1, index = 0; len <= e.max_length; len++)
+			for (uint32_t n = 0; n < count[len]; n++)
+				length[payload[engine::blob::PACK_TABLE_BYTES + index++]] = len;
+		double code_bits = 0, long_codes = 0, long_code_bits = 0;
+		for (size_t k = 0; k < layer.weight_count(); k++) {
+			const uint32_t len = length[(layer.kernel[k] - e.offset) >> e.bits];
+			code_bits += len;
+			if (len > engine::blob::PACK_LOOKUP_BITS) {
+				long_codes++;
+				long_code_bits += len;
+			}
+		}
+		ops = engine::m4::huffman(weights, code_bits, long_codes, long_code_bits, e.bits, costs);
+		// Lookup table: cleared, then filled
+		ops.stores += 2 << engine::blob::PACK_LOOKUP_BITS;
+		engine::m4::loop(ops, 2 << engine::blob::PACK_LOOKUP_BITS);
+	}
+	ops.loads += e.layer.filters;
+	ops.stores += e.layer.filters;
+	ops.flash_misses += e.layer.filters * sizeof(number_t) / costs.flash_line_bytes;
+	return costs.cycles(ops);
+}
+
+int main(int argc, const char *argv[]) {
+	std::string only, output;
+	size_t clips = 8, repetitions = 5;
+	bool usage = false;
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 10, "--variant=") == 0)
+			only = arg.substr(10);
+		else if (arg.compare(0, 8, "--clips=") == 0)
+			usage = (clips = atoi(arg.c_str() + 8)) == 0;
+		else if (arg.compare(0, 14, "--repetitions=") == 0)
+			usage = (repetitions = atoi(arg.c_str() + 14)) == 0;
+		else if (arg.compare(0, 9, "--output=") == 0)
+			output = arg.substr(9);
+		else
+			usage = true;
+	}
+	if (usage) {
+		std::cerr << "Usage: " << argv[0] << " [--variant=NAME] [--clips=N] [--repetitions=N] [--output=DIR]" << std::endl;
+		exit(1);
+	}
+
+	engine::m4::CycleCosts costs;
+	std::cout << "Cortex-M4 at " << costs.mhz << " MHz, " << costs.flash_wait_states << " flash wait states" << std::endl;
+	std::cout << std::left << std::setw(28) << "variant" << std::right << std::setw(8) << "blob B" << std::setw(10) << "packed B"
+		<< std::setw(7) << "ratio" << std::setw(8) << "bits/w" << std::setw(11) << "decode us" << std::setw(11) << "M4 decode"
+		<< std::setw(8) << "model" << std::setw(8) << "added" << std::endl;
+
+	size_t blob_total = 0, packed_total = 0;
+	for (const auto &variant : variants::all()) {
+		if (!only.empty() && only != variant.name)
+			continue;
+		const engine::Model model = variant.describe();
+		const std::vector<uint8_t> data = engine::blob::encode_packed(model);
+		engine::blob::PackView pack;
+		engine::blob::Status status = pack.open(data.data(), data.size());
+		if (status != engine::blob::Status::OK)
+			engine::fatal(std::string(variant.name) + ": " + engine::blob::status_name(status));
+		if (!output.empty()) {
+			const std::string filename = output + "/" + variant.name + ".pack";
+			std::ofstream fout(filename, std::ios::binary);
+			if (!fout)
+				engine::fatal("cannot write \"" + filename + "\"");
+			fout.write((const char *)data.data(), data.size());
+		}
+
+		// Every layer decodes to the compiled-in weights, and the model to cnn()
+		size_t scratch_size = 0;
+		for (const auto &layer : model.layers)
+			scratch_size = std::max(scratch_size, layer.weight_count() + (layer.has_weights() ? layer.filters : 0));
+		std::vector<number_t> scratch(scratch_size);
+		for (uint32_t i = 0; i < pack.layers(); i++) {
+			const engine::Layer &layer = model.layers[i];
+			if (!layer.has_weights())
+				continue;
+			pack.decode(i, scratch.data());
+			if (!std::equal(layer.kernel, layer.kernel + layer.weight_count(), scratch.data())
+					|| !std::equal(layer.bias, layer.bias + layer.filters, scratch.data() + layer.weight_count()))
+				engine::fatal(std::string(variant.name) + ": " + layer.name + " does not decode to its weights");
+		}
+		engine::blob::PackedBackend backend(pack);
+		backend.prepare(model);
+		engine::Engine runner(model, backend);
+		std::vector<number_t> expected(model.output_size()), result(model.output_size());
+		for (const auto &clip : dataset::load_inputs(model, "", clips)) {
+			variant.cnn(clip.data(), expected.data());
+			runner.run(clip.data(), result.data());
+			if (result != expected)
+				engine::fatal(std::string(variant.name) + ": compressed model differs from cnn()");
+		}
+
+		const double decode_ns = bench::percentile(bench::time_samples([&]() {
+			for (uint32_t i = 0; i < pack.layers(); i++)
+				if (pack.layer(i).has_weights())
+					pack.decode(i, scratch.data());
+		}, repetitions), 0.5);
+		double m4_decode = 0, kernel_bytes = 0, weights = 0;
+		for (uint32_t i = 0; i < pack.layers(); i++) {
+			if (!pack.layer(i).has_weights())
+				continue;
+			m4_decode += m4_decode_cycles(pack, i, model.layers[i], costs);
+			kernel_bytes += pack.entry(i).kernel_bytes;
+			weights += pack.layer(i).weight_count();
+		}
+		const double m4_model = engine::m4::total_cycles(engine::m4::estimate(model, engine::m4::Implementation::Generated, costs));
+		const size_t blob_size = engine::blob::encode(model).size();
+		blob_total += blob_size;
+		packed_total += data.size();
+		std::cout << std::left << std::setw(28) << variant.name << std::right << std::setw(8) << blob_size
+			<< std::setw(10) << data.size() << std::setw(7) << fixed((double)data.size() / blob_size, 2)
+			<< std::setw(8) << fixed(8 * kernel_bytes / weights, 2) << std::setw(11) << fixed(decode_ns / 1e3, 1)
+			<< std::setw(8) << fixed(m4_decode / (costs.mhz * 1e3), 2) << " ms" << std::setw(5)
+			<< fixed(m4_model / (costs.mhz * 1e3), 0) << " ms" << std::setw(7) << fixed(100 * m4_decode / m4_model, 2) << "%" << std::endl;
+
+		if (only.empty())
+			continue;
+		std::cout << std::endl << std::left << std::setw(22) << "layer" << std::right << std::setw(8) << "weights"
+			<< std::setw(10) << "encoding" << std::setw(6) << "bits" << std::setw(9) << "symbols" << std::setw(8) << "bits/w"
+			<< std::setw(9) << "int16 B" << std::setw(10) << "packed B" << std::setw(14) << "M4 cycles/w" << std::endl;
+		for (uint32_t i = 0; i < pack.layers(); i++) {
+			const engine::blob::PackEntry &e = pack.entry(i);
+			if (!e.layer.has_weights())
+				continue;
+			const bool huffman = e.encoding == engine::blob::PACK_HUFFMAN;
+			std::cout << std::left << std::setw(22) << e.layer.name << std::right << std::setw(8) << e.layer.weight_count()
+				<< std::setw(10) << (huffman ? "huffman" : "fixed") << std::setw(6) << e.bits << std::setw(9)
+				<< (huffman ? std::to_string(e.symbols) : "-") << std::setw(8) << fixed(8.0 * e.kernel_bytes / e.layer.weight_count(), 2)
+				<< std::setw(9) << e.layer.weight_count() * sizeof(number_t) << std::setw(10) << e.kernel_bytes
+				<< std::setw(14) << fixed(m4_decode_cycles(pack, i, model.layers[i], costs) / e.layer.weight_count(), 1) << std::endl;
+		}
+	}
+	std::cout << std::endl << "All blobs: " << blob_total << " bytes plain, " << packed_total << " bytes compressed ("
+		<< fixed(100 * (1 - (double)packed_total / blob_total), 1) << "% less), bit-exact with cnn() on " << clips << " clips" << std::endl;
+	return 0;
+}
@@ -0,0 +1,264 @@
+// Prunes the int16 weights of a model variant at several sparsity levels and
+// reports, per level, the accuracy, the flash size of the weights stored dense
+// and block-sparse (engine/block_sparse.h) and the latency per clip.
+//
+// Methods, applied to every layer with the same level:
+//  - magnitude: zeroes the weight blocks (block_sparse::BLOCK consecutive values
+//    of a filter row) of smallest L1 norm
+//  - filter: zeroes the conv1d filters of smallest L1 norm (bias kept)
+//  - channel: zeroes the input channels of conv1d/dense kernels of smallest L1 norm
+//    (not the first layer's single input channel)
+//
+// With --inputs/--labels (x_test.csv/y_test.csv) the accuracy is measured as in
+// main.cpp; the agreement with the unpruned model's top-1 class is always given.
+// --export=DIR writes the block-sparse weights of each level as C arrays.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -o prune tools/prune.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "../engine/backends.h"
+#include "../engine/owned_model.h"
+#include "../engine/variants.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+enum class Method { Magnitude, Filter, Channel };
+
+// Zeroes the count groups of smallest L1 norm; group g holds the kernel indices members(g)
+template<typename Members>
+static void zero_smallest(std::vector<number_t> &kernel, size_t groups, size_t count, Members members) {
+	std::vector<std::pair<long, size_t>> norms;
+	for (size_t g = 0; g < groups; g++) {
+		long norm = 0;
+		for (size_t i : members(g))
+			norm += std::abs(kernel[i]);
+		norms.push_back({ norm, g });
+	}
+	std::sort(norms.begin(), norms.end());
+	for (size_t n = 0; n < count && n < groups; n++)
+		for (size_t i : members(norms[n].second))
+			kernel[i] = 0;
+}
+
+static void prune(engine::OwnedModel &owned, Method method, double level) {
+	const engine::Model &model = owned.get();
+	for (size_t l = 0; l < model.layers.size(); l++) {
+		const engine::Layer &layer = model.layers[l];
+		if (!layer.has_weights())
+			continue;
+		std::vector<number_t> &kernel = owned.kernel(l);
+		const size_t F = layer.filters, C = layer.channels, K = layer.kernel_size, depth = C * K;
+
+		switch (method) {
+		case Method::Magnitude: {
+			const size_t row_blocks = (depth + engine::block_sparse::BLOCK - 1) / engine::block_sparse::BLOCK;
+			zero_smallest(kernel, F * row_blocks, (size_t)(level * F * row_blocks), [&](size_t g) {
+				std::vector<size_t> members;
+				size_t f = g / row_blocks, b = g % row_blocks;
+				for (size_t i = 0; i < engine::block_sparse::BLOCK && b * engine::block_sparse::BLOCK + i < depth; i++)
+					members.push_back(f * depth + b * engine::block_sparse::BLOCK + i);
+				return members;
+			});
+			break;
+		}
+		case Method::Filter:
+			// The dense units are the class scores
+			if (layer.kind != engine::LayerKind::Conv1D)
+				break;
+			zero_smallest(kernel, F, (size_t)(level * F), [&](size_t f) {
+				std::vector<size_t> members;
+				for (size_t d = 0; d < depth; d++)
+					members.push_back(f * depth + d);
+				return members;
+			});
+			break;
+		case Method::Channel:
+			if (C < 2)
+				break;
+			zero_smallest(kernel, C, (size_t)(level * C), [&](size_t c) {
+				std::vector<size_t> members;
+				for (size_t f = 0; f < F; f++)
+					for (size_t x = 0; x < K; x++)
+						members.push_back((f * C + c) * K + x);
+				return members;
+			});
+			break;
+		}
+	}
+	owned.update();
+}
+
+template<typename T>
+static void write_array(std::ostream &out, const char *type, const std::string &name, const std::vector<T> &values, size_t per_line) {
+	out << "const " << type << " " << name << "[" << values.size() << "] = {";
+	for (size_t i = 0; i < values.size(); i++)
+		out << (i % per_line ? " " : "\n  ") << values[i] << (i + 1 < values.size() ? "," : "");
+	out << "\n};\n\n";
+}
+
+static void export_weights(const std::string &dir, const engine::Model &model, const engine::BlockSparseBackend &backend, const std::string &what) {
+	mkdir(dir.c_str(), 0755);
+	for (size_t l = 0; l < model.layers.size(); l++) {
+		const engine::Layer &layer = model.layers[l];
+		if (!layer.has_weights())
+			continue;
+		const engine::block_sparse::Weights &w = backend.weights(l);
+		std::ofstream out(dir + "/" + layer.name + ".c");
+		if (!out)
+			engine::fatal("cannot write " + dir + "/" + layer.name + ".c");
+		out << "// Block-sparse weights of " << layer.name << ", " << what << ", see engine/block_sparse.h\n"
+			<< "// " << w.rows << " rows of " << w.depth << " values, " << w.blocks() << " blocks of "
+			<< engine::block_sparse::BLOCK << "\n\n";
+		write_array(out, "int16_t", layer.name + "_bias", std::vector<number_t>(layer.bias, layer.bias + layer.filters), 16);
+		write_array(out, "uint16_t", layer.name + "_kernel_row_start", w.row_start, 16);
+		write_array(out, "uint16_t", layer.name + "_kernel_block_index", w.block_index, 16);
+		write_array(out, "int16_t", layer.name + "_kernel_values", w.values, engine::block_sparse::BLOCK * 4);
+	}
+}
+
+static size_t top1(const std::vector<number_t> &output) {
+	return std::max_element(output.begin(), output.end()) - output.begin();
+}
+
+int main(int argc, const char *argv[]) {
+	std::string variant_name = "fine-tuning", inputs_file, labels_file, export_dir;
+	std::vector<double> levels = { 0, 0.25, 0.5, 0.7, 0.8, 0.9 };
+	Method method = Method::Magnitude;
+	size_t clips = 64;
+	bool usage = false;
+
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 10, "--variant=") == 0)
+			variant_name = arg.substr(10);
+		else if (arg.compare(0, 9, "--inputs=") == 0)
+			inputs_file = arg.substr(9);
+		else if (arg.compare(0, 9, "--labels=") == 0)
+			labels_file = arg.substr(9);
+		else if (arg.compare(0, 8, "--clips=") == 0 && atoi(arg.c_str() + 8) > 0)
+			clips = atoi(arg.c_str() + 8);
+		else if (arg.compare(0, 9, "--export=") == 0)
+			export_dir = arg.substr(9);
+		else if (arg == "--method=magnitude")
+			method = Method::Magnitude;
+		else if (arg == "--method=filter")
+			method = Method::Filter;
+		else if (arg == "--method=channel")
+			method = Method::Channel;
+		else if (arg.compare(0, 9, "--levels=") == 0) {
+			levels.clear();
+			std::istringstream list(arg.substr(9));
+			std::string level;
+			while (std::getline(list, level, ','))
+				levels.push_back(atof(level.c_str()));
+			usage = levels.empty();
+		} else
+			usage = true;
+	}
+	if (usage || inputs_file.empty() != labels_file.empty()) {
+		std::cerr << "Usage: " << argv[0] << " [--variant=NAME] [--method=magnitude|filter|channel] [--levels=0,0.5,...]" << std::endl
+			<< "       [--inputs=x_test.csv --labels=y_test.csv | --clips=N] [--export=DIR]" << std::endl;
+		exit(1);
+	}
+
+	const variants::Variant &variant = variants::find(variant_name);
+	const engine::Model model = variant.describe();
+	auto inputs = dataset::load_inputs(model, inputs_file, clips);
+	dataset::Rows labels;
+	if (!labels_file.empty())
+		labels = dataset::read_csv(labels_file);
+
+	// Unpruned top-1 classes
+	std::vector<size_t> baseline;
+	{
+		engine::GemmBackend gemm;
+		gemm.prepare(model);
+		engine::Engine runner(model, gemm);
+		std::vector<number_t> output(model.output_size());
+		for (const auto &input : inputs) {
+			runner.run(input.data(), output.data());
+			baseline.push_back(top1(output));
+		}
+	}
+
+	const char *method_names[] = { "magnitude", "filter", "channel" };
+	std::cout << variant.name << ", " << method_names[(int)method] << " pruning, " << inputs.size()
+		<< (inputs_file.empty() ? " synthetic" : "") << " clips" << std::endl;
+	std::cout << std::right << std::setw(8) << "level" << std::setw(10) << "zeros" << std::setw(10) << "accuracy"
+		<< std::setw(11) << "agreement" << std::setw(13) << "dense bytes" << std::setw(14) << "sparse bytes"
+		<< std::setw(11) << "gemm us" << std::setw(11) << "sparse us" << std::setw(7) << "exact" << std::endl;
+
+	for (double level : levels) {
+		engine::OwnedModel pruned(model);
+		prune(pruned, method, level);
+		const engine::Model &m = pruned.get();
+
+		engine::GemmBackend gemm;
+		engine::BlockSparseBackend sparse;
+		gemm.prepare(m);
+		sparse.prepare(m);
+		engine::Engine dense_runner(m, gemm), sparse_runner(m, sparse);
+
+		size_t zeros = 0, weights = 0, dense_bytes = 0, sparse_bytes = 0;
+		for (size_t l = 0; l < m.layers.size(); l++) {
+			const engine::Layer &layer = m.layers[l];
+			if (!layer.has_weights())
+				continue;
+			weights += layer.weight_count();
+			zeros += std::count(layer.kernel, layer.kernel + layer.weight_count(), 0);
+			dense_bytes += engine::block_sparse::dense_flash_bytes(layer);
+			sparse_bytes += sparse.weights(l).flash_bytes() + layer.filters * sizeof(number_t);
+		}
+
+		size_t right = 0, agree = 0;
+		bool exact = true;
+		double gemm_us = 0, sparse_us = 0;
+		std::vector<number_t> out_dense(m.output_size()), out_sparse(m.output_size());
+		for (size_t n = 0; n < inputs.size(); n++) {
+			auto t0 = std::chrono::steady_clock::now();
+			dense_runner.run(inputs[n].data(), out_dense.data());
+			auto t1 = std::chrono::steady_clock::now();
+			sparse_runner.run(inputs[n].data(), out_sparse.data());
+			auto t2 = std::chrono::steady_clock::now();
+			gemm_us += std::chrono::duration<double, std::micro>(t1 - t0).count();
+			sparse_us += std::chrono::duration<double, std::micro>(t2 - t1).count();
+
+			exact = exact && out_dense == out_sparse;
+			size_t cls = top1(out_sparse);
+			agree += cls == baseline[n];
+			if (n < labels.size())
+				right += dataset::label_class(labels[n]) == cls;
+		}
+
+		std::ostringstream accuracy;
+		if (labels.empty())
+			accuracy << "-";
+		else
+			accuracy << std::fixed << std::setprecision(3) << right / (double)inputs.size();
+		std::cout << std::fixed << std::setprecision(2) << std::setw(8) << level << std::setprecision(3)
+			<< std::setw(10) << zeros / (double)weights << std::setw(10) << accuracy.str()
+			<< std::setw(11) << agree / (double)inputs.size() << std::setw(13) << dense_bytes << std::setw(14) << sparse_bytes
+			<< std::setprecision(1) << std::setw(11) << gemm_us / inputs.size() << std::setw(11) << sparse_us / inputs.size()
+			<< std::setw(7) << (exact ? "yes" : "NO") << std::endl;
+
+		if (!export_dir.empty()) {
+			std::ostringstream what, dir;
+			what << method_names[(int)method] << " pruning to " << level;
+			dir << export_dir << "/" << method_names[(int)method] << "_" << (int)(level * 100 + 0.5);
+			mkdir(export_dir.c_str(), 0755);
+			export_weights(dir.str(), m, sparse, what.str());
+		}
+	}
+	return 0;
+}
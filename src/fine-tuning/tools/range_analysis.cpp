@@ -0,0 +1,87 @@
+// Static range analysis of every model variant: per layer, the input and output
+// intervals, and the signed width needed by the conv1d/dense accumulators, both for
+// the final sums (enough for wrapping accumulation) and for every partial sum in
+// the generated loop order (needed for saturating accumulation). Layers whose
+// sums provably fit in int16 run with 16-bit accumulators in the narrow backend;
+// sums wider than 32 bits may overflow the generated int32 accumulators.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -o range_analysis tools/range_analysis.cpp
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "../engine/backends.h"
+#include "../engine/range.h"
+#include "../engine/variants.h"
+
+using engine::Interval;
+
+static Interval hull(const std::vector<Interval> &intervals) {
+	Interval h = intervals.at(0);
+	for (const auto &i : intervals)
+		h = h.hull(i);
+	return h;
+}
+
+static std::string format(const Interval &i) {
+	std::ostringstream s;
+	s << "[" << i.lo << ", " << i.hi << "]";
+	return s.str();
+}
+
+int main(int argc, const char *argv[]) {
+	long bound = -engine::NUMBER_T_MIN;
+	std::string only;
+	for (int i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "--input-bound=", 14) && (bound = atol(argv[i] + 14)) > 0 && bound <= -engine::NUMBER_T_MIN)
+			continue;
+		if (!strncmp(argv[i], "--variant=", 10)) {
+			only = argv[i] + 10;
+			continue;
+		}
+		std::cerr << "Usage: " << argv[0] << " [--input-bound=N] [--variant=NAME]" << std::endl;
+		exit(1);
+	}
+
+	const Interval input = engine::input_interval(bound);
+	std::cout << "Inputs in " << format(input) << std::endl;
+	bool overflow = false;
+	for (const auto &variant : variants::all()) {
+		if (!only.empty() && only != variant.name)
+			continue;
+		engine::Model model = variant.describe();
+		std::vector<engine::LayerRange> ranges = engine::analyze_ranges(model, input);
+		engine::NarrowBackend narrow(bound);
+		narrow.prepare(model);
+
+		std::cout << std::endl << variant.name << std::endl;
+		std::cout << std::left << std::setw(22) << "layer" << std::setw(20) << "input" << std::setw(20) << "output"
+			<< std::setw(28) << "accumulator" << std::right << std::setw(6) << "bits" << std::setw(9) << "partial"
+			<< "  accumulator type" << std::endl;
+
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			const engine::Layer &layer = model.layers[i];
+			const engine::LayerRange &r = ranges[i];
+			std::cout << std::left << std::setw(22) << layer.name << std::setw(20) << format(hull(r.input))
+				<< std::setw(20) << format(hull(r.output));
+			if (layer.has_weights()) {
+				std::cout << std::setw(28) << format(r.accumulator_hull) << std::right << std::setw(6) << r.accumulator_bits()
+					<< std::setw(9) << r.partial_bits() << "  ";
+				if (r.accumulator_bits() > 32) {
+					std::cout << "int32 may overflow";
+					overflow = true;
+				} else if (narrow.narrow_layers()[i]) {
+					std::cout << "int16";
+				} else {
+					std::cout << "int32";
+				}
+			}
+			std::cout << std::endl;
+		}
+	}
+	return overflow ? 2 : 0;
+}
@@ -0,0 +1,171 @@
+// Finds the conv1d filters whose output is zero on every sample of every clip of a
+// corpus, removes them, and slices the matching input channels out of the next
+// conv1d/dense kernel (through the pooling and flatten layers, which map zeros to
+// zeros). On the corpus the smaller model is bit-exact with the original; this is
+// checked, and the MAC and weight flash reduction is reported per layer.
+//
+// --output=DIR regenerates the generated sources (default: gsc_output_fixed) with
+// the smaller shapes and weights, ready to build main.cpp with -IDIR.
+//
+// Like main.cpp, the generated model is compiled in, so build from src/fine-tuning with
+//   g++ -std=c++17 -O3 -Igsc_output_fixed -o remove_dead_filters tools/remove_dead_filters.cpp
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "model.c"
+
+#include "../engine/engine.h"
+#include "../engine/gemm.h"
+#include "../engine/language_model.h"
+#include "../engine/owned_model.h"
+#include "dataset.h"
+#include "generated_sources.h"
+
+using engine::number_t;
+
+// live[l][f]: filter f of conv1d layer l produced a non-zero output
+static std::vector<std::vector<bool>> find_live_filters(const engine::Model &model,
+		const std::vector<std::vector<number_t>> &inputs) {
+	std::vector<std::vector<bool>> live(model.layers.size());
+	engine::GemmBackend backend;
+	backend.prepare(model);
+	engine::Engine runner(model, backend);
+
+	for (size_t l = 0; l < model.layers.size(); l++)
+		live[l].assign(model.layers[l].filters, model.layers[l].kind != engine::LayerKind::Conv1D);
+	for (const auto &input : inputs) {
+		std::vector<number_t> in = input, out;
+		for (size_t l = 0; l < model.layers.size(); l++) {
+			const engine::Layer &layer = model.layers[l];
+			out.assign(layer.output_size(), 0);
+			runner.run_layer(l, in.data(), out.data());
+			if (layer.kind == engine::LayerKind::Conv1D)
+				for (size_t f = 0; f < layer.filters; f++)
+					for (size_t p = 0; p < layer.out_samples && !live[l][f]; p++)
+						live[l][f] = out[f * layer.out_samples + p] != 0;
+			in.swap(out);
+		}
+	}
+	return live;
+}
+
+// Keeps the live filters of every conv1d layer and the matching inputs of the next weighted layer
+static void remove_filters(engine::OwnedModel &owned, std::vector<std::vector<bool>> live) {
+	engine::Model &model = owned.get();
+	std::vector<bool> inputs_kept(model.input_channels, true);	// Channels feeding the current layer
+	size_t repeat = 1;	// Flatten: consecutive units per channel
+
+	for (size_t l = 0; l < model.layers.size(); l++) {
+		engine::Layer &layer = model.layers[l];
+		if (layer.kind == engine::LayerKind::Flatten) {
+			repeat = layer.samples;
+			continue;
+		}
+		if (!layer.has_weights())
+			continue;
+
+		// A layer needs at least one filter
+		if (std::find(live[l].begin(), live[l].end(), true) == live[l].end())
+			live[l][0] = true;
+
+		const std::vector<number_t> kernel = owned.kernel(l), bias = owned.bias(l);
+		const size_t C = layer.channels, K = layer.kernel_size;
+		owned.kernel(l).clear();
+		owned.bias(l).clear();
+		size_t filters = 0, channels = 0;
+		for (size_t f = 0; f < layer.filters; f++) {
+			if (!live[l][f])
+				continue;
+			filters++;
+			owned.bias(l).push_back(bias[f]);
+			for (size_t c = 0; c < C; c++)
+				if (inputs_kept[c / repeat])
+					owned.kernel(l).insert(owned.kernel(l).end(), &kernel[(f * C + c) * K], &kernel[(f * C + c + 1) * K]);
+		}
+		for (size_t c = 0; c < C; c++)
+			channels += inputs_kept[c / repeat];
+
+		layer.filters = filters;
+		layer.channels = channels;
+		inputs_kept = live[l];
+		repeat = 1;
+	}
+	owned.update();
+}
+
+static size_t flash_bytes(const engine::Layer &layer) {
+	return (layer.weight_count() + layer.filters) * sizeof(number_t);
+}
+
+int main(int argc, const char *argv[]) {
+	std::string inputs_file, sources = "gsc_output_fixed", output_dir;
+	size_t clips = 64;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 9, "--inputs=") == 0)
+			inputs_file = arg.substr(9);
+		else if (arg.compare(0, 8, "--clips=") == 0 && atoi(arg.c_str() + 8) > 0)
+			clips = atoi(arg.c_str() + 8);
+		else if (arg.compare(0, 10, "--sources=") == 0)
+			sources = arg.substr(10);
+		else if (arg.compare(0, 9, "--output=") == 0)
+			output_dir = arg.substr(9);
+		else {
+			std::cerr << "Usage: " << argv[0] << " [--inputs=x_test.csv | --clips=N] [--sources=gsc_output_fixed] [--output=DIR]" << std::endl;
+			std::cerr << "Without --inputs, N synthetic clips are used (default 64)" << std::endl;
+			exit(1);
+		}
+	}
+
+	const engine::Model model = LANGUAGE_MODEL("gsc_output_fixed");
+	auto inputs = dataset::load_inputs(model, inputs_file, clips);
+	auto live = find_live_filters(model, inputs);
+
+	engine::OwnedModel smaller(model);
+	remove_filters(smaller, live);
+	const engine::Model &m = smaller.get();
+
+	// Bit-exactness on the corpus
+	engine::GemmBackend original_backend, smaller_backend;
+	original_backend.prepare(model);
+	smaller_backend.prepare(m);
+	engine::Engine original_runner(model, original_backend), smaller_runner(m, smaller_backend);
+	size_t mismatches = 0;
+	std::vector<number_t> expected(model.output_size()), actual(m.output_size());
+	for (const auto &input : inputs) {
+		original_runner.run(input.data(), expected.data());
+		smaller_runner.run(input.data(), actual.data());
+		mismatches += expected != actual;
+	}
+
+	std::cout << model.name << ", " << inputs.size() << (inputs_file.empty() ? " synthetic" : "") << " clips" << std::endl;
+	std::cout << std::left << std::setw(20) << "layer" << std::right << std::setw(9) << "filters" << std::setw(7) << "dead"
+		<< std::setw(12) << "MACs" << std::setw(12) << "after" << std::setw(10) << "bytes" << std::setw(10) << "after" << std::endl;
+	size_t dead_total = 0, bytes = 0, bytes_after = 0;
+	for (size_t l = 0; l < model.layers.size(); l++) {
+		const engine::Layer &before = model.layers[l], &after = m.layers[l];
+		if (!before.has_weights())
+			continue;
+		size_t dead = std::count(live[l].begin(), live[l].end(), false);
+		dead_total += dead;
+		bytes += flash_bytes(before);
+		bytes_after += flash_bytes(after);
+		std::cout << std::left << std::setw(20) << before.name << std::right << std::setw(9) << before.filters << std::setw(7) << dead
+			<< std::setw(12) << before.macs() << std::setw(12) << after.macs()
+			<< std::setw(10) << flash_bytes(before) << std::setw(10) << flash_bytes(after) << std::endl;
+	}
+	std::cout << std::fixed << std::setprecision(1)
+		<< "Dead filters: " << dead_total << ", MACs " << model.macs() << " -> " << m.macs()
+		<< " (-" << 100.0 * (model.macs() - m.macs()) / model.macs() << "%), weight bytes " << bytes << " -> " << bytes_after
+		<< " (-" << 100.0 * (bytes - bytes_after) / bytes << "%)" << std::endl;
+	std::cout << "Outputs identical on " << inputs.size() - mismatches << "/" << inputs.size() << " clips" << std::endl;
+
+	if (!output_dir.empty()) {
+		generated_sources::write_model(sources, output_dir, m);
+		std::cout << "Generated sources written to " << output_dir << std::endl;
+	}
+	return mismatches ? 1 : 0;
+}
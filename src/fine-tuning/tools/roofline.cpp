@@ -0,0 +1,240 @@
+// Static cost report of the layers of a variant, with each layer placed on a
+// roofline for the host CPU and for a Cortex-M4.
+//
+// The layer shapes come from the variant's model header macros (INPUT_CHANNELS,
+// CONV_FILTERS, CONV_KERNEL_SIZE, POOL_SIZE, FC_UNITS...) through its Model
+// description. Per layer: MACs (window reads for pooling), weight and bias bytes,
+// activation bytes read and written (each value touched once, the compulsory
+// traffic) and the arithmetic intensity, MACs per byte of that traffic.
+//
+// Host: the peak is measured with an int16 dot product on L1-resident data and
+// the bandwidth with a sequential read of a buffer larger than the caches (both
+// can be given instead). Every layer is timed with --backend on the input it sees
+// on a synthetic clip, and its achieved MAC/s is compared with the roof
+// min(peak, intensity * bandwidth) at its intensity. The layers are timed on warm
+// caches, so a small layer can exceed its memory roof (more than 100%).
+//
+// Cortex-M4: the ceilings and the time of every layer come from the analytical
+// model of engine/m4_cost.h (m4::CycleCosts, m4::estimate) for the generated or
+// the dual16 kernels, so they agree with m4_estimate. The compute roof is one MAC
+// per MLA (two per SMLAD); the memory roof reads the weights from flash (wait
+// states per 64-bit line) and the activations from SRAM with 32-bit loads. A
+// layer is memory bound when loads, stores and wait states take most of its
+// estimated cycles. Layers are then ranked by their share of the time on either
+// target, which is where optimisation pays first.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -march=native -o roofline tools/roofline.cpp
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../engine/backends.h"
+#include "../engine/m4_cost.h"
+#include "../engine/variants.h"
+#include "bench.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+struct LayerCost {
+	const engine::Layer *layer;
+	double macs, weight_bytes, read_bytes, write_bytes;
+	double host_ns;
+	double m4_cycles, m4_memory_cycles;	// m4::estimate()
+	double m4_roof;						// MAC/s
+
+	double bytes() const { return weight_bytes + read_bytes + write_bytes; }
+	double intensity() const { return macs / std::max(1.0, bytes()); }
+};
+
+// Inputs of every layer on one clip
+class InputCapture : public engine::ActivationSink {
+public:
+	explicit InputCapture(const engine::Model &model) : inputs(model.layers.size()) {}
+
+	void layer_input(size_t i, const engine::Layer &layer, const number_t *input) override {
+		inputs[i].assign(input, input + layer.input_size());
+	}
+	void layer_output(size_t, const engine::Layer &, const number_t *) override {}
+
+	std::vector<std::vector<number_t>> inputs;
+};
+
+// int16 MACs per second of a dot product on L1-resident data
+static double measure_peak_macs() {
+	const size_t n = 2048;
+	std::vector<int16_t> a(n), b(n);
+	for (size_t i = 0; i < n; i++) {
+		a[i] = (int16_t)(i * 7 - 3000);
+		b[i] = (int16_t)(i * 13 % 997 - 500);
+	}
+	volatile int32_t sink;
+	auto samples = bench::time_samples([&]() {
+		// Forces the arrays to be reloaded, so the loop is not hoisted
+		asm volatile("" ::: "memory");
+		int32_t acc = 0;
+		for (size_t i = 0; i < n; i++)
+			acc += (int32_t)a[i] * b[i];
+		sink = acc;
+	}, 10);
+	(void)sink;
+	return n / (bench::percentile(samples, 0.1) * 1e-9);
+}
+
+// Bytes per second of a sequential read of 64 MB
+static double measure_bandwidth() {
+	std::vector<uint64_t> buffer(8 << 20);
+	for (size_t i = 0; i < buffer.size(); i++)
+		buffer[i] = i;
+	volatile uint64_t sink;
+	auto samples = bench::time_samples([&]() {
+		asm volatile("" ::: "memory");
+		uint64_t sum = 0;
+		for (uint64_t v : buffer)
+			sum += v;
+		sink = sum;
+	}, 5, 1);
+	(void)sink;
+	return buffer.size() * sizeof(uint64_t) / (bench::percentile(samples, 0.1) * 1e-9);
+}
+
+static std::string fixed(double v, int precision) {
+	std::ostringstream s;
+	s << std::fixed << std::setprecision(precision) << v;
+	return s.str();
+}
+
+int main(int argc, const char *argv[]) {
+	std::string variant_name = "fine-tuning", backend_name = "gemm";
+	double host_peak = 0, host_bandwidth = 0;
+	engine::m4::CycleCosts m4;
+	engine::m4::Implementation m4_impl = engine::m4::Implementation::Generated;
+	size_t repetitions = 10;
+	bool usage = false;
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 10, "--variant=") == 0)
+			variant_name = arg.substr(10);
+		else if (arg.compare(0, 10, "--backend=") == 0)
+			backend_name = arg.substr(10);
+		else if (arg.compare(0, 14, "--repetitions=") == 0)
+			usage = (repetitions = atoi(arg.c_str() + 14)) == 0;
+		else if (arg.compare(0, 18, "--host-peak-gmacs=") == 0)
+			usage = (host_peak = atof(arg.c_str() + 18) * 1e9) <= 0;
+		else if (arg.compare(0, 21, "--host-bandwidth-gbs=") == 0)
+			usage = (host_bandwidth = atof(arg.c_str() + 21) * 1e9) <= 0;
+		else if (arg.compare(0, 9, "--m4-mhz=") == 0)
+			usage = (m4.mhz = atof(arg.c_str() + 9)) <= 0;
+		else if (arg == "--m4-kernels=generated" || arg == "--m4-kernels=dual16")
+			m4_impl = arg == "--m4-kernels=dual16" ? engine::m4::Implementation::Dual16 : engine::m4::Implementation::Generated;
+		else if (arg.compare(0, 17, "--m4-wait-states=") == 0)
+			usage = (m4.flash_wait_states = atoi(arg.c_str() + 17)) < 0;
+		else
+			usage = true;
+	}
+	if (usage) {
+		std::cerr << "Usage: " << argv[0] << " [--variant=NAME] [--backend=NAME] [--repetitions=N]" << std::endl
+			<< "       [--host-peak-gmacs=G] [--host-bandwidth-gbs=G] [--m4-mhz=80] [--m4-kernels=generated|dual16] [--m4-wait-states=4]" << std::endl;
+		exit(1);
+	}
+
+	const variants::Variant &variant = variants::find(variant_name);
+	const engine::Model model = variant.describe();
+	std::unique_ptr<engine::Backend> backend = engine::make_backend(backend_name);
+	backend->prepare(model);
+	engine::Engine runner(model, *backend);
+
+	if (!bench::pin_thread(0))
+		std::cerr << "Warning: cannot pin to CPU 0" << std::endl;
+	if (host_peak == 0)
+		host_peak = measure_peak_macs();
+	if (host_bandwidth == 0)
+		host_bandwidth = measure_bandwidth();
+
+	// Layer inputs on a synthetic clip
+	InputCapture capture(model);
+	{
+		const auto clip = dataset::load_inputs(model, "", 1)[0];
+		std::vector<number_t> output(model.output_size());
+		runner.set_sink(&capture);
+		runner.run(clip.data(), output.data());
+		runner.set_sink(nullptr);
+	}
+
+	const bool dual = m4_impl == engine::m4::Implementation::Dual16;
+	const std::vector<engine::m4::LayerEstimate> m4_layers = engine::m4::estimate(model, m4_impl, m4);
+	std::vector<LayerCost> costs;
+	std::vector<number_t> output(model.max_activation_size());
+	for (size_t i = 0; i < model.layers.size(); i++) {
+		const engine::Layer &layer = model.layers[i];
+		if (layer.kind == engine::LayerKind::Flatten)
+			continue;
+		LayerCost c;
+		c.layer = &layer;
+		c.macs = layer.macs();
+		c.weight_bytes = (layer.weight_count() + (layer.bias ? layer.filters : 0)) * sizeof(number_t);
+		c.read_bytes = layer.input_size() * sizeof(number_t);
+		c.write_bytes = layer.output_size() * sizeof(number_t);
+		const number_t *input = capture.inputs[i].data();
+		c.host_ns = bench::percentile(bench::time_samples([&]() { runner.run_layer(i, input, output.data()); }, repetitions), 0.5);
+		const engine::m4::LayerEstimate &e = m4_layers.at(costs.size());
+		if (e.layer->name != layer.name)
+			engine::fatal(layer.name + ": no Cortex-M4 estimate");
+		c.m4_cycles = e.cycles;
+		c.m4_memory_cycles = m4.memory_cycles(e.ops);
+		const double memory_s = c.weight_bytes / m4.flash_bytes_per_s() + (c.read_bytes + c.write_bytes) / m4.sram_bytes_per_s();
+		c.m4_roof = std::min(m4.peak_macs(dual), c.macs / memory_s);
+		costs.push_back(c);
+	}
+
+	double host_total = 0, m4_total = 0;
+	for (const auto &c : costs) {
+		host_total += c.host_ns;
+		m4_total += c.m4_cycles;
+	}
+
+	std::cout << variant.name << " on " << backend_name << ": host peak " << fixed(host_peak * 1e-9, 2) << " GMAC/s, bandwidth "
+		<< fixed(host_bandwidth * 1e-9, 2) << " GB/s (ridge " << fixed(host_peak / host_bandwidth, 2) << " MAC/B); Cortex-M4 "
+		<< m4.mhz << " MHz, " << engine::m4::implementation_name(m4_impl) << " kernels, peak " << fixed(m4.peak_macs(dual) * 1e-6, 0)
+		<< " MMAC/s, flash " << fixed(m4.flash_bytes_per_s() * 1e-6, 0) << " MB/s (" << m4.flash_wait_states << " wait states), SRAM "
+		<< fixed(m4.sram_bytes_per_s() * 1e-6, 0) << " MB/s" << std::endl;
+	std::cout << std::left << std::setw(20) << "layer" << std::right << std::setw(11) << "MACs" << std::setw(9) << "weight B"
+		<< std::setw(9) << "read B" << std::setw(9) << "write B" << std::setw(8) << "MAC/B"
+		<< std::setw(10) << "host us" << std::setw(9) << "GMAC/s" << std::setw(9) << "roof" << std::setw(7) << "%roof"
+		<< std::setw(8) << "bound" << std::setw(9) << "M4 ms" << std::setw(7) << "%roof" << std::setw(8) << "bound" << std::endl;
+	for (const auto &c : costs) {
+		const double achieved = c.macs / (c.host_ns * 1e-9), roof = std::min(host_peak, c.intensity() * host_bandwidth);
+		std::cout << std::left << std::setw(20) << c.layer->name << std::right << std::setw(11) << (size_t)c.macs
+			<< std::setw(9) << (size_t)c.weight_bytes << std::setw(9) << (size_t)c.read_bytes << std::setw(9) << (size_t)c.write_bytes
+			<< std::setw(8) << fixed(c.intensity(), 2) << std::setw(10) << fixed(c.host_ns / 1000, 1)
+			<< std::setw(9) << fixed(achieved * 1e-9, 2) << std::setw(9) << fixed(roof * 1e-9, 2)
+			<< std::setw(7) << fixed(100 * achieved / roof, 0) << std::setw(8) << (c.intensity() * host_bandwidth < host_peak ? "memory" : "compute")
+			<< std::setw(9) << fixed(c.m4_cycles / (m4.mhz * 1e3), 2) << std::setw(7) << fixed(100 * c.macs / (c.m4_cycles / (m4.mhz * 1e6)) / c.m4_roof, 0)
+			<< std::setw(8) << (2 * c.m4_memory_cycles > c.m4_cycles ? "memory" : "compute") << std::endl;
+	}
+	std::cout << std::left << std::setw(20) << "total" << std::right << std::setw(11) << model.macs()
+		<< std::setw(9) << model.weight_count() * sizeof(number_t) << std::setw(44) << fixed(host_total / 1000, 1)
+		<< std::setw(42) << fixed(m4_total / (m4.mhz * 1e3), 2) << std::endl;
+
+	// Where the time goes
+	auto ranking = [&](const char *target, double total, double (*time)(const LayerCost &)) {
+		std::vector<const LayerCost *> order;
+		for (const auto &c : costs)
+			order.push_back(&c);
+		std::sort(order.begin(), order.end(), [&](const LayerCost *a, const LayerCost *b) { return time(*a) > time(*b); });
+		std::cout << target << " time share:";
+		for (const LayerCost *c : order)
+			if (time(*c) / total >= 0.01)
+				std::cout << " " << c->layer->name << " " << fixed(100 * time(*c) / total, 0) << "%";
+		std::cout << std::endl;
+	};
+	ranking("Host", host_total, [](const LayerCost &c) { return c.host_ns; });
+	ranking("Cortex-M4", m4_total, [](const LayerCost &c) { return c.m4_cycles; });
+	return 0;
+}
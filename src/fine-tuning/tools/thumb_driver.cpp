@@ -0,0 +1,128 @@
+// Writes the freestanding C driver that tools/thumb_profile.sh cross-compiles for
+// a Cortex-M4 (armv7e-m, Thumb-2) and runs under user-mode emulation.
+//
+// The driver includes the generated single-file model of the variant and calls
+// its layer functions directly, in the order of the Model description, with two
+// ping-pong buffers: `driver N` runs the first N layers (flatten, a macro in the
+// generated code, is skipped), so the instruction count of a layer is the
+// difference between two runs. The input is a synthetic clip embedded in the
+// source, and a full run compares the output with the one cnn() gives on the host
+// (exit status 2 on mismatch). The program has its own _start and uses the Linux
+// exit system call only, so it needs no C library.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O2 -o thumb_driver tools/thumb_driver.cpp
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../engine/variants.h"
+#include "dataset.h"
+
+using engine::number_t;
+
+static void write_array(std::ostream &out, const char *name, const std::vector<number_t> &values) {
+	out << "static const number_t " << name << "[" << values.size() << "] = {";
+	for (size_t i = 0; i < values.size(); i++)
+		out << (i % 16 ? " " : "\n\t") << values[i] << ",";
+	out << "\n};\n\n";
+}
+
+static void write_driver(std::ostream &out, const variants::Variant &variant, const std::string &source_root) {
+	const engine::Model model = variant.describe();
+	const std::vector<number_t> clip = dataset::load_inputs(model, "", 1)[0];
+	std::vector<number_t> expected(model.output_size());
+	variant.cnn(clip.data(), expected.data());
+
+	std::vector<const engine::Layer *> layers;
+	for (const auto &layer : model.layers)
+		if (layer.kind != engine::LayerKind::Flatten)
+			layers.push_back(&layer);
+
+	out << "// Generated by tools/thumb_driver.cpp for " << variant.name << ": `driver N` runs the first N of\n"
+		<< "// the " << layers.size() << " layers on a synthetic clip, a full run checks the output against the host.\n\n"
+		<< "#include \"" << source_root << "/" << variant.source << "\"\n\n"
+		<< "#define LAYERS " << layers.size() << "\n\n";
+	write_array(out, "clip", clip);
+	write_array(out, "expected", expected);
+	out << "static number_t buffer1[" << model.max_activation_size() << "], buffer2[" << model.max_activation_size() << "];\n\n"
+		<< "static void run(int layers) {\n";
+	const char *buffers[2] = { "buffer1", "buffer2" };
+	const char *in = "clip";
+	for (size_t i = 0; i < layers.size(); i++) {
+		const engine::Layer &layer = *layers[i];
+		const char *output = buffers[i % 2];
+		out << "\tif (layers > " << i << ")\n\t\t" << layer.name << "((const void *)" << in << ", ";
+		if (layer.has_weights())
+			out << layer.name << "_kernel, " << layer.name << "_bias, ";
+		out << "(void *)" << output << ");\n";
+		in = output;
+	}
+	out << "}\n\n"
+		<< "int driver_main(int argc, char **argv) {\n"
+		<< "\tint layers = LAYERS;\n"
+		<< "\tif (argc > 1)\n"
+		<< "\t\tfor (layers = 0; *argv[1] >= '0' && *argv[1] <= '9'; argv[1]++)\n"
+		<< "\t\t\tlayers = layers * 10 + *argv[1] - '0';\n"
+		<< "\trun(layers);\n"
+		<< "\tif (layers >= LAYERS)\n"
+		<< "\t\tfor (int i = 0; i < " << expected.size() << "; i++)\n"
+		<< "\t\t\tif (" << in << "[i] != expected[i])\n"
+		<< "\t\t\t\treturn 2;\n"
+		<< "\treturn 0;\n"
+		<< "}\n\n"
+		<< "#ifdef __arm__\n"
+		<< "// Linux process entry: argc at sp, argv after it; exit(driver_main()) with svc\n"
+		<< "__attribute__((naked, noreturn)) void _start(void) {\n"
+		<< "\t__asm__ volatile(\"ldr r0, [sp]\\n\\tadd r1, sp, #4\\n\\tbl driver_main\\n\\tmovs r7, #1\\n\\tsvc #0\\n\");\n"
+		<< "}\n"
+		<< "#endif\n";
+}
+
+int main(int argc, const char *argv[]) {
+	std::string variant_name, output_file, source_root = "..";
+	bool list = false, layer_names = false, usage = false;
+	for (int i = 1; i < argc && !usage; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 10, "--variant=") == 0)
+			variant_name = arg.substr(10);
+		else if (arg.compare(0, 9, "--output=") == 0)
+			output_file = arg.substr(9);
+		else if (arg.compare(0, 14, "--source-root=") == 0)
+			source_root = arg.substr(14);
+		else if (arg == "--list")
+			list = true;
+		else if (arg == "--layers")
+			layer_names = true;
+		else
+			usage = true;
+	}
+	if (usage || (!list && variant_name.empty())) {
+		std::cerr << "Usage: " << argv[0] << " --list | --variant=NAME [--layers] [--source-root=DIR] [--output=FILE.c]" << std::endl;
+		std::cerr << "--source-root is the src/ directory as seen from the driver (default ..)" << std::endl;
+		exit(1);
+	}
+
+	if (list) {
+		for (const auto &v : variants::all())
+			std::cout << v.name << std::endl;
+		return 0;
+	}
+	const variants::Variant &variant = variants::find(variant_name);
+	if (layer_names) {
+		for (const auto &layer : variant.describe().layers)
+			if (layer.kind != engine::LayerKind::Flatten)
+				std::cout << layer.name << std::endl;
+		return 0;
+	}
+	if (output_file.empty()) {
+		write_driver(std::cout, variant, source_root);
+	} else {
+		std::ofstream fout(output_file);
+		if (!fout)
+			engine::fatal("cannot write \"" + output_file + "\"");
+		write_driver(fout, variant, source_root);
+	}
+	return 0;
+}
@@ -0,0 +1,73 @@
+#!/bin/sh
+# Instruction counts per layer of the generated models compiled for the Cortex-M4
+# (armv7e-m, Thumb-2), under QEMU user-mode emulation.
+#
+# For every variant (all by default) thumb_driver writes a freestanding driver
+# around the generated model, which is cross-compiled once per set of compiler
+# flags and run with QEMU's instruction counting plugin for 0, 1, ... all layers;
+# the count of a layer is the difference between consecutive runs. The full run
+# must reproduce the output of cnn() on the host. Prints CSV on stdout:
+# variant,flags,layer,instructions (the "total" rows exclude the startup).
+#
+# Run from src/fine-tuning: tools/thumb_profile.sh [variant...]
+# Needs arm-none-eabi-gcc, qemu-arm and the plugin counting instructions
+# (libinsn.so, built from QEMU's tests/tcg/plugins), given as INSN_PLUGIN.
+# CC, ARCH_FLAGS, QEMU, QEMU_CPU and FLAGS (';'-separated flag sets, default "-Os;-O2":
+# -Os is what the Arduino STM32 core builds with) override the defaults.
+
+set -e
+
+CC=${CC:-arm-none-eabi-gcc}
+QEMU=${QEMU:-qemu-arm}
+QEMU_CPU=${QEMU_CPU:-max}
+FLAGS=${FLAGS:--Os;-O2}
+ARCH_FLAGS=${ARCH_FLAGS:--mcpu=cortex-m4 -mthumb -mfloat-abi=soft}
+
+if [ -z "$INSN_PLUGIN" ] || [ ! -f "$INSN_PLUGIN" ]; then
+	echo "Set INSN_PLUGIN to QEMU's libinsn.so" >&2
+	exit 1
+fi
+for tool in "$CC" "$QEMU" g++; do
+	if ! command -v "$tool" > /dev/null; then
+		echo "$tool not found" >&2
+		exit 1
+	fi
+done
+
+src=$(cd .. && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+g++ -std=c++17 -O2 -o "$work/thumb_driver" tools/thumb_driver.cpp
+variants=${*:-$("$work/thumb_driver" --list)}
+
+# Instructions executed by the driver running the first $2 layers
+count() {
+	"$QEMU" -cpu "$QEMU_CPU" -plugin "$INSN_PLUGIN" -d plugin "$1" "$2" 2>&1 | awk '/insns:/ { n = $NF } END { print n }'
+}
+
+echo "variant,flags,layer,instructions"
+for variant in $variants; do
+	"$work/thumb_driver" --variant="$variant" --source-root="$src" --output="$work/driver.c"
+	"$work/thumb_driver" --variant="$variant" --layers > "$work/layers"
+	echo "$FLAGS" | tr ';' '\n' | while read -r flags; do
+		# shellcheck disable=SC2086
+		"$CC" $ARCH_FLAGS $flags -std=gnu11 -w -ffreestanding -fno-builtin -nostdlib -static \
+			-o "$work/driver" "$work/driver.c" -lgcc
+		layers=$(wc -l < "$work/layers")
+		if ! "$QEMU" -cpu "$QEMU_CPU" "$work/driver" "$layers"; then
+			echo "$variant ($flags): output differs from cnn() on the host" >&2
+			exit 1
+		fi
+		previous=$(count "$work/driver" 0)
+		start=$previous
+		n=1
+		while read -r layer; do
+			current=$(count "$work/driver" $n)
+			echo "$variant,$flags,$layer,$((current - previous))"
+			previous=$current
+			n=$((n + 1))
+		done < "$work/layers"
+		echo "$variant,$flags,total,$((previous - start))"
+	done
+done
@@ -0,0 +1,103 @@
+// Compares the Winograd F(2,2) kernel against the direct conv1d loops on every
+// stride-1 conv1d layer of the model variants: multiplication counts, wall-clock
+// time per call on the host and bit-exactness of the layer outputs. "used" tells
+// whether WinogradBackend picks the kernel for the layer (winograd::MEASURED, from
+// the host times of this tool). The Cortex-M4 columns are the estimates of
+// engine/m4_cost.h at 80 MHz for the generated loops, a CMSIS-NN style dual-MAC
+// kernel and the Winograd kernel.
+//
+// Build from src/fine-tuning: g++ -std=c++17 -O3 -o winograd_compare tools/winograd_compare.cpp
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../engine/backends.h"
+#include "../engine/m4_cost.h"
+#include "../engine/variants.h"
+
+using engine::number_t;
+
+// Runs the reference layers preceding layer index on input and returns the layer's input
+static std::vector<number_t> layer_input(const engine::Model &model, size_t index, const std::vector<number_t> &input) {
+	engine::ReferenceBackend backend;
+	engine::Engine runner(model, backend);
+	std::vector<number_t> in = input, out;
+	for (size_t i = 0; i < index; i++) {
+		out.assign(model.layers[i].output_size(), 0);
+		runner.run_layer(i, in.data(), out.data());
+		in.swap(out);
+	}
+	return in;
+}
+
+template<typename Fn>
+static double time_per_call_us(Fn fn, int repetitions) {
+	fn(); // Warm-up
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < repetitions; i++)
+		fn();
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / repetitions;
+}
+
+int main(int argc, const char *argv[]) {
+	int repetitions = 2000;
+	if (argc > 2 || (argc == 2 && (repetitions = atoi(argv[1])) <= 0)) {
+		std::cerr << "Usage: " << argv[0] << " [repetitions]" << std::endl;
+		exit(1);
+	}
+
+	std::mt19937 rng(0);
+	std::uniform_int_distribution<int> audio(-4096, 4096);
+	engine::GemmBackend gemm;
+	engine::WinogradBackend winograd(true);
+	const engine::m4::CycleCosts costs;
+	bool exact = true;
+
+	std::cout << std::left << std::setw(28) << "variant" << std::setw(10) << "layer"
+		<< std::right << std::setw(10) << "direct mul" << std::setw(12) << "wino mul" << std::setw(8) << "ratio"
+		<< std::setw(12) << "direct us" << std::setw(10) << "gemm us" << std::setw(10) << "wino us" << std::setw(6) << "used"
+		<< std::setw(12) << "M4 gen ms" << std::setw(11) << "dual16 ms" << std::setw(10) << "wino ms" << std::setw(8) << "exact" << std::endl;
+
+	for (const auto &variant : variants::all()) {
+		engine::Model model = variant.describe();
+		gemm.prepare(model);
+		winograd.prepare(model);
+
+		std::vector<number_t> audio_input(model.input_size());
+		for (auto &sample : audio_input)
+			sample = audio(rng);
+
+		for (size_t i = 0; i < model.layers.size(); i++) {
+			const engine::Layer &layer = model.layers[i];
+			if (!engine::winograd::applicable(layer))
+				continue;
+
+			std::vector<number_t> in = layer_input(model, i, audio_input);
+			std::vector<number_t> direct(layer.output_size()), out_gemm(layer.output_size()), out_wino(layer.output_size());
+
+			double t_direct = time_per_call_us([&]() { layer.generated(in.data(), direct.data()); }, repetitions);
+			double t_gemm = time_per_call_us([&]() { gemm.conv1d(i, layer, in.data(), out_gemm.data()); }, repetitions);
+			double t_wino = time_per_call_us([&]() { winograd.conv1d(i, layer, in.data(), out_wino.data()); }, repetitions);
+			bool same = direct == out_gemm && direct == out_wino;
+			exact = exact && same;
+
+			size_t mul_wino = engine::winograd::multiplications(layer);
+			const double m4_generated = costs.ms(engine::m4::count(layer, engine::m4::Implementation::Generated, costs));
+			const double m4_dual16 = costs.ms(engine::m4::count(layer, engine::m4::Implementation::Dual16, costs));
+			const double m4_winograd = costs.ms(engine::m4::winograd(layer, costs));
+			std::cout << std::left << std::setw(28) << variant.name << std::setw(10) << layer.name
+				<< std::right << std::setw(10) << layer.macs() << std::setw(12) << mul_wino
+				<< std::setw(8) << std::fixed << std::setprecision(3) << mul_wino / (double)layer.macs()
+				<< std::setw(12) << std::setprecision(2) << t_direct << std::setw(10) << t_gemm << std::setw(10) << t_wino
+				<< std::setw(6) << (engine::winograd::faster(layer) ? "yes" : "no") << std::setprecision(3) << std::setw(12) << m4_generated
+				<< std::setw(11) << m4_dual16 << std::setw(10) << m4_winograd << std::setw(8) << (same ? "yes" : "NO") << std::endl;
+		}
+	}
+
+	return exact ? 0 : 1;
+}